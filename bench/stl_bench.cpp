@@ -0,0 +1,396 @@
+// Times each stage of loading an STL on synthetic binary and ASCII files and prints the
+// results as JSON. Stage times are the best of --repeat runs so numbers from different
+// commits on the same machine can be compared directly. With a GL context it also times
+// creating the shader program with an empty and with a filled program binary cache.
+//
+// STLBench [--dir DIR] [--max-triangles N] [--repeat N] [--commit ID] [--output FILE] [--no-upload]
+
+#include "analysis.h"
+#include "gpu_mesh.h"
+#include "headless.h"
+#include "normals.h"
+#include "optimize.h"
+#include "program_cache.h"
+#include "simplify.h"
+#include "stl.h"
+#include "weld.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr size_t SIZES[] = {1000, 10000, 100000, 1000000, 10000000, 50000000};
+
+struct BenchOptions {
+    std::filesystem::path directory = "build/bench";
+    size_t max_triangles = 1000000;
+    int repeat = 3;
+    std::string commit = "unknown";
+    std::filesystem::path output;   // stdout when empty
+    bool upload = true;
+};
+
+struct StageResult {
+    const char* stage;
+    double seconds;
+};
+
+struct RunResult {
+    const char* format;
+    size_t triangles;
+    size_t file_bytes;
+    std::vector<StageResult> stages;
+};
+
+// Program creation at startup, compiled into an empty program cache against loaded from it
+struct StartupResult {
+    bool measured = false;
+    bool program_binaries = false;  // the driver offers binary formats at all
+    double cold_seconds = 0.0;
+    double warm_seconds = 0.0;
+};
+
+// Grid of the torus make_torus builds for a requested size
+std::pair<size_t, size_t> torus_grid(size_t triangles) {
+    const size_t rings = std::max<size_t>(3, static_cast<size_t>(std::sqrt(triangles / 4.0)));
+    return {std::max<size_t>(3, triangles / (2 * rings)), rings};
+}
+
+// Torus with about `triangles` triangles on a shared grid, so welding has real work
+std::vector<Vertex> make_torus(size_t triangles) {
+    const auto [segments, rings] = torus_grid(triangles);
+    const float major = 10.0f, minor = 3.0f;
+    const float tau = 6.28318530718f;
+
+    auto point = [&](size_t s, size_t r) {
+        float u = tau * static_cast<float>(s % segments) / segments;
+        float v = tau * static_cast<float>(r % rings) / rings;
+        return glm::vec3((major + minor * std::cos(v)) * std::cos(u), (major + minor * std::cos(v)) * std::sin(u),
+                         minor * std::sin(v));
+    };
+
+    std::vector<Vertex> vertices;
+    vertices.reserve(segments * rings * 6);
+    for (size_t s = 0; s < segments; ++s) {
+        for (size_t r = 0; r < rings; ++r) {
+            glm::vec3 a = point(s, r), b = point(s + 1, r), c = point(s + 1, r + 1), d = point(s, r + 1);
+            for (const auto& [p0, p1, p2] : {std::array{a, b, c}, std::array{a, c, d}}) {
+                glm::vec3 normal = glm::normalize(glm::cross(p1 - p0, p2 - p0));
+                vertices.push_back({p0, normal});
+                vertices.push_back({p1, normal});
+                vertices.push_back({p2, normal});
+            }
+        }
+    }
+    return vertices;
+}
+
+void write_binary(const std::filesystem::path& path, const std::vector<Vertex>& vertices) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    char header[STL_HEADER_SIZE] = "STLBench synthetic torus";
+    out.write(header, sizeof(header));
+    uint32_t count = static_cast<uint32_t>(vertices.size() / 3);
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+
+    std::vector<char> records(size_t(count) * STL_RECORD_SIZE);
+    for (size_t t = 0; t < count; ++t) {
+        char* record = records.data() + t * STL_RECORD_SIZE;
+        std::memcpy(record, &vertices[t * 3].normal, 12);
+        for (int c = 0; c < 3; ++c) {
+            std::memcpy(record + 12 + c * 12, &vertices[t * 3 + c].position, 12);
+        }
+        std::memset(record + 48, 0, 2);
+    }
+    out.write(records.data(), static_cast<std::streamsize>(records.size()));
+    if (!out) {
+        throw std::runtime_error("Failed to write " + path.string());
+    }
+}
+
+void write_ascii(const std::filesystem::path& path, const std::vector<Vertex>& vertices) {
+    std::FILE* out = std::fopen(path.string().c_str(), "w");
+    if (!out) {
+        throw std::runtime_error("Failed to write " + path.string());
+    }
+    std::fprintf(out, "solid torus\n");
+    for (size_t t = 0; t < vertices.size(); t += 3) {
+        glm::vec3 n = vertices[t].normal;
+        std::fprintf(out, "  facet normal %e %e %e\n    outer loop\n", n.x, n.y, n.z);
+        for (int c = 0; c < 3; ++c) {
+            glm::vec3 p = vertices[t + c].position;
+            std::fprintf(out, "      vertex %e %e %e\n", p.x, p.y, p.z);
+        }
+        std::fprintf(out, "    endloop\n  endfacet\n");
+    }
+    std::fprintf(out, "endsolid torus\n");
+    if (std::fclose(out) != 0) {
+        throw std::runtime_error("Failed to write " + path.string());
+    }
+}
+
+// Whether a generated file was written out in full. Generation writes to a temporary name
+// and renames, this also catches files cut short by older versions of the harness.
+bool complete_torus(const std::filesystem::path& path, bool binary, size_t triangles) {
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+    if (binary) {
+        const auto [segments, rings] = torus_grid(triangles);
+        return size == STL_RECORD_OFFSET + uint64_t(2) * segments * rings * STL_RECORD_SIZE;
+    }
+    const std::string_view tail = "endsolid torus\n";
+    std::ifstream in(path, std::ios::binary);
+    std::string last(tail.size(), '\0');
+    return size >= tail.size() && in.seekg(static_cast<std::streamoff>(size - tail.size()))
+           && in.read(last.data(), static_cast<std::streamsize>(last.size())) && last == tail;
+}
+
+// The original Mesh loader: ifstream reads of four bytes at a time, kept as the baseline
+std::vector<Vertex> stream_parse(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    file.seekg(STL_HEADER_SIZE, std::ios::beg);
+    std::array<char, 4> buffer;
+    file.read(buffer.data(), buffer.size());
+    unsigned int triangle_count;
+    std::memcpy(&triangle_count, buffer.data(), sizeof(triangle_count));
+
+    std::vector<Vertex> vertices;
+    vertices.reserve(size_t(triangle_count) * 3);
+    while (triangle_count > 0 && file) {
+        file.seekg(12, std::ios::cur);
+        for (int v = 0; v < 3; ++v) {
+            float xyz[3];
+            for (float& coordinate : xyz) {
+                file.read(buffer.data(), buffer.size());
+                std::memcpy(&coordinate, buffer.data(), sizeof(float));
+            }
+            vertices.push_back({glm::vec3(xyz[0], xyz[1], xyz[2]), glm::vec3(0.0f)});
+        }
+        file.seekg(2, std::ios::cur);
+        --triangle_count;
+    }
+    return vertices;
+}
+
+// Best of `repeat` runs of `timed`, each after an untimed `setup`
+double best_of(int repeat, const std::function<void()>& setup, const std::function<void()>& timed) {
+    double best = std::numeric_limits<double>::max();
+    for (int i = 0; i < repeat; ++i) {
+        setup();
+        auto start = std::chrono::steady_clock::now();
+        timed();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+RunResult bench_file(const std::filesystem::path& path, const char* format, const BenchOptions& options,
+                     bool upload) {
+    RunResult run{format, 0, std::filesystem::file_size(path), {}};
+    const int repeat = options.repeat;
+    auto nothing = [] {};
+
+    if (std::string_view(format) == "binary") {
+        run.stages.push_back({"parse_stream", best_of(repeat, nothing, [&] { stream_parse(path); })});
+    }
+    StlLoadOptions serial;
+    serial.threads = 1;
+    run.stages.push_back({"parse_serial", best_of(repeat, nothing, [&] { load_stl(path, serial); })});
+    StlLoadResult stl;
+    run.stages.push_back({"parse_parallel", best_of(repeat, nothing, [&] { stl = load_stl(path); })});
+    run.triangles = stl.recovered_triangles;
+
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    auto reset = [&] {
+        vertices = stl.vertices;
+        indices.resize(vertices.size());
+        std::iota(indices.begin(), indices.end(), 0u);
+    };
+    run.stages.push_back({"weld", best_of(repeat, reset, [&] { weld_vertices(vertices, indices, 0.0f); })});
+
+    std::vector<Vertex> welded_vertices = vertices;
+    std::vector<unsigned int> welded_indices = indices;
+    auto reset_welded = [&] {
+        vertices = welded_vertices;
+        indices = welded_indices;
+    };
+    run.stages.push_back({"normals", best_of(repeat, reset_welded, [&] {
+        compute_smooth_normals(vertices, indices, 30.0f);
+    })});
+
+    // Runs on the split normals, so matching corners by position is part of the measurement
+    run.stages.push_back({"analyze", best_of(repeat, nothing, [&] { analyze_mesh(vertices, indices); })});
+
+    welded_vertices = vertices;
+    welded_indices = indices;
+    run.stages.push_back({"optimize", best_of(repeat, reset_welded, [&] {
+        optimize_vertex_cache(indices, vertices.size());
+        optimize_vertex_fetch(vertices, indices);
+    })});
+
+    const std::vector<float> ratios = {0.5f, 0.25f, 0.1f, 0.02f};
+    std::vector<MeshLod> lods;
+    run.stages.push_back({"simplify", best_of(repeat, nothing, [&] { lods = build_lod_chain(vertices, indices, ratios); })});
+
+    GpuMeshData gpu;
+    run.stages.push_back({"pack", best_of(repeat, nothing, [&] {
+        gpu = build_gpu_mesh(vertices, indices, VertexLayout::PositionNormal, true, lods);
+    })});
+
+    if (upload) {
+        // glFinish so the copy to the GPU is inside the measurement, not just the driver queueing it
+        run.stages.push_back({"upload", best_of(repeat, nothing, [&] {
+            GLuint buffers[2];
+            glGenBuffers(2, buffers);
+            glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+            glBufferData(GL_ARRAY_BUFFER, gpu.vertex_data.size(), gpu.vertex_data.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, gpu.index_data.size(), gpu.index_data.data(), GL_STATIC_DRAW);
+            glFinish();
+            glDeleteBuffers(2, buffers);
+        })});
+    }
+    return run;
+}
+
+// The driver may keep its own shader cache (Mesa does by default), which makes repeated cold
+// runs look warmer than a first launch. MESA_SHADER_CACHE_DISABLE=true shows the full cost.
+StartupResult bench_startup(const BenchOptions& options) {
+    StartupResult result;
+    result.measured = true;
+    result.program_binaries = ProgramCache::supported();
+    std::filesystem::path directory = options.directory / "programs";
+    auto clear = [&] {
+        std::filesystem::remove_all(directory);
+    };
+    auto create = [&] {
+        ProgramCache cache(directory);
+        Shader shader = Shader::embedded("shader.vert", "lit.frag", &cache);
+        glFinish();
+    };
+    result.cold_seconds = best_of(options.repeat, clear, create);
+    result.warm_seconds = best_of(options.repeat, [] {}, create);
+    clear();
+    return result;
+}
+
+void write_json(std::ostream& out, const BenchOptions& options, const StartupResult& startup,
+                const std::vector<RunResult>& runs) {
+    out << "{\n  \"commit\": \"" << options.commit << "\",\n  \"threads\": " << std::thread::hardware_concurrency()
+        << ",\n  \"repeat\": " << options.repeat << ",";
+    if (startup.measured) {
+        out << "\n  \"startup\": {\"program_binaries\": " << (startup.program_binaries ? "true" : "false")
+            << ", \"shaders_cold_seconds\": " << startup.cold_seconds << ", \"shaders_warm_seconds\": "
+            << startup.warm_seconds << "},";
+    }
+    out << "\n  \"runs\": [";
+    for (size_t r = 0; r < runs.size(); ++r) {
+        const RunResult& run = runs[r];
+        out << (r ? "," : "") << "\n    {\"format\": \"" << run.format << "\", \"triangles\": " << run.triangles
+            << ", \"file_bytes\": " << run.file_bytes << ", \"stages\": [";
+        for (size_t s = 0; s < run.stages.size(); ++s) {
+            const StageResult& stage = run.stages[s];
+            double seconds = std::max(stage.seconds, 1e-9);
+            out << (s ? "," : "") << "\n      {\"stage\": \"" << stage.stage << "\", \"seconds\": " << stage.seconds
+                << ", \"mb_per_s\": " << run.file_bytes / 1e6 / seconds
+                << ", \"triangles_per_s\": " << run.triangles / seconds << "}";
+        }
+        out << "\n    ]}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--dir" && i + 1 < argc) {
+            options.directory = argv[++i];
+        } else if (arg == "--max-triangles" && i + 1 < argc) {
+            options.max_triangles = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            options.repeat = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--commit" && i + 1 < argc) {
+            options.commit = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            options.output = argv[++i];
+        } else if (arg == "--no-upload") {
+            options.upload = false;
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--dir DIR] [--max-triangles N] [--repeat N] [--commit ID] [--output FILE] [--no-upload]\n";
+            return 1;
+        }
+    }
+
+    std::unique_ptr<HeadlessContext> context;
+    if (options.upload) {
+        try {
+            context = std::make_unique<HeadlessContext>();
+        } catch (const std::exception& e) {
+            std::cerr << "Warning: skipping the upload stage, " << e.what() << "\n";
+        }
+    }
+
+    // Files are generated once and reused while complete, the name carries the requested size
+    std::filesystem::create_directories(options.directory);
+    StartupResult startup;
+    if (context) {
+        startup = bench_startup(options);
+    }
+    std::vector<RunResult> runs;
+    for (size_t triangles : SIZES) {
+        if (triangles > options.max_triangles) {
+            break;
+        }
+        std::vector<Vertex> vertices;
+        for (const char* format : {"binary", "ascii"}) {
+            bool binary = std::string_view(format) == "binary";
+            std::filesystem::path path = options.directory / ("torus_" + std::to_string(triangles) + "_" + format + ".stl");
+            if (!complete_torus(path, binary, triangles)) {
+                if (vertices.empty()) {
+                    vertices = make_torus(triangles);
+                }
+                // Renamed into place once written, so an interrupted run never leaves a short file behind
+                std::cerr << "Generating " << path << "\n";
+                std::filesystem::path partial = path;
+                partial += ".partial";
+                binary ? write_binary(partial, vertices) : write_ascii(partial, vertices);
+                std::filesystem::rename(partial, path);
+            }
+            std::cerr << "Timing " << path << "\n";
+            runs.push_back(bench_file(path, format, options, context != nullptr));
+        }
+    }
+
+    if (options.output.empty()) {
+        write_json(std::cout, options, startup, runs);
+    } else {
+        std::ofstream out(options.output, std::ios::trunc);
+        write_json(out, options, startup, runs);
+        std::cerr << "Wrote " << options.output << "\n";
+    }
+    return 0;
+}
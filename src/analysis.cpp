@@ -0,0 +1,302 @@
+#include "analysis.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr unsigned int PARTITION_BITS = 8;
+constexpr size_t PARTITIONS = size_t(1) << PARTITION_BITS;
+
+struct PositionKey {
+    uint32_t x, y, z;
+
+    bool operator==(const PositionKey& o) const { return x == o.x && y == o.y && z == o.z; }
+};
+
+// Bit pattern of the position, + 0.0f folds -0 into +0 like an exact weld
+PositionKey key_of(const glm::vec3& p) {
+    PositionKey key;
+    float xyz[3] = {p.x + 0.0f, p.y + 0.0f, p.z + 0.0f};
+    std::memcpy(&key, xyz, sizeof(key));
+    return key;
+}
+
+uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    return h ^ (h >> 33);
+}
+
+uint64_t hash_position(const PositionKey& k) {
+    return mix(k.x ^ (uint64_t(k.y) << 32) ^ mix(k.z));
+}
+
+size_t partition_of(uint64_t hash) {
+    return static_cast<size_t>(hash >> (64 - PARTITION_BITS));
+}
+
+// Gathers what every range visits into one array, grouped by partition. Each range counts
+// its items per partition, then scatters them at offsets from the counts, so partition p
+// is items[starts[p], starts[p + 1]) in range order and can be worked on by itself.
+// for_each(chunk, visit) calls visit(partition, item) for each item of the range.
+template <typename T, typename ForEach>
+void partition_items(size_t chunks, unsigned int threads, ForEach&& for_each, std::vector<T>& items,
+                     std::vector<size_t>& starts) {
+    ThreadPool& pool = ThreadPool::shared();
+    std::vector<size_t> counts(chunks * PARTITIONS, 0);
+    pool.run(chunks, threads, [&](size_t chunk) {
+        size_t* count = &counts[chunk * PARTITIONS];
+        for_each(chunk, [&](size_t partition, const T&) { ++count[partition]; });
+    });
+
+    // Partition major offsets, the ranges of one partition follow each other in order
+    starts.assign(PARTITIONS + 1, 0);
+    std::vector<size_t> cursors(chunks * PARTITIONS);
+    size_t total = 0;
+    for (size_t p = 0; p < PARTITIONS; ++p) {
+        starts[p] = total;
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            cursors[chunk * PARTITIONS + p] = total;
+            total += counts[chunk * PARTITIONS + p];
+        }
+    }
+    starts[PARTITIONS] = total;
+
+    items.resize(total);
+    pool.run(chunks, threads, [&](size_t chunk) {
+        size_t* cursor = &cursors[chunk * PARTITIONS];
+        for_each(chunk, [&](size_t partition, const T& item) { items[cursor[partition]++] = item; });
+    });
+}
+
+// First vertex at each position, so corners of split normals share their edges. Returns
+// the number of distinct positions. Vertices are partitioned by position hash, and each
+// partition sees its vertices in index order, so the first one is found without locking.
+size_t canonical_vertices(std::span<const Vertex> vertices, std::vector<uint32_t>& canonical, size_t chunks,
+                          unsigned int threads) {
+    std::vector<uint32_t> order;
+    std::vector<size_t> starts;
+    partition_items<uint32_t>(chunks, threads, [&](size_t chunk, auto&& visit) {
+        size_t begin = vertices.size() * chunk / chunks;
+        size_t end = vertices.size() * (chunk + 1) / chunks;
+        for (size_t i = begin; i < end; ++i) {
+            visit(partition_of(hash_position(key_of(vertices[i].position))), static_cast<uint32_t>(i));
+        }
+    }, order, starts);
+
+    constexpr uint32_t EMPTY = ~0u;
+    canonical.resize(vertices.size());
+    std::vector<size_t> distinct(PARTITIONS, 0);
+    ThreadPool::shared().run(PARTITIONS, threads, [&](size_t p) {
+        size_t count = starts[p + 1] - starts[p];
+        size_t capacity = 16;
+        while (capacity < count * 2) {
+            capacity <<= 1;
+        }
+        std::vector<uint32_t> table(capacity, EMPTY);
+        for (size_t k = starts[p]; k < starts[p + 1]; ++k) {
+            uint32_t i = order[k];
+            PositionKey key = key_of(vertices[i].position);
+            // The top bits picked the partition, the low bits are still spread
+            size_t slot = hash_position(key) & (capacity - 1);
+            while (table[slot] != EMPTY && !(key_of(vertices[table[slot]].position) == key)) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            if (table[slot] == EMPTY) {
+                table[slot] = i;
+                ++distinct[p];
+            }
+            canonical[i] = table[slot];
+        }
+    });
+    size_t total = 0;
+    for (size_t d : distinct) {
+        total += d;
+    }
+    return total;
+}
+
+// Min and max over the positions, the x, y, z lanes of one unaligned load per vertex
+Bounds position_bounds(const Vertex* vertices, size_t count) {
+    Bounds bounds{glm::vec3(std::numeric_limits<float>::max()), glm::vec3(-std::numeric_limits<float>::max())};
+    size_t i = 0;
+#ifdef __SSE2__
+    // Reads position and normal.x, which Vertex keeps contiguous
+    static_assert(sizeof(Vertex) >= 4 * sizeof(float));
+    __m128 lo = _mm_set1_ps(std::numeric_limits<float>::max());
+    __m128 hi = _mm_set1_ps(-std::numeric_limits<float>::max());
+    for (; i < count; ++i) {
+        __m128 p = _mm_loadu_ps(&vertices[i].position.x);
+        lo = _mm_min_ps(lo, p);
+        hi = _mm_max_ps(hi, p);
+    }
+    alignas(16) float lo_out[4], hi_out[4];
+    _mm_store_ps(lo_out, lo);
+    _mm_store_ps(hi_out, hi);
+    bounds.min = glm::vec3(lo_out[0], lo_out[1], lo_out[2]);
+    bounds.max = glm::vec3(hi_out[0], hi_out[1], hi_out[2]);
+#endif
+    for (; i < count; ++i) {
+        bounds.min = glm::min(bounds.min, vertices[i].position);
+        bounds.max = glm::max(bounds.max, vertices[i].position);
+    }
+    return bounds;
+}
+
+struct Sums {
+    double area = 0.0;
+    double volume = 0.0;
+    size_t degenerate = 0;
+};
+
+struct EdgeCounts {
+    size_t edges = 0;
+    size_t open = 0;
+    size_t non_manifold = 0;
+};
+
+}
+
+MeshAnalysis analyze_mesh(std::span<const Vertex> vertices, std::span<const unsigned int> indices,
+                          unsigned int threads) {
+    MeshAnalysis result;
+    result.triangles = indices.size() / 3;
+    if (vertices.empty() || result.triangles == 0) {
+        return result;
+    }
+    threads = resolve_thread_count(threads);
+    // Ranges depend on the size alone so the double sums come out the same for any thread count
+    const size_t chunks = std::clamp<size_t>(result.triangles / 65536, 1, 256);
+    ThreadPool& pool = ThreadPool::shared();
+
+    std::vector<Bounds> chunk_bounds(chunks);
+    pool.run(chunks, threads, [&](size_t chunk) {
+        size_t begin = vertices.size() * chunk / chunks;
+        size_t end = vertices.size() * (chunk + 1) / chunks;
+        chunk_bounds[chunk] = position_bounds(vertices.data() + begin, end - begin);
+    });
+    result.bounds = chunk_bounds[0];
+    for (const Bounds& b : chunk_bounds) {
+        result.bounds.min = glm::min(result.bounds.min, b.min);
+        result.bounds.max = glm::max(result.bounds.max, b.max);
+    }
+
+    std::vector<uint32_t> canonical;
+    result.vertices = canonical_vertices(vertices, canonical, chunks, threads);
+
+    // Volume is taken about the center of the bounds, which keeps the cancellation between
+    // far away triangles small. Per range sums are added in order, so any thread count
+    // gives the same total.
+    const glm::dvec3 origin = glm::dvec3(result.bounds.center());
+    std::vector<Sums> sums(chunks);
+    pool.run(chunks, threads, [&](size_t chunk) {
+        size_t begin = result.triangles * chunk / chunks;
+        size_t end = result.triangles * (chunk + 1) / chunks;
+        Sums s;
+        for (size_t t = begin; t < end; ++t) {
+            const unsigned int* tri = &indices[t * 3];
+            glm::dvec3 p0 = glm::dvec3(vertices[tri[0]].position) - origin;
+            glm::dvec3 p1 = glm::dvec3(vertices[tri[1]].position) - origin;
+            glm::dvec3 p2 = glm::dvec3(vertices[tri[2]].position) - origin;
+            glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+            double twice_area = glm::length(n);
+            s.area += twice_area;
+            s.volume += glm::dot(p0, glm::cross(p1, p2));
+            uint32_t a = canonical[tri[0]], b = canonical[tri[1]], c = canonical[tri[2]];
+            s.degenerate += twice_area == 0.0 || a == b || b == c || a == c;
+        }
+        sums[chunk] = s;
+    });
+    for (const Sums& s : sums) {
+        result.surface_area += s.area * 0.5;
+        result.volume += s.volume / 6.0;
+        result.degenerate_triangles += s.degenerate;
+    }
+
+    // Undirected edges as (low, high) canonical ids, partitioned by hash
+    auto edge_key = [&](uint32_t a, uint32_t b) {
+        return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+    };
+    std::vector<uint64_t> keys;
+    std::vector<size_t> starts;
+    partition_items<uint64_t>(chunks, threads, [&](size_t chunk, auto&& visit) {
+        size_t begin = result.triangles * chunk / chunks;
+        size_t end = result.triangles * (chunk + 1) / chunks;
+        for (size_t t = begin; t < end; ++t) {
+            uint32_t c[3] = {canonical[indices[t * 3]], canonical[indices[t * 3 + 1]], canonical[indices[t * 3 + 2]]};
+            for (int e = 0; e < 3; ++e) {
+                uint32_t a = c[e], b = c[(e + 1) % 3];
+                // Collapsed edges of degenerate triangles join nothing
+                if (a != b) {
+                    uint64_t key = edge_key(a, b);
+                    visit(partition_of(mix(key)), key);
+                }
+            }
+        }
+    }, keys, starts);
+
+    // Each partition counts its keys in its own open addressing table. Key 0 would be an
+    // edge from vertex 0 to itself, which never gets here, so it marks empty slots.
+    std::vector<EdgeCounts> edge_counts(PARTITIONS);
+    pool.run(PARTITIONS, threads, [&](size_t p) {
+        size_t count = starts[p + 1] - starts[p];
+        size_t capacity = 16;
+        while (capacity < count * 2) {
+            capacity <<= 1;
+        }
+        std::vector<uint64_t> table(capacity, 0);
+        std::vector<uint32_t> uses(capacity, 0);
+        for (size_t k = starts[p]; k < starts[p + 1]; ++k) {
+            uint64_t key = keys[k];
+            // The top bits picked the partition, the low bits are still spread
+            size_t slot = mix(key) & (capacity - 1);
+            while (table[slot] != 0 && table[slot] != key) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            table[slot] = key;
+            ++uses[slot];
+        }
+        EdgeCounts c;
+        for (size_t slot = 0; slot < capacity; ++slot) {
+            c.edges += uses[slot] != 0;
+            c.open += uses[slot] == 1;
+            c.non_manifold += uses[slot] > 2;
+        }
+        edge_counts[p] = c;
+    });
+    for (const EdgeCounts& c : edge_counts) {
+        result.edges += c.edges;
+        result.open_edges += c.open;
+        result.non_manifold_edges += c.non_manifold;
+    }
+    return result;
+}
+
+void print_analysis(std::ostream& out, const std::filesystem::path& name, const MeshAnalysis& analysis) {
+    glm::vec3 size = analysis.bounds.extent();
+    out << name.string() << "\n"
+        << "  triangles:          " << analysis.triangles << "\n"
+        << "  vertices:           " << analysis.vertices << "\n"
+        << "  edges:              " << analysis.edges << "\n"
+        << "  open edges:         " << analysis.open_edges << "\n"
+        << "  non-manifold edges: " << analysis.non_manifold_edges << "\n"
+        << "  degenerate:         " << analysis.degenerate_triangles << "\n"
+        << "  watertight:         " << (analysis.watertight() ? "yes" : "no") << "\n"
+        << "  bounds:             (" << analysis.bounds.min.x << ", " << analysis.bounds.min.y << ", "
+        << analysis.bounds.min.z << ") - (" << analysis.bounds.max.x << ", " << analysis.bounds.max.y << ", "
+        << analysis.bounds.max.z << ")\n"
+        << "  size:               " << size.x << " x " << size.y << " x " << size.z << "\n"
+        << "  surface area:       " << analysis.surface_area << "\n"
+        << "  volume:             " << analysis.volume << (analysis.watertight() ? "" : " (not closed)") << "\n";
+}
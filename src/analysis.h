@@ -0,0 +1,37 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <cstddef>
+#include <filesystem>
+#include <iosfwd>
+#include <span>
+#include "vertex.h"
+
+struct MeshAnalysis {
+    size_t triangles = 0;
+    size_t vertices = 0;            // distinct positions, copies made for normals count once
+    size_t degenerate_triangles = 0;    // zero area, or two corners at the same position
+    size_t edges = 0;               // distinct undirected edges
+    size_t open_edges = 0;          // used by one triangle
+    size_t non_manifold_edges = 0;  // used by three or more triangles
+    Bounds bounds;
+    double surface_area = 0.0;
+    // Signed by winding, positive when the triangles face outwards. Only a volume when the
+    // mesh is watertight, otherwise it depends on where the holes are.
+    double volume = 0.0;
+
+    bool watertight() const { return open_edges == 0 && non_manifold_edges == 0; }
+};
+
+// Topology and measurements of an indexed triangle mesh. Corners are matched by exact
+// position, so unwelded meshes and meshes with split normals analyze like welded ones.
+// Corners and edges are hashed into partitions in parallel and each partition is matched
+// on its own, area and volume are summed in double per contiguous range, so the result is
+// the same for any thread count.
+MeshAnalysis analyze_mesh(std::span<const Vertex> vertices, std::span<const unsigned int> indices,
+                          unsigned int threads = 0);
+
+// Human readable report, one value per line
+void print_analysis(std::ostream& out, const std::filesystem::path& name, const MeshAnalysis& analysis);
+
+#endif
@@ -0,0 +1,137 @@
+#include "arena.h"
+#include "util.h"
+#include <GLFW/glfw3.h>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+size_t ArenaMesh::triangle_count(size_t lod) const {
+    if (lod >= lods.size()) {
+        return 0;
+    }
+    size_t count = 0;
+    for (unsigned int i = 0; i < lods[lod].submesh_count; ++i) {
+        count += submeshes[lods[lod].first_submesh + i].count;
+    }
+    return count / 3;
+}
+
+MeshArena::MeshArena(VertexLayout layout, unsigned int index_size, size_t vertex_capacity, size_t index_capacity)
+    : layout(layout), index_size(index_size), vertex_capacity(vertex_capacity), index_capacity(index_capacity) {
+    // The glad loader stops at 4.2, so the entry point is looked up by hand
+    if (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 3)
+        || glfwExtensionSupported("GL_ARB_multi_draw_indirect")) {
+        multi_draw = reinterpret_cast<MultiDrawProc>(glfwGetProcAddress("glMultiDrawElementsIndirect"));
+    }
+}
+
+MeshArena::~MeshArena() {
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+}
+
+void MeshArena::reserve(GLuint& buffer, size_t& capacity, size_t used, size_t needed) {
+    if (buffer != 0 && used + needed <= capacity) {
+        return;
+    }
+    size_t grown_capacity = buffer == 0 ? capacity : capacity * 2;
+    while (grown_capacity < used + needed) {
+        grown_capacity *= 2;
+    }
+
+    GLuint grown;
+    glGenBuffers(1, &grown);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+    glBufferData(GL_COPY_WRITE_BUFFER, grown_capacity, nullptr, GL_STATIC_DRAW);
+    if (used > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+    }
+    glDeleteBuffers(1, &buffer);
+    buffer = grown;
+    capacity = grown_capacity;
+
+    // Point the VAO at the new storage
+    if (VAO == 0) {
+        glGenVertexArrays(1, &VAO);
+    }
+    glBindVertexArray(VAO);
+    if (VBO) {
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        setup_vertex_attributes(layout);
+    }
+    if (EBO) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    }
+    glBindVertexArray(0);
+}
+
+size_t MeshArena::add(const GpuMeshView& mesh) {
+    if (mesh.layout != layout || mesh.index_size > index_size) {
+        throw std::runtime_error("Mesh does not match the arena's vertex layout or index size");
+    }
+
+    // build_gpu_mesh emits 16 bit indices for any small mesh, split or not
+    std::span<const unsigned char> index_data = mesh.index_data;
+    std::vector<unsigned char> widened;
+    if (mesh.index_size < index_size) {
+        const size_t count = mesh.index_data.size() / sizeof(uint16_t);
+        widened.resize(count * sizeof(uint32_t));
+        for (size_t i = 0; i < count; ++i) {
+            uint16_t narrow;
+            std::memcpy(&narrow, mesh.index_data.data() + i * sizeof(uint16_t), sizeof(narrow));
+            uint32_t wide = narrow;
+            std::memcpy(widened.data() + i * sizeof(uint32_t), &wide, sizeof(wide));
+        }
+        index_data = widened;
+    }
+
+    reserve(VBO, vertex_capacity, vertex_used, mesh.vertex_data.size());
+    reserve(EBO, index_capacity, index_used, index_data.size());
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, vertex_used, mesh.vertex_data.size(), mesh.vertex_data.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, index_used, index_data.size(), index_data.data());
+
+    ArenaMesh entry;
+    entry.layout = mesh.layout;
+    entry.bounds = mesh.bounds;
+    const GLint first_vertex = static_cast<GLint>(vertex_used / vertex_stride(layout));
+    const GLuint first_index = static_cast<GLuint>(index_used / index_size);
+    for (const Submesh& sub : mesh.submeshes) {
+        entry.submeshes.push_back({sub.index_count, 0, first_index + static_cast<GLuint>(sub.index_offset / mesh.index_size),
+                                   first_vertex + sub.base_vertex, 0});
+    }
+    entry.lods.assign(mesh.lods.begin(), mesh.lods.end());
+    if (entry.lods.empty()) {
+        entry.lods.push_back({0, static_cast<unsigned int>(entry.submeshes.size()), 0.0f});
+    }
+
+    vertex_used += mesh.vertex_data.size();
+    index_used += index_data.size();
+    meshes.push_back(std::move(entry));
+    return meshes.size() - 1;
+}
+
+void MeshArena::bind(GLuint instance_buffer) const {
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+    setup_instance_attributes();
+}
+
+size_t MeshArena::draw_indirect(size_t offset, size_t count) const {
+    if (count == 0) {
+        return 0;
+    }
+    GLenum type = index_size == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    if (multi_draw) {
+        multi_draw(GL_TRIANGLES, type, (void*) offset, static_cast<GLsizei>(count), 0);
+        return 1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        glDrawElementsIndirect(GL_TRIANGLES, type, (void*) (offset + i * sizeof(DrawElementsIndirectCommand)));
+    }
+    return count;
+}
@@ -0,0 +1,78 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <vector>
+#include <glad/glad.h>
+#include "gpu_mesh.h"
+
+// Same layout as GL's DrawElementsIndirectCommand
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+};
+
+// A mesh suballocated from an arena. Its submeshes are ready made commands with offsets
+// into the shared buffers, only the instance fields are left for the caller.
+struct ArenaMesh {
+    VertexLayout layout;
+    Bounds bounds;
+    std::vector<DrawElementsIndirectCommand> submeshes;
+    std::vector<LodRange> lods;
+
+    size_t triangle_count(size_t lod = 0) const;
+};
+
+// Geometry of many meshes in one vertex and one index buffer behind a single VAO, so any
+// set of them draws with one glMultiDrawElementsIndirect. Meshes must share the arena's
+// vertex layout, 16 bit indices are widened when the arena uses 32 bit ones. Buffers are
+// created on the first add() and double with glCopyBufferSubData when they fill up.
+class MeshArena {
+    public:
+        MeshArena(VertexLayout layout, unsigned int index_size = 2, size_t vertex_capacity = size_t(32) << 20,
+                  size_t index_capacity = size_t(16) << 20);
+
+        ~MeshArena();
+
+        MeshArena(const MeshArena&) = delete;
+        MeshArena& operator=(const MeshArena&) = delete;
+
+        // Copies the mesh's buffers in and returns its index
+        size_t add(const GpuMeshView& mesh);
+
+        const ArenaMesh& mesh(size_t index) const { return meshes[index]; }
+
+        size_t size() const { return meshes.size(); }
+
+        VertexLayout vertex_layout() const { return layout; }
+
+        // Binds the VAO with InstanceData from `instance_buffer` behind the instance attributes
+        void bind(GLuint instance_buffer) const;
+
+        // Draws `count` commands starting `offset` bytes into the bound GL_DRAW_INDIRECT_BUFFER.
+        // Returns the number of draw calls that took, 1 with multi draw indirect support.
+        size_t draw_indirect(size_t offset, size_t count) const;
+
+        // glMultiDrawElementsIndirect is core in 4.3, earlier contexts need the ARB extension
+        bool has_multi_draw() const { return multi_draw != nullptr; }
+
+    private:
+        typedef void (APIENTRYP MultiDrawProc)(GLenum mode, GLenum type, const void* indirect, GLsizei draw_count,
+                                               GLsizei stride);
+
+        VertexLayout layout;
+        unsigned int index_size;
+        GLuint VAO = 0, VBO = 0, EBO = 0;
+        size_t vertex_capacity, index_capacity;
+        size_t vertex_used = 0, index_used = 0;     // bytes
+        std::vector<ArenaMesh> meshes;
+        MultiDrawProc multi_draw = nullptr;
+
+        // Makes room for `needed` more bytes in `buffer`, keeping the first `used`
+        void reserve(GLuint& buffer, size_t& capacity, size_t used, size_t needed);
+};
+
+#endif
@@ -0,0 +1,249 @@
+#include "batch.h"
+#include "analysis.h"
+#include "pipeline.h"
+#include "stl.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <set>
+#include <stdexcept>
+
+bool glob_match(std::string_view pattern, std::string_view path) {
+    while (!pattern.empty()) {
+        if (pattern.starts_with("**")) {
+            pattern.remove_prefix(2);
+            if (pattern.starts_with('/')) {
+                // Zero or more whole directories
+                pattern.remove_prefix(1);
+                for (size_t i = 0;;) {
+                    if (glob_match(pattern, path.substr(i))) {
+                        return true;
+                    }
+                    i = path.find('/', i);
+                    if (i == std::string_view::npos) {
+                        return false;
+                    }
+                    ++i;
+                }
+            }
+            // Anywhere else it crosses separators freely
+            for (size_t i = 0; i <= path.size(); ++i) {
+                if (glob_match(pattern, path.substr(i))) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        if (pattern.front() == '*') {
+            pattern.remove_prefix(1);
+            for (size_t i = 0; i <= path.size(); ++i) {
+                if (glob_match(pattern, path.substr(i))) {
+                    return true;
+                }
+                if (i < path.size() && path[i] == '/') {
+                    return false;
+                }
+            }
+            return false;
+        }
+        if (path.empty() || (pattern.front() == '?' ? path.front() == '/' : pattern.front() != path.front())) {
+            return false;
+        }
+        pattern.remove_prefix(1);
+        path.remove_prefix(1);
+    }
+    return path.empty();
+}
+
+static bool has_wildcard(std::string_view text) {
+    return text.find_first_of("*?") != std::string_view::npos;
+}
+
+static bool is_stl(const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension == ".stl";
+}
+
+static void expand_pattern(const std::string& input, std::vector<std::filesystem::path>& out) {
+    // Leading components without wildcards name the directory to search from
+    std::filesystem::path base;
+    std::string rest;
+    for (const std::filesystem::path& part : std::filesystem::path(input)) {
+        if (!rest.empty() || has_wildcard(part.string())) {
+            rest += (rest.empty() ? "" : "/") + part.string();
+        } else {
+            base /= part;
+        }
+    }
+
+    std::vector<std::filesystem::path> matches;
+    std::error_code ec;
+    std::filesystem::path root = base.empty() ? std::filesystem::path(".") : base;
+    auto consider = [&](const std::filesystem::directory_entry& e) {
+        if (e.is_regular_file(ec)) {
+            std::filesystem::path relative = e.path().lexically_relative(root);
+            if (glob_match(rest, relative.generic_string())) {
+                matches.push_back(base.empty() ? relative : e.path());
+            }
+        }
+    };
+    if (rest.find('/') == std::string::npos && rest.find("**") == std::string::npos) {
+        for (const auto& e : std::filesystem::directory_iterator(root, ec)) {
+            consider(e);
+        }
+    } else {
+        for (const auto& e : std::filesystem::recursive_directory_iterator(root, ec)) {
+            consider(e);
+        }
+    }
+
+    if (matches.empty()) {
+        std::cerr << "Warning: no files match " << input << "\n";
+    }
+    std::sort(matches.begin(), matches.end());
+    out.insert(out.end(), matches.begin(), matches.end());
+}
+
+static void expand_list(std::istream& in, std::vector<std::string>& inputs) {
+    std::string line;
+    while (std::getline(in, line)) {
+        line.erase(std::find(line.begin(), line.end(), '#'), line.end());
+        size_t begin = line.find_first_not_of(" \t\r");
+        if (begin != std::string::npos) {
+            inputs.push_back(line.substr(begin, line.find_last_not_of(" \t\r") + 1 - begin));
+        }
+    }
+}
+
+std::vector<std::filesystem::path> expand_inputs(const std::vector<std::string>& inputs) {
+    std::vector<std::filesystem::path> paths;
+    for (const std::string& input : inputs) {
+        std::error_code ec;
+        if (input.starts_with('@')) {
+            std::vector<std::string> listed;
+            if (input == "@-") {
+                expand_list(std::cin, listed);
+            } else if (std::ifstream list(input.substr(1)); list) {
+                expand_list(list, listed);
+            } else {
+                std::cerr << "Warning: could not read input list " << input.substr(1) << "\n";
+            }
+            std::vector<std::filesystem::path> expanded = expand_inputs(listed);
+            paths.insert(paths.end(), expanded.begin(), expanded.end());
+        } else if (std::filesystem::is_directory(input, ec)) {
+            std::vector<std::filesystem::path> found;
+            for (const auto& e : std::filesystem::recursive_directory_iterator(input, ec)) {
+                if (e.is_regular_file(ec) && is_stl(e.path())) {
+                    found.push_back(e.path());
+                }
+            }
+            std::sort(found.begin(), found.end());
+            paths.insert(paths.end(), found.begin(), found.end());
+        } else if (has_wildcard(input) && !std::filesystem::exists(input, ec)) {
+            expand_pattern(input, paths);
+        } else {
+            paths.emplace_back(input);
+        }
+    }
+    return paths;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+BatchReport analyze_files(const BatchOptions& options, std::ostream& out) {
+    BatchReport report;
+    auto start = std::chrono::steady_clock::now();
+
+    // Topology only needs welded positions, skip the work that serves rendering
+    MeshLoadOptions load = options.load;
+    load.normals = NormalMode::File;
+    load.optimize = false;
+    load.lod_ratios.clear();
+
+    struct Result {
+        std::optional<MeshAnalysis> analysis;
+        std::string error;
+    };
+    const unsigned int jobs = resolve_thread_count(options.jobs);
+    run_pipeline<Result>(options.inputs.size(), size_t(jobs) * 2, jobs, [&](size_t i) {
+        Result result;
+        try {
+            MeshData data = load_mesh_data(options.inputs[i], load);
+            result.analysis = analyze_mesh(data.vertices, data.indices, load.threads);
+        } catch (const std::exception& e) {
+            result.error = e.what();
+        }
+        return result;
+    }, [&](size_t i, Result result) {
+        if (!result.analysis) {
+            std::cerr << "Error: " << options.inputs[i] << ": " << result.error << "\n";
+            ++report.failures;
+            return;
+        }
+        print_analysis(out, options.inputs[i], *result.analysis);
+        ++report.files;
+        report.flagged += !result.analysis->watertight();
+    });
+
+    report.seconds = seconds_since(start);
+    return report;
+}
+
+BatchReport convert_files(const BatchOptions& options, const std::filesystem::path& output_directory, bool ascii) {
+    BatchReport report;
+    auto start = std::chrono::steady_clock::now();
+    std::filesystem::create_directories(output_directory);
+
+    // Two inputs with the same stem would silently overwrite each other
+    std::vector<std::filesystem::path> outputs;
+    std::set<std::filesystem::path> seen;
+    for (const auto& input : options.inputs) {
+        outputs.push_back(output_directory / input.stem());
+        outputs.back() += ".stl";
+        if (!seen.insert(outputs.back()).second) {
+            throw std::runtime_error("More than one input converts to " + outputs.back().string());
+        }
+    }
+
+    struct Result {
+        StlLoadResult stl;
+        std::string error;
+    };
+    StlLoadOptions load;
+    load.threads = options.load.threads;
+    const unsigned int jobs = resolve_thread_count(options.jobs);
+    run_pipeline<Result>(options.inputs.size(), size_t(jobs) * 2, jobs, [&](size_t i) {
+        Result result;
+        try {
+            result.stl = load_stl(options.inputs[i], load);
+        } catch (const std::exception& e) {
+            result.error = e.what();
+        }
+        return result;
+    }, [&](size_t i, Result result) {
+        try {
+            std::error_code ec;
+            if (!result.error.empty()) {
+                throw std::runtime_error(result.error);
+            }
+            if (std::filesystem::equivalent(options.inputs[i], outputs[i], ec)) {
+                throw std::runtime_error("Output would overwrite the input");
+            }
+            write_stl(outputs[i], result.stl.vertices, ascii);
+            ++report.files;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << options.inputs[i] << ": " << e.what() << "\n";
+            ++report.failures;
+        }
+    });
+
+    report.seconds = seconds_since(start);
+    return report;
+}
@@ -0,0 +1,47 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <cstddef>
+#include <filesystem>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "util.h"
+
+// Matches a '/' separated path against a pattern where '*' and '?' stay within one path
+// component and "**/" stands for any number of directories, including none
+bool glob_match(std::string_view pattern, std::string_view path);
+
+// Turns command line inputs into STL paths, in the order given:
+//   a directory         every .stl file below it, sorted
+//   a pattern           files matching it (see glob_match), sorted, for shells that don't
+//                       expand them or lists too long for the command line
+//   @list               one input per line of the file, "@-" reads stdin, '#' starts a comment
+//   anything else       taken as is, so a missing file is reported when it's loaded
+std::vector<std::filesystem::path> expand_inputs(const std::vector<std::string>& inputs);
+
+struct BatchOptions {
+    std::vector<std::filesystem::path> inputs;
+    unsigned int jobs = 0;      // files loaded at once, 0 uses every core
+    MeshLoadOptions load;
+};
+
+struct BatchReport {
+    size_t files = 0;       // inputs processed
+    size_t flagged = 0;     // processed but reported a problem, e.g. not watertight
+    size_t failures = 0;    // inputs that failed to load or write
+    double seconds = 0.0;
+
+    double files_per_second() const { return seconds > 0.0 ? files / seconds : 0.0; }
+};
+
+// Loads and analyzes inputs on `jobs` threads, printing each report to `out` in input
+// order. Files that aren't watertight count as flagged.
+BatchReport analyze_files(const BatchOptions& options, std::ostream& out);
+
+// Rewrites every input as <output_directory>/<stem>.stl, binary or ASCII. Parsing runs
+// on `jobs` threads while the calling thread writes the files in input order.
+BatchReport convert_files(const BatchOptions& options, const std::filesystem::path& output_directory, bool ascii);
+
+#endif
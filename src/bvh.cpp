@@ -0,0 +1,295 @@
+#include "bvh.h"
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+constexpr int BIN_COUNT = 16;
+constexpr uint32_t MAX_LEAF_SIZE = 16;
+constexpr uint32_t PARALLEL_THRESHOLD = 1 << 14;   // smaller subtrees stay on the current thread
+
+struct Box {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    void grow(const glm::vec3& p) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    void grow(const Box& b) {
+        min = glm::min(min, b.min);
+        max = glm::max(max, b.max);
+    }
+
+    float area() const {
+        glm::vec3 e = max - min;
+        return e.x < 0.0f ? 0.0f : 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+};
+
+struct Builder {
+    std::vector<Box> boxes;             // per input triangle
+    std::vector<glm::vec3> centroids;
+    std::vector<uint32_t> order;        // triangle ids, partitioned in place
+    std::vector<BvhNode>& nodes;
+    std::atomic<uint32_t> node_count{1};
+    std::atomic<size_t> leaves{0};
+    std::atomic<unsigned int> max_depth{0};
+    TaskGroup tasks;
+
+    explicit Builder(std::vector<BvhNode>& nodes) : nodes(nodes) {}
+
+    void make_leaf(BvhNode& node, uint32_t begin, uint32_t end, unsigned int depth) {
+        node.first = begin;
+        node.count = end - begin;
+        ++leaves;
+        unsigned int seen = max_depth.load();
+        while (depth > seen && !max_depth.compare_exchange_weak(seen, depth)) {
+        }
+    }
+
+    void build(uint32_t node_index, uint32_t begin, uint32_t end, unsigned int depth) {
+        Box bounds, centroid_bounds;
+        for (uint32_t i = begin; i < end; ++i) {
+            bounds.grow(boxes[order[i]]);
+            centroid_bounds.grow(centroids[order[i]]);
+        }
+
+        BvhNode& node = nodes[node_index];
+        for (int a = 0; a < 3; ++a) {
+            node.bounds_min[a] = bounds.min[a];
+            node.bounds_max[a] = bounds.max[a];
+        }
+
+        const uint32_t count = end - begin;
+        if (count <= 2) {
+            make_leaf(node, begin, end, depth);
+            return;
+        }
+
+        // Binned SAH over every axis with a non-degenerate centroid spread
+        float best_cost = std::numeric_limits<float>::max();
+        int best_axis = -1;
+        int best_split = 0;
+        for (int axis = 0; axis < 3; ++axis) {
+            float lo = centroid_bounds.min[axis];
+            float extent = centroid_bounds.max[axis] - lo;
+            if (!(extent > 0.0f)) {
+                continue;
+            }
+            float scale = BIN_COUNT / extent;
+
+            Box bin_bounds[BIN_COUNT];
+            uint32_t bin_counts[BIN_COUNT] = {};
+            for (uint32_t i = begin; i < end; ++i) {
+                uint32_t t = order[i];
+                int b = std::min(BIN_COUNT - 1, static_cast<int>((centroids[t][axis] - lo) * scale));
+                bin_bounds[b].grow(boxes[t]);
+                ++bin_counts[b];
+            }
+
+            // Sweep from the right collecting suffix areas, then from the left
+            float right_area[BIN_COUNT];
+            uint32_t right_count[BIN_COUNT];
+            Box acc;
+            uint32_t n = 0;
+            for (int b = BIN_COUNT - 1; b > 0; --b) {
+                acc.grow(bin_bounds[b]);
+                n += bin_counts[b];
+                right_area[b] = acc.area();
+                right_count[b] = n;
+            }
+            acc = Box();
+            n = 0;
+            for (int b = 0; b < BIN_COUNT - 1; ++b) {
+                acc.grow(bin_bounds[b]);
+                n += bin_counts[b];
+                if (n == 0 || right_count[b + 1] == 0) {
+                    continue;
+                }
+                float cost = acc.area() * n + right_area[b + 1] * right_count[b + 1];
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_split = b + 1;
+                }
+            }
+        }
+
+        // Traversal is charged one triangle test, a leaf wins when splitting doesn't pay
+        float leaf_cost = static_cast<float>(count);
+        float split_cost = 1.0f + best_cost / std::max(bounds.area(), std::numeric_limits<float>::min());
+        uint32_t mid;
+        if (best_axis < 0 || (split_cost >= leaf_cost && count <= MAX_LEAF_SIZE)) {
+            if (count <= MAX_LEAF_SIZE) {
+                make_leaf(node, begin, end, depth);
+                return;
+            }
+            // All centroids coincide, any split is as good as another
+            mid = begin + count / 2;
+        } else {
+            float lo = centroid_bounds.min[best_axis];
+            float scale = BIN_COUNT / (centroid_bounds.max[best_axis] - lo);
+            auto split = std::partition(order.begin() + begin, order.begin() + end, [&](uint32_t t) {
+                return std::min(BIN_COUNT - 1, static_cast<int>((centroids[t][best_axis] - lo) * scale)) < best_split;
+            });
+            mid = static_cast<uint32_t>(split - order.begin());
+        }
+
+        uint32_t left = node_count.fetch_add(2);
+        node.first = left;
+        node.count = 0;
+
+        if (count >= PARALLEL_THRESHOLD) {
+            tasks.run([=, this] { build(left, begin, mid, depth + 1); });
+        } else {
+            build(left, begin, mid, depth + 1);
+        }
+        build(left + 1, mid, end, depth + 1);
+    }
+};
+
+}
+
+Bvh::Bvh(std::span<const Vertex> vertices, std::span<const unsigned int> indices, unsigned int threads) {
+    auto start = std::chrono::steady_clock::now();
+    const uint32_t count = static_cast<uint32_t>(indices.size() / 3);
+
+    if (count == 0) {
+        node_array.push_back({{0.0f, 0.0f, 0.0f}, 0, {0.0f, 0.0f, 0.0f}, 0});
+        build_stats.nodes = build_stats.leaves = 1;
+        return;
+    }
+
+    // A binary tree with at most one triangle per leaf has 2n - 1 nodes
+    node_array.resize(static_cast<size_t>(count) * 2);
+    Builder builder(node_array);
+    builder.boxes.resize(count);
+    builder.centroids.resize(count);
+    builder.order.resize(count);
+
+    parallel_for(count, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            Box box;
+            for (int c = 0; c < 3; ++c) {
+                box.grow(vertices[indices[t * 3 + c]].position);
+            }
+            builder.boxes[t] = box;
+            builder.centroids[t] = (box.min + box.max) * 0.5f;
+            builder.order[t] = static_cast<uint32_t>(t);
+        }
+    }, threads);
+
+    builder.build(0, 0, count, 1);
+    builder.tasks.wait();
+
+    node_array.resize(builder.node_count.load());
+    node_array.shrink_to_fit();
+
+    triangles.resize(count);
+    parallel_for(count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            uint32_t t = builder.order[i];
+            glm::vec3 v0 = vertices[indices[t * 3]].position;
+            triangles[i] = {v0, vertices[indices[t * 3 + 1]].position - v0, vertices[indices[t * 3 + 2]].position - v0, t};
+        }
+    }, threads);
+
+    build_stats.nodes = node_array.size();
+    build_stats.leaves = builder.leaves.load();
+    build_stats.max_depth = builder.max_depth.load();
+    build_stats.build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Slab test against a node, returns the entry distance or infinity on a miss
+static float intersect_node(const BvhNode& node, const float origin[3], const float inv_dir[3], float t_min, float t_max) {
+    for (int a = 0; a < 3; ++a) {
+        float t0 = (node.bounds_min[a] - origin[a]) * inv_dir[a];
+        float t1 = (node.bounds_max[a] - origin[a]) * inv_dir[a];
+        t_min = std::max(t_min, std::min(t0, t1));
+        t_max = std::min(t_max, std::max(t0, t1));
+    }
+    return t_min <= t_max ? t_min : std::numeric_limits<float>::infinity();
+}
+
+std::optional<RayHit> Bvh::intersect(glm::vec3 origin, glm::vec3 direction, float t_min, float t_max) const {
+    if (triangles.empty()) {
+        return std::nullopt;
+    }
+
+    const float o[3] = {origin.x, origin.y, origin.z};
+    const float inv_dir[3] = {1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z};
+
+    std::optional<RayHit> best;
+    float closest = t_max;
+
+    if (intersect_node(node_array[0], o, inv_dir, t_min, closest) == std::numeric_limits<float>::infinity()) {
+        return std::nullopt;
+    }
+
+    // Holds at most one pending sibling per level
+    uint32_t fixed[64];
+    std::vector<uint32_t> overflow;
+    uint32_t* stack = fixed;
+    if (build_stats.max_depth >= 64) {
+        overflow.resize(build_stats.max_depth + 1);
+        stack = overflow.data();
+    }
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const BvhNode& node = node_array[stack[--top]];
+
+        if (node.count > 0) {
+            // Möller-Trumbore against the leaf's contiguous triangles
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                const Triangle& tri = triangles[i];
+                glm::vec3 p = glm::cross(direction, tri.e2);
+                float det = glm::dot(tri.e1, p);
+                if (std::fabs(det) < 1e-12f) {
+                    continue;
+                }
+                float inv_det = 1.0f / det;
+                glm::vec3 s = origin - tri.v0;
+                float u = glm::dot(s, p) * inv_det;
+                if (u < 0.0f || u > 1.0f) {
+                    continue;
+                }
+                glm::vec3 q = glm::cross(s, tri.e1);
+                float v = glm::dot(direction, q) * inv_det;
+                if (v < 0.0f || u + v > 1.0f) {
+                    continue;
+                }
+                float t = glm::dot(tri.e2, q) * inv_det;
+                if (t >= t_min && t < closest) {
+                    closest = t;
+                    best = RayHit{tri.id, t, origin + direction * t};
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first by pushing it last
+        float d_left = intersect_node(node_array[node.first], o, inv_dir, t_min, closest);
+        float d_right = intersect_node(node_array[node.first + 1], o, inv_dir, t_min, closest);
+        bool left_first = d_left <= d_right;
+        float far_d = left_first ? d_right : d_left;
+        float near_d = left_first ? d_left : d_right;
+        uint32_t far_child = left_first ? node.first + 1 : node.first;
+        uint32_t near_child = left_first ? node.first : node.first + 1;
+        if (far_d != std::numeric_limits<float>::infinity()) {
+            stack[top++] = far_child;
+        }
+        if (near_d != std::numeric_limits<float>::infinity()) {
+            stack[top++] = near_child;
+        }
+    }
+
+    return best;
+}
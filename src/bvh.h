@@ -0,0 +1,59 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include "vertex.h"
+
+// 32 byte node, two per cache line. Interior nodes store the index of their left child
+// (the right child follows it), leaves store a range of the reordered triangles.
+struct BvhNode {
+    float bounds_min[3];
+    uint32_t first;     // left child for interior nodes, first triangle for leaves
+    float bounds_max[3];
+    uint32_t count;     // triangles in a leaf, 0 for interior nodes
+};
+
+struct BvhStats {
+    double build_ms = 0.0;
+    size_t nodes = 0;
+    size_t leaves = 0;
+    unsigned int max_depth = 0;
+};
+
+struct RayHit {
+    uint32_t triangle;  // index into the mesh's triangle list (indices / 3)
+    float t;            // distance along the ray direction
+    glm::vec3 point;
+};
+
+// Bounding volume hierarchy over an indexed triangle mesh, built top down with a 16 bin SAH
+// sweep per axis. Subtrees above a size threshold are built as parallel tasks. Triangles
+// are copied in leaf order as (v0, e1, e2) so a leaf test reads contiguous memory.
+class Bvh {
+    public:
+        Bvh(std::span<const Vertex> vertices, std::span<const unsigned int> indices, unsigned int threads = 0);
+
+        // Closest hit along origin + t * direction for t in [t_min, t_max]
+        std::optional<RayHit> intersect(glm::vec3 origin, glm::vec3 direction, float t_min = 0.0f,
+                                        float t_max = 3.402823466e+38f) const;
+
+        const BvhStats& stats() const { return build_stats; }
+
+        const std::vector<BvhNode>& nodes() const { return node_array; }
+
+    private:
+        struct Triangle {
+            glm::vec3 v0, e1, e2;
+            uint32_t id;
+        };
+
+        std::vector<BvhNode> node_array;
+        std::vector<Triangle> triangles;
+        BvhStats build_stats;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#include "camera.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+std::string_view preset_name(CameraPreset preset) {
+    switch (preset) {
+        case CameraPreset::Front: return "front";
+        case CameraPreset::Right: return "right";
+        case CameraPreset::Top: return "top";
+        case CameraPreset::Isometric: return "iso";
+    }
+    return "unknown";
+}
+
+Camera frame_bounds(const Bounds& bounds, CameraPreset preset, float aspect, float fov_degrees) {
+    glm::vec3 direction;    // from the target towards the camera
+    glm::vec3 up(0.0f, 0.0f, 1.0f);
+    switch (preset) {
+        case CameraPreset::Front: direction = glm::vec3(0.0f, -1.0f, 0.0f); break;
+        case CameraPreset::Right: direction = glm::vec3(1.0f, 0.0f, 0.0f); break;
+        case CameraPreset::Top: direction = glm::vec3(0.0f, 0.0f, 1.0f); up = glm::vec3(0.0f, 1.0f, 0.0f); break;
+        case CameraPreset::Isometric: direction = glm::normalize(glm::vec3(1.0f, -1.0f, 1.0f)); break;
+    }
+
+    glm::vec3 center = bounds.center();
+    float radius = std::max(glm::length(bounds.extent()) * 0.5f, 1e-4f);
+
+    // The narrower of the two fields of view decides how far back the sphere fits
+    float half_fov = glm::radians(fov_degrees) * 0.5f;
+    float half_fov_x = std::atan(std::tan(half_fov) * aspect);
+    float distance = radius / std::sin(std::min(half_fov, half_fov_x));
+
+    Camera camera;
+    camera.position = center + direction * distance;
+    camera.view = glm::lookAt(camera.position, center, up);
+    camera.projection = glm::perspective(glm::radians(fov_degrees), aspect,
+                                         std::max(distance - radius * 1.01f, distance * 1e-3f),
+                                         distance + radius * 1.01f);
+    return camera;
+}
@@ -0,0 +1,29 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include <string_view>
+#include <glm/glm.hpp>
+#include "vertex.h"
+
+enum class CameraPreset {
+    Front,
+    Right,
+    Top,
+    Isometric,
+};
+
+std::string_view preset_name(CameraPreset preset);
+
+// View and projection used for one frame. Every backend derives its transforms from
+// this, so GL and software renders of the same camera line up pixel for pixel.
+struct Camera {
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::vec3 position = glm::vec3(0.0f);
+};
+
+// Places the camera on the preset direction (Z up, as CAD exports usually are) far enough
+// back that the bounding sphere of `bounds` fits the frustum
+Camera frame_bounds(const Bounds& bounds, CameraPreset preset, float aspect, float fov_degrees = 45.0f);
+
+#endif
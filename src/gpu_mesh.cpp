@@ -0,0 +1,115 @@
+#include "gpu_mesh.h"
+#include <cstdint>
+#include <cstring>
+
+GpuMeshData build_gpu_mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                           VertexLayout layout, bool split, const std::vector<MeshLod>& lods) {
+    GpuMeshData data;
+    data.layout = layout;
+    data.bounds = compute_bounds(vertices);
+
+    // The full mesh and then every LOD, each starting a new submesh
+    std::vector<const std::vector<unsigned int>*> levels = {&indices};
+    size_t total_indices = indices.size();
+    for (const MeshLod& lod : lods) {
+        levels.push_back(&lod.indices);
+        total_indices += lod.indices.size();
+    }
+    auto begin_level = [&](size_t level) {
+        data.lods.push_back({static_cast<unsigned int>(data.submeshes.size()), 0,
+                             level == 0 ? 0.0f : lods[level - 1].error});
+    };
+    auto end_level = [&] {
+        data.lods.back().submesh_count = static_cast<unsigned int>(data.submeshes.size()) - data.lods.back().first_submesh;
+    };
+
+    if (vertices.size() > MAX_SUBMESH_VERTICES && !split) {
+        data.index_size = sizeof(uint32_t);
+        data.vertex_count = vertices.size();
+        data.vertex_data = pack_vertices(vertices, layout, data.bounds);
+        data.index_data.resize(total_indices * sizeof(uint32_t));
+        size_t offset = 0;
+        for (size_t level = 0; level < levels.size(); ++level) {
+            const std::vector<unsigned int>& level_indices = *levels[level];
+            begin_level(level);
+            std::memcpy(data.index_data.data() + offset, level_indices.data(), level_indices.size() * sizeof(uint32_t));
+            data.submeshes.push_back({offset, static_cast<unsigned int>(level_indices.size()), 0});
+            offset += level_indices.size() * sizeof(uint32_t);
+            end_level();
+        }
+        return data;
+    }
+
+    data.index_size = sizeof(uint16_t);
+
+    std::vector<uint16_t> local_indices;
+    local_indices.reserve(total_indices);
+
+    if (vertices.size() <= MAX_SUBMESH_VERTICES) {
+        for (size_t level = 0; level < levels.size(); ++level) {
+            begin_level(level);
+            size_t start = local_indices.size();
+            for (unsigned int i : *levels[level]) {
+                local_indices.push_back(static_cast<uint16_t>(i));
+            }
+            data.submeshes.push_back({start * sizeof(uint16_t), static_cast<unsigned int>(local_indices.size() - start), 0});
+            end_level();
+        }
+        data.vertex_count = vertices.size();
+        data.vertex_data = pack_vertices(vertices, layout, data.bounds);
+    } else {
+        // Greedy split in triangle order, a chunk closes when the next triangle could
+        // push it past the 16 bit range
+        std::vector<Vertex> chunked;
+        chunked.reserve(vertices.size() + vertices.size() / 8);
+
+        constexpr unsigned int UNSEEN = ~0u;
+        std::vector<unsigned int> local(vertices.size(), UNSEEN);
+        std::vector<unsigned int> touched;
+        size_t chunk_start_index = 0;
+        size_t chunk_base = 0;
+
+        auto close_chunk = [&] {
+            size_t count = local_indices.size() - chunk_start_index;
+            if (count > 0) {
+                data.submeshes.push_back({chunk_start_index * sizeof(uint16_t), static_cast<unsigned int>(count),
+                                          static_cast<int>(chunk_base)});
+            }
+            for (unsigned int v : touched) {
+                local[v] = UNSEEN;
+            }
+            touched.clear();
+            chunk_start_index = local_indices.size();
+            chunk_base = chunked.size();
+        };
+
+        // LODs get chunks of their own and so their own copies of the vertices they use
+        for (size_t level = 0; level < levels.size(); ++level) {
+            const std::vector<unsigned int>& level_indices = *levels[level];
+            begin_level(level);
+            for (size_t t = 0; t + 2 < level_indices.size(); t += 3) {
+                if (chunked.size() - chunk_base + 3 > MAX_SUBMESH_VERTICES) {
+                    close_chunk();
+                }
+                for (int c = 0; c < 3; ++c) {
+                    unsigned int v = level_indices[t + c];
+                    if (local[v] == UNSEEN) {
+                        local[v] = static_cast<unsigned int>(chunked.size() - chunk_base);
+                        touched.push_back(v);
+                        chunked.push_back(vertices[v]);
+                    }
+                    local_indices.push_back(static_cast<uint16_t>(local[v]));
+                }
+            }
+            close_chunk();
+            end_level();
+        }
+
+        data.vertex_count = chunked.size();
+        data.vertex_data = pack_vertices(chunked, layout, data.bounds);
+    }
+
+    data.index_data.resize(local_indices.size() * sizeof(uint16_t));
+    std::memcpy(data.index_data.data(), local_indices.data(), data.index_data.size());
+    return data;
+}
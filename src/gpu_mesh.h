@@ -0,0 +1,63 @@
+#ifndef GPU_MESH_H
+#define GPU_MESH_H
+
+#include <cstddef>
+#include <span>
+#include <vector>
+#include "simplify.h"
+#include "vertex.h"
+
+// Largest vertex count addressable by one 16 bit index range
+constexpr size_t MAX_SUBMESH_VERTICES = 65535;
+
+// One glDrawElementsBaseVertex worth of triangles
+struct Submesh {
+    size_t index_offset;        // bytes into the index buffer
+    unsigned int index_count;
+    int base_vertex;            // added to every index of the range
+};
+
+// A level of detail, drawn as a run of consecutive submeshes. Level 0 is the full mesh.
+struct LodRange {
+    unsigned int first_submesh;
+    unsigned int submesh_count;
+    float error;                // see MeshLod::error
+};
+
+// Non-owning view of upload ready buffers, e.g. straight out of a mapped cache file
+struct GpuMeshView {
+    VertexLayout layout;
+    Bounds bounds;
+    unsigned int index_size;
+    size_t vertex_count;
+    std::span<const unsigned char> vertex_data;
+    std::span<const unsigned char> index_data;
+    std::span<const Submesh> submeshes;
+    std::span<const LodRange> lods;     // empty means a single level over every submesh
+};
+
+// Vertex and index buffer contents ready for upload
+struct GpuMeshData {
+    VertexLayout layout = VertexLayout::PositionNormal;
+    Bounds bounds;
+    unsigned int index_size = 2;    // bytes per index, 2 or 4
+    size_t vertex_count = 0;
+    std::vector<unsigned char> vertex_data;
+    std::vector<unsigned char> index_data;
+    std::vector<Submesh> submeshes;
+    std::vector<LodRange> lods;
+
+    GpuMeshView view() const {
+        return {layout, bounds, index_size, vertex_count, vertex_data, index_data, submeshes, lods};
+    }
+};
+
+// Packs the vertices and converts indices to 16 bit. Meshes with more than
+// MAX_SUBMESH_VERTICES vertices are split into submeshes that each reference at most
+// that many vertices; vertices shared across a split are duplicated into both chunks.
+// Without `split`, large meshes keep a single range of 32 bit indices instead.
+// Each of `lods` follows the full mesh in the index buffer as its own submeshes.
+GpuMeshData build_gpu_mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                           VertexLayout layout, bool split = true, const std::vector<MeshLod>& lods = {});
+
+#endif
@@ -0,0 +1,47 @@
+#include "hash.h"
+#include "parallel.h"
+#include <cstring>
+#include <vector>
+
+static uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t h = seed ^ (size * 0x9E3779B97F4A7C15ull);
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, p + i, sizeof(word));
+        h = (h ^ mix(word)) * 0x9E3779B97F4A7C15ull;
+    }
+
+    uint64_t tail = 0;
+    std::memcpy(&tail, p + i, size - i);
+    h = (h ^ mix(tail)) * 0x9E3779B97F4A7C15ull;
+
+    return mix(h);
+}
+
+uint64_t hash_content(const void* data, size_t size) {
+    constexpr size_t BLOCK = 1 << 20;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    size_t blocks = (size + BLOCK - 1) / BLOCK;
+
+    std::vector<uint64_t> block_hashes(blocks);
+    parallel_for(blocks, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            size_t offset = b * BLOCK;
+            block_hashes[b] = hash_bytes(p + offset, std::min(BLOCK, size - offset), b);
+        }
+    }, 0, 1);
+
+    return hash_bytes(block_hashes.data(), block_hashes.size() * sizeof(uint64_t), size);
+}
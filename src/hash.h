@@ -0,0 +1,14 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 64 bit non-cryptographic hash for content keys, consumes 8 bytes per step
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 0);
+
+// Same idea over large buffers, hashing 1 MiB blocks in parallel and then the block
+// hashes, so the result differs from hash_bytes but is stable for any thread count
+uint64_t hash_content(const void* data, size_t size);
+
+#endif
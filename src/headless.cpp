@@ -0,0 +1,309 @@
+#include "headless.h"
+#include "image.h"
+#include "parallel.h"
+#include "pipeline.h"
+#include "program_cache.h"
+#include "soft_raster.h"
+#include <GLFW/glfw3.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+HeadlessContext::HeadlessContext() {
+    if (!glfwInit()) {
+        throw std::runtime_error("Failed to initialize GLFW");
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    window = glfwCreateWindow(1, 1, "STL Viewer (headless)", nullptr, nullptr);
+    if (!window) {
+        glfwTerminate();
+        throw std::runtime_error("Failed to create an offscreen GL context");
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        throw std::runtime_error("Failed to initialize GLAD");
+    }
+}
+
+HeadlessContext::~HeadlessContext() {
+    glfwDestroyWindow(window);
+    glfwTerminate();
+}
+
+namespace {
+
+// PNG encoding on the thread pool, an image only counts once its file is written
+struct ImageWriter {
+    TaskGroup tasks;
+    std::atomic<size_t> written{0};
+    std::atomic<size_t> failed{0};
+
+    void write(std::filesystem::path path, std::vector<unsigned char> pixels, int width, int height) {
+        tasks.run([this, path = std::move(path), pixels = std::move(pixels), width, height] {
+            try {
+                write_png(path, width, height, pixels.data(), true);
+                ++written;
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << "\n";
+                ++failed;
+            }
+        });
+    }
+};
+
+struct Framebuffer {
+    unsigned int fbo = 0, color = 0, depth = 0;
+
+    Framebuffer(int width, int height) {
+        glGenFramebuffers(1, &fbo);
+        glGenRenderbuffers(1, &color);
+        glGenRenderbuffers(1, &depth);
+
+        glBindRenderbuffer(GL_RENDERBUFFER, color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            throw std::runtime_error("Offscreen framebuffer is incomplete");
+        }
+    }
+
+    ~Framebuffer() {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &color);
+        glDeleteRenderbuffers(1, &depth);
+    }
+};
+
+// Pixel pack buffers in flight. A slot is only mapped once its fence has signalled or
+// the ring wraps around to it, by which point the copy has long finished.
+class ReadbackRing {
+    public:
+        ReadbackRing(int width, int height, ImageWriter& writer) : width(width), height(height), writer(writer) {
+            for (Slot& slot : slots) {
+                glGenBuffers(1, &slot.pbo);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+                glBufferData(GL_PIXEL_PACK_BUFFER, bytes(), nullptr, GL_STREAM_READ);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+
+        ~ReadbackRing() {
+            for (Slot& slot : slots) {
+                if (slot.fence) {
+                    glDeleteSync(slot.fence);
+                }
+                glDeleteBuffers(1, &slot.pbo);
+            }
+        }
+
+        // Starts an asynchronous read of the bound framebuffer destined for `path`
+        void read(std::filesystem::path path) {
+            Slot& slot = slots[next];
+            next = (next + 1) % slots.size();
+            if (slot.fence) {
+                finish(slot);
+            }
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            slot.path = std::move(path);
+        }
+
+        void drain() {
+            for (size_t i = 0; i < slots.size(); ++i) {
+                Slot& slot = slots[(next + i) % slots.size()];
+                if (slot.fence) {
+                    finish(slot);
+                }
+            }
+        }
+
+    private:
+        struct Slot {
+            unsigned int pbo = 0;
+            GLsync fence = nullptr;
+            std::filesystem::path path;
+        };
+
+        std::array<Slot, 3> slots;
+        size_t next = 0;
+        int width, height;
+        ImageWriter& writer;
+
+        size_t bytes() const { return static_cast<size_t>(width) * height * 4; }
+
+        void finish(Slot& slot) {
+            glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+
+            std::vector<unsigned char> pixels(bytes());
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+            if (const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes(), GL_MAP_READ_BIT)) {
+                std::memcpy(pixels.data(), mapped, bytes());
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+            writer.write(std::move(slot.path), std::move(pixels), width, height);
+        }
+};
+
+}
+
+static std::filesystem::path thumbnail_path(const ThumbnailOptions& options, const std::filesystem::path& input,
+                                            CameraPreset preset) {
+    std::string name = input.stem().string() + "_" + std::string(preset_name(preset)) + ".png";
+    return options.output_directory / name;
+}
+
+// Same scene setup as the GL path: identity model, framed camera, clear and mesh colors
+static void render_software(const ThumbnailOptions& options, ThumbnailReport& report, ImageWriter& writer) {
+    SoftwareRasterizer raster(options.width, options.height);
+    const float aspect = static_cast<float>(options.width) / static_cast<float>(options.height);
+
+    struct Loaded {
+        MeshData mesh;
+        std::string error;
+    };
+    const unsigned int jobs = resolve_thread_count(options.jobs);
+    run_pipeline<Loaded>(options.inputs.size(), size_t(jobs) * 2, jobs, [&](size_t i) {
+        Loaded loaded;
+        try {
+            loaded.mesh = load_mesh_data(options.inputs[i], options.load);
+        } catch (const std::exception& e) {
+            loaded.error = e.what();
+        }
+        return loaded;
+    }, [&](size_t i, Loaded loaded) {
+        const auto& input = options.inputs[i];
+        if (!loaded.error.empty()) {
+            std::cerr << "Error: " << input << ": " << loaded.error << "\n";
+            ++report.failures;
+            return;
+        }
+        const MeshData& mesh = loaded.mesh;
+        Bounds bounds = compute_bounds(mesh.vertices);
+        for (CameraPreset preset : options.presets) {
+            Camera camera = frame_bounds(bounds, preset, aspect);
+            raster.clear(glm::vec4(0.2f, 0.3f, 0.3f, 1.0f));
+            raster.draw(mesh.vertices, mesh.indices, glm::mat4(1.0f), camera, glm::vec3(0.3f, 0.5f, 0.4f));
+
+            writer.write(thumbnail_path(options, input, preset), raster.pixels(), options.width, options.height);
+        }
+        ++report.parts;
+    });
+}
+
+static void render_gl(const ThumbnailOptions& options, ThumbnailReport& report, ImageWriter& writer) {
+
+    HeadlessContext context;
+    Framebuffer framebuffer(options.width, options.height);
+    ProgramCache programs;
+    Shader shader = Shader::embedded("shader.vert", "lit.frag", &programs);
+    const GLint color_location = shader.location("color");
+    CameraUniforms camera_uniforms;
+
+    MeshLoadOptions load = options.load;
+    load.keep_cpu_data = false;
+
+    ReadbackRing ring(options.width, options.height, writer);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo);
+    glViewport(0, 0, options.width, options.height);
+    glEnable(GL_DEPTH_TEST);
+    shader.use();
+
+    const float aspect = static_cast<float>(options.width) / static_cast<float>(options.height);
+
+    // Parsing, welding and packing happen on the loader threads, this one only uploads and draws
+    struct Loaded {
+        PreparedMesh mesh;
+        std::string error;
+    };
+    const unsigned int jobs = resolve_thread_count(options.jobs);
+    run_pipeline<Loaded>(options.inputs.size(), size_t(jobs) * 2, jobs, [&](size_t i) {
+        Loaded loaded;
+        try {
+            loaded.mesh = prepare_mesh(options.inputs[i], load);
+        } catch (const std::exception& e) {
+            loaded.error = e.what();
+        }
+        return loaded;
+    }, [&](size_t i, Loaded loaded) {
+        const auto& input = options.inputs[i];
+        try {
+            if (!loaded.error.empty()) {
+                throw std::runtime_error(loaded.error);
+            }
+            Mesh mesh(std::move(loaded.mesh), load);
+            for (CameraPreset preset : options.presets) {
+                Camera camera = frame_bounds(mesh.bounds, preset, aspect);
+
+                glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                set_model_matrix(glm::mat4(1.0f));
+                camera_uniforms.update(camera.view, camera.projection);
+                shader.set_vec3(color_location, 0.3f, 0.5f, 0.4f);
+                mesh.draw();
+
+                ring.read(thumbnail_path(options, input, preset));
+            }
+            ++report.parts;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << input << ": " << e.what() << "\n";
+            ++report.failures;
+        }
+    });
+
+    ring.drain();
+}
+
+ThumbnailReport render_thumbnails(const ThumbnailOptions& options) {
+    ThumbnailReport report;
+    auto start = std::chrono::steady_clock::now();
+
+    // Inputs from different directories with the same stem would overwrite each other
+    std::set<std::filesystem::path> seen;
+    for (const auto& input : options.inputs) {
+        for (CameraPreset preset : options.presets) {
+            std::filesystem::path path = thumbnail_path(options, input, preset);
+            if (!seen.insert(path).second) {
+                throw std::runtime_error("More than one input renders to " + path.string());
+            }
+        }
+    }
+    std::filesystem::create_directories(options.output_directory);
+
+    ImageWriter writer;
+    if (options.backend == RenderBackend::Software) {
+        render_software(options, report, writer);
+    } else {
+        render_gl(options, report, writer);
+    }
+
+    writer.tasks.wait();
+    report.images = writer.written;
+    report.failures += writer.failed;
+
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return report;
+}
@@ -0,0 +1,57 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <filesystem>
+#include <vector>
+#include "camera.h"
+#include "util.h"
+
+enum class RenderBackend {
+    OpenGL,     // offscreen FBO on a hidden GL context
+    Software,   // SoftwareRasterizer, no GL or GPU needed
+};
+
+struct GLFWwindow;
+
+// Hidden window whose only job is to own a current GL context
+struct HeadlessContext {
+    GLFWwindow* window = nullptr;
+
+    HeadlessContext();
+
+    ~HeadlessContext();
+
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+};
+
+struct ThumbnailOptions {
+    std::vector<std::filesystem::path> inputs;
+    std::filesystem::path output_directory = "thumbnails";
+    int width = 256;
+    int height = 256;
+    std::vector<CameraPreset> presets = {CameraPreset::Isometric};
+    MeshLoadOptions load;
+    RenderBackend backend = RenderBackend::OpenGL;
+    unsigned int jobs = 0;      // inputs loading while others render, 0 uses every core
+};
+
+struct ThumbnailReport {
+    size_t parts = 0;       // inputs rendered
+    size_t images = 0;      // PNGs written
+    size_t failures = 0;    // inputs that failed to load or render, and PNGs that failed to write
+    double seconds = 0.0;
+
+    double parts_per_second() const { return seconds > 0.0 ? parts / seconds : 0.0; }
+};
+
+// Renders every input from each preset and writes <stem>_<preset>.png files, throwing up
+// front when two inputs share a stem and would overwrite each other's images. Inputs are
+// loaded on `jobs` threads through run_pipeline while the calling thread renders them in
+// order. The GL backend draws into an offscreen framebuffer on a hidden GLFW context and
+// reads pixels back through a ring of pixel pack buffers so readback overlaps rendering.
+// The software backend rasterizes on the CPU with the same cameras. PNG encoding runs on
+// the thread pool.
+ThumbnailReport render_thumbnails(const ThumbnailOptions& options);
+
+#endif
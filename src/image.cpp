@@ -0,0 +1,97 @@
+#include "image.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Minimal encoder: filter type 0 and uncompressed deflate blocks, so no zlib dependency.
+// Thumbnails are small, size is not the point.
+
+static uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[n] = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void put_u32(std::vector<unsigned char>& out, uint32_t v) {
+    out.push_back(static_cast<unsigned char>(v >> 24));
+    out.push_back(static_cast<unsigned char>(v >> 16));
+    out.push_back(static_cast<unsigned char>(v >> 8));
+    out.push_back(static_cast<unsigned char>(v));
+}
+
+static void put_chunk(std::vector<unsigned char>& out, const char type[4], const std::vector<unsigned char>& data) {
+    put_u32(out, static_cast<uint32_t>(data.size()));
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    put_u32(out, crc32(out.data() + start, out.size() - start));
+}
+
+void write_png(const std::filesystem::path& path, int width, int height, const unsigned char* rgba, bool flip_y) {
+    const size_t row_bytes = static_cast<size_t>(width) * 4;
+
+    // Scanlines with their leading filter byte
+    std::vector<unsigned char> raw;
+    raw.reserve((row_bytes + 1) * height);
+    for (int y = 0; y < height; ++y) {
+        int src = flip_y ? height - 1 - y : y;
+        raw.push_back(0);
+        raw.insert(raw.end(), rgba + src * row_bytes, rgba + (src + 1) * row_bytes);
+    }
+
+    // zlib stream of stored blocks, each at most 65535 bytes
+    std::vector<unsigned char> zlib = {0x78, 0x01};
+    for (size_t offset = 0; offset < raw.size() || offset == 0; offset += 65535) {
+        size_t len = std::min<size_t>(65535, raw.size() - offset);
+        bool last = offset + len >= raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(static_cast<unsigned char>(len));
+        zlib.push_back(static_cast<unsigned char>(len >> 8));
+        zlib.push_back(static_cast<unsigned char>(~len));
+        zlib.push_back(static_cast<unsigned char>(~len >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + len);
+        if (last) {
+            break;
+        }
+    }
+    uint32_t a = 1, b = 0;
+    for (unsigned char c : raw) {
+        a = (a + c) % 65521;
+        b = (b + a) % 65521;
+    }
+    put_u32(zlib, (b << 16) | a);
+
+    std::vector<unsigned char> header;
+    put_u32(header, static_cast<uint32_t>(width));
+    put_u32(header, static_cast<uint32_t>(height));
+    header.insert(header.end(), {8, 6, 0, 0, 0});   // 8 bit RGBA, no interlace
+
+    std::vector<unsigned char> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    put_chunk(png, "IHDR", header);
+    put_chunk(png, "IDAT", zlib);
+    put_chunk(png, "IEND", {});
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(png.data()), static_cast<std::streamsize>(png.size()));
+    if (!file) {
+        throw std::runtime_error("Failed to write " + path.string());
+    }
+}
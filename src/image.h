@@ -0,0 +1,10 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <filesystem>
+
+// Writes 8 bit RGBA pixels as a PNG. Rows are taken bottom-up when `flip_y` is set,
+// which is the order glReadPixels produces. Throws on I/O failure.
+void write_png(const std::filesystem::path& path, int width, int height, const unsigned char* rgba, bool flip_y);
+
+#endif
@@ -1,7 +1,211 @@
 #include "renderer.h"
+#include "batch.h"
+#include "headless.h"
+#include "mesh_cache.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
 
-int main(void) {
-    Renderer renderer;
+static int usage(const char* program) {
+    std::cerr << "Usage:\n"
+              << "  " << program << " [view] [--no-vsync] [--max-fps N] [--continuous] [--unlit] [--file-normals]\n"
+              << "      [--analyze] [--profile] [--trace out.json] [--stream] [--no-cache] [--cache-dir DIR] <input>...\n"
+              << "  " << program << " thumbnail [--software] [--file-normals] [--size WxH] [--jobs N] [-o DIR] <input>...\n"
+              << "  " << program << " analyze [--jobs N] <input>...\n"
+              << "  " << program << " convert [--ascii] [--jobs N] -o DIR <input>...\n"
+              << "  " << program << " cache-list [--cache-dir DIR]\n"
+              << "An input is an STL file, a directory searched for .stl files, a pattern such as\n"
+              << "'parts/**/*.stl', or @list naming a file with one input per line (@- reads stdin).\n";
+    return 2;
+}
 
+// Options shared by the batch commands, returns false on anything it doesn't know
+static bool parse_batch_arg(std::string_view arg, int& i, int argc, char** argv, unsigned int& jobs,
+                            std::vector<std::string>& inputs) {
+    if (arg == "--jobs" && i + 1 < argc) {
+        jobs = static_cast<unsigned int>(std::atoi(argv[++i]));
+    } else if (arg.starts_with("-") && arg != "-" && !arg.starts_with("@")) {
+        return false;
+    } else {
+        inputs.emplace_back(arg);
+    }
+    return true;
+}
+
+static int run_view(int first, int argc, char** argv) {
+    RendererOptions options;
+    std::vector<std::string> inputs;
+    for (int i = first; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--no-vsync") {
+            options.vsync = false;
+        } else if (arg == "--continuous") {
+            options.continuous = true;
+        } else if (arg == "--unlit") {
+            options.lighting = false;
+        } else if (arg == "--file-normals") {
+            options.normals = NormalMode::File;
+        } else if (arg == "--analyze") {
+            options.analyze = true;
+        } else if (arg == "--profile") {
+            options.profile_overlay = true;
+        } else if (arg == "--stream") {
+            options.streaming = true;
+        } else if (arg == "--no-cache") {
+            options.use_cache = false;
+        } else if (arg == "--cache-dir" && i + 1 < argc) {
+            options.cache_directory = argv[++i];
+        } else if (arg == "--trace" && i + 1 < argc) {
+            options.trace_path = argv[++i];
+        } else if (arg == "--max-fps" && i + 1 < argc) {
+            options.max_fps = std::atof(argv[++i]);
+        } else if (arg.starts_with("--")) {
+            return usage(argv[0]);
+        } else {
+            inputs.emplace_back(arg);
+        }
+    }
+    options.stl_paths = expand_inputs(inputs);
+    if (options.stl_paths.empty()) {
+        return usage(argv[0]);
+    }
+    Renderer renderer(options);
     return 0;
-}
\ No newline at end of file
+}
+
+static int run_thumbnail(int first, int argc, char** argv) {
+    ThumbnailOptions options;
+    std::vector<std::string> inputs;
+    for (int i = first; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--software") {
+            options.backend = RenderBackend::Software;
+        } else if (arg == "--file-normals") {
+            options.load.normals = NormalMode::File;
+        } else if (arg == "-o" && i + 1 < argc) {
+            options.output_directory = argv[++i];
+        } else if (arg == "--size" && i + 1 < argc) {
+            if (std::sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2 || options.width <= 0
+                || options.height <= 0) {
+                return usage(argv[0]);
+            }
+        } else if (!parse_batch_arg(arg, i, argc, argv, options.jobs, inputs)) {
+            return usage(argv[0]);
+        }
+    }
+    options.inputs = expand_inputs(inputs);
+    if (options.inputs.empty()) {
+        return usage(argv[0]);
+    }
+
+    ThumbnailReport report = render_thumbnails(options);
+    std::cout << "Rendered " << report.parts << " parts (" << report.images << " images, "
+              << report.failures << " failures) in " << report.seconds << " s, "
+              << report.parts_per_second() << " parts/s\n";
+    return report.failures == 0 ? 0 : 1;
+}
+
+// Exits with 1 when a file fails to load or is not watertight
+static int run_analyze(int first, int argc, char** argv) {
+    BatchOptions options;
+    std::vector<std::string> inputs;
+    for (int i = first; i < argc; ++i) {
+        if (!parse_batch_arg(argv[i], i, argc, argv, options.jobs, inputs)) {
+            return usage(argv[0]);
+        }
+    }
+    options.inputs = expand_inputs(inputs);
+    if (options.inputs.empty()) {
+        return usage(argv[0]);
+    }
+
+    BatchReport report = analyze_files(options, std::cout);
+    std::cout << "Analyzed " << report.files << " files (" << report.flagged << " not watertight, "
+              << report.failures << " failures) in " << report.seconds << " s, "
+              << report.files_per_second() << " files/s\n";
+    return report.failures == 0 && report.flagged == 0 ? 0 : 1;
+}
+
+static int run_convert(int first, int argc, char** argv) {
+    BatchOptions options;
+    std::vector<std::string> inputs;
+    std::filesystem::path output_directory;
+    bool ascii = false;
+    for (int i = first; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--ascii") {
+            ascii = true;
+        } else if (arg == "-o" && i + 1 < argc) {
+            output_directory = argv[++i];
+        } else if (!parse_batch_arg(arg, i, argc, argv, options.jobs, inputs)) {
+            return usage(argv[0]);
+        }
+    }
+    options.inputs = expand_inputs(inputs);
+    if (options.inputs.empty() || output_directory.empty()) {
+        return usage(argv[0]);
+    }
+
+    BatchReport report = convert_files(options, output_directory, ascii);
+    std::cout << "Converted " << report.files << " files (" << report.failures << " failures) in "
+              << report.seconds << " s, " << report.files_per_second() << " files/s\n";
+    return report.failures == 0 ? 0 : 1;
+}
+
+static int run_cache_list(int first, int argc, char** argv) {
+    std::filesystem::path directory = default_cache_directory();
+    for (int i = first; i < argc; ++i) {
+        if (std::string_view(argv[i]) == "--cache-dir" && i + 1 < argc) {
+            directory = argv[++i];
+        } else {
+            return usage(argv[0]);
+        }
+    }
+
+    MeshCache cache(directory);
+    std::vector<MeshCacheInfo> entries = cache.list();
+    uint64_t total = 0;
+    for (const MeshCacheInfo& entry : entries) {
+        // Through the current time, clock_cast for file_clock isn't in every standard library yet
+        auto used = std::chrono::system_clock::now()
+                    + std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                        entry.last_used - std::filesystem::file_time_type::clock::now());
+        std::time_t stamp = std::chrono::system_clock::to_time_t(used);
+        std::cout << std::put_time(std::localtime(&stamp), "%Y-%m-%d %H:%M") << "  " << std::setw(10)
+                  << entry.bytes / 1024 << " KiB  " << std::setw(10) << entry.stats.loaded_triangles
+                  << " tris  " << (entry.stale ? "stale  " : "       ") << entry.source.string() << "\n";
+        total += entry.bytes;
+    }
+    std::cout << entries.size() << " entries, " << total / (1024 * 1024) << " MiB in " << directory.string() << "\n";
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::string_view command = argc > 1 ? argv[1] : "";
+    try {
+        if (command == "thumbnail") {
+            return run_thumbnail(2, argc, argv);
+        } else if (command == "analyze") {
+            return run_analyze(2, argc, argv);
+        } else if (command == "convert") {
+            return run_convert(2, argc, argv);
+        } else if (command == "cache-list") {
+            return run_cache_list(2, argc, argv);
+        } else if (command == "view") {
+            return run_view(2, argc, argv);
+        } else if (command == "help" || command == "--help" || command == "-h") {
+            usage(argv[0]);
+            return 0;
+        }
+        // No command: the files open in the viewer
+        return run_view(1, argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,40 @@
+#include "mapped_file.h"
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::filesystem::path& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open " + path.string());
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("Could not stat " + path.string());
+    }
+    length = static_cast<size_t>(st.st_size);
+
+    // mmap rejects zero-length mappings, an empty file simply has no bytes
+    if (length > 0) {
+        void* ptr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Could not map " + path.string());
+        }
+        madvise(ptr, length, MADV_SEQUENTIAL);
+        bytes = static_cast<const unsigned char*>(ptr);
+    }
+
+    // The mapping keeps its own reference to the file
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (bytes) {
+        munmap(const_cast<unsigned char*>(bytes), length);
+    }
+}
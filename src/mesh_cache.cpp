@@ -0,0 +1,425 @@
+#include "mesh_cache.h"
+#include "hash.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+constexpr char CACHE_MAGIC[8] = {'S', 'T', 'L', 'M', 'C', 'A', 'C', 'H'};
+constexpr uint32_t CACHE_VERSION = 5;
+constexpr uint64_t CACHE_ALIGNMENT = 4096;
+// Temporary files older than this belong to a writer that died, younger ones may be in progress
+constexpr auto TEMP_FILE_MAX_AGE = std::chrono::hours(1);
+
+struct CacheSection {
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t layout;
+    uint64_t options_hash;
+
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t source_hash;
+
+    float bounds_min[3];
+    float bounds_max[3];
+    uint32_t index_size;
+    uint32_t padding;
+    uint64_t vertex_count;
+
+    CacheSection gpu_vertices;
+    CacheSection gpu_indices;
+    CacheSection submeshes;
+    CacheSection cpu_vertices;
+    CacheSection cpu_indices;
+    CacheSection lods;
+    CacheSection source_path;   // absolute path of the STL, for listing
+
+    MeshStats stats;
+};
+
+static_assert(sizeof(CacheHeader) <= CACHE_ALIGNMENT, "Cache header must fit in the first page");
+
+std::filesystem::path default_cache_directory() {
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+        return std::filesystem::path(xdg) / "stl_viewer";
+    }
+    if (const char* home = std::getenv("HOME"); home && *home) {
+        return std::filesystem::path(home) / ".cache" / "stl_viewer";
+    }
+    return std::filesystem::temp_directory_path() / "stl_viewer";
+}
+
+std::filesystem::path unique_temp_path(const std::filesystem::path& path) {
+    std::ostringstream suffix;
+    suffix << "." << getpid() << "." << std::hex << std::hash<std::thread::id>{}(std::this_thread::get_id()) << ".tmp";
+    std::filesystem::path temp = path;
+    temp += suffix.str();
+    return temp;
+}
+
+static uint64_t options_hash(const MeshLoadOptions& options) {
+    // Everything that changes the processed buffers, thread count does not
+    struct {
+        uint32_t version;
+        uint32_t layout;
+        float weld_epsilon;
+        float crease_angle;
+        uint8_t weld, split_16bit, optimize, normals;
+    } key{CACHE_VERSION, static_cast<uint32_t>(options.layout), options.weld_epsilon, options.crease_angle,
+          options.weld, options.split_16bit, options.optimize, static_cast<uint8_t>(options.normals)};
+    uint64_t lods = hash_bytes(options.lod_ratios.data(), options.lod_ratios.size() * sizeof(float));
+    return hash_bytes(&key, sizeof(key), lods);
+}
+
+static int64_t mtime_of(const std::filesystem::path& path, std::error_code& ec) {
+    return std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+}
+
+static uint64_t hash_file(const std::filesystem::path& path) {
+    MappedFile file(path);
+    return hash_content(file.data(), file.size());
+}
+
+static bool section_valid(const CacheSection& s, size_t file_size, size_t element_size = 1) {
+    return s.offset % CACHE_ALIGNMENT == 0 && s.offset <= file_size && s.bytes <= file_size - s.offset
+           && s.bytes % element_size == 0;
+}
+
+// Submeshes must stay inside the index and vertex buffers and LODs inside the submeshes,
+// or a corrupt entry would have the GPU or Mesh::draw read out of bounds
+static bool ranges_valid(const CacheHeader& header, const unsigned char* base) {
+    const uint64_t index_bytes = header.gpu_indices.bytes;
+    const size_t submesh_count = header.submeshes.bytes / sizeof(Submesh);
+    const Submesh* submeshes = reinterpret_cast<const Submesh*>(base + header.submeshes.offset);
+    for (size_t i = 0; i < submesh_count; ++i) {
+        const Submesh& sub = submeshes[i];
+        if (sub.index_offset % header.index_size != 0 || sub.index_offset > index_bytes
+            || uint64_t(sub.index_count) * header.index_size > index_bytes - sub.index_offset || sub.base_vertex < 0
+            || uint64_t(sub.base_vertex) > header.vertex_count) {
+            return false;
+        }
+    }
+    const size_t lod_count = header.lods.bytes / sizeof(LodRange);
+    const LodRange* lods = reinterpret_cast<const LodRange*>(base + header.lods.offset);
+    for (size_t i = 0; i < lod_count; ++i) {
+        if (uint64_t(lods[i].first_submesh) + lods[i].submesh_count > submesh_count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Header of a complete, consistent entry written by this version, nullptr for anything
+// else. Sections, sizes and ranges are checked, the index values themselves are not.
+static const CacheHeader* valid_header(const MappedFile& file) {
+    if (file.size() < sizeof(CacheHeader)) {
+        return nullptr;
+    }
+    const CacheHeader* header = reinterpret_cast<const CacheHeader*>(file.data());
+    if (std::memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header->version != CACHE_VERSION
+        || header->layout > static_cast<uint32_t>(VertexLayout::QuantizedPositionNormal)
+        || (header->index_size != 2 && header->index_size != 4)) {
+        return nullptr;
+    }
+    const size_t size = file.size();
+    if (!section_valid(header->gpu_vertices, size) || !section_valid(header->gpu_indices, size, header->index_size)
+        || !section_valid(header->submeshes, size, sizeof(Submesh))
+        || !section_valid(header->cpu_vertices, size, sizeof(Vertex))
+        || !section_valid(header->cpu_indices, size, 3 * sizeof(unsigned int))
+        || !section_valid(header->lods, size, sizeof(LodRange)) || !section_valid(header->source_path, size)) {
+        return nullptr;
+    }
+    if (header->vertex_count > header->gpu_vertices.bytes
+        || header->gpu_vertices.bytes != header->vertex_count * vertex_stride(static_cast<VertexLayout>(header->layout))
+        || !ranges_valid(*header, file.data())) {
+        return nullptr;
+    }
+    return header;
+}
+
+MeshCacheEntry::MeshCacheEntry(std::unique_ptr<MappedFile> file) : file(std::move(file)) {
+    header = reinterpret_cast<const CacheHeader*>(this->file->data());
+}
+
+GpuMeshView MeshCacheEntry::gpu_view() const {
+    const unsigned char* base = file->data();
+    GpuMeshView view;
+    view.layout = static_cast<VertexLayout>(header->layout);
+    view.bounds.min = glm::vec3(header->bounds_min[0], header->bounds_min[1], header->bounds_min[2]);
+    view.bounds.max = glm::vec3(header->bounds_max[0], header->bounds_max[1], header->bounds_max[2]);
+    view.index_size = header->index_size;
+    view.vertex_count = header->vertex_count;
+    view.vertex_data = {base + header->gpu_vertices.offset, header->gpu_vertices.bytes};
+    view.index_data = {base + header->gpu_indices.offset, header->gpu_indices.bytes};
+    view.submeshes = {reinterpret_cast<const Submesh*>(base + header->submeshes.offset),
+                      header->submeshes.bytes / sizeof(Submesh)};
+    view.lods = {reinterpret_cast<const LodRange*>(base + header->lods.offset), header->lods.bytes / sizeof(LodRange)};
+    return view;
+}
+
+std::span<const Vertex> MeshCacheEntry::vertices() const {
+    return {reinterpret_cast<const Vertex*>(file->data() + header->cpu_vertices.offset),
+            header->cpu_vertices.bytes / sizeof(Vertex)};
+}
+
+std::span<const unsigned int> MeshCacheEntry::indices() const {
+    return {reinterpret_cast<const unsigned int*>(file->data() + header->cpu_indices.offset),
+            header->cpu_indices.bytes / sizeof(unsigned int)};
+}
+
+MeshStats MeshCacheEntry::stats() const {
+    return header->stats;
+}
+
+MeshCache::MeshCache(std::filesystem::path directory, uint64_t max_bytes)
+    : dir(std::move(directory)), max_bytes(max_bytes) {
+    // A cache that can't be created just never hits, store() warns when it can't write
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        std::cerr << "Warning: could not create mesh cache directory " << dir << ": " << ec.message() << "\n";
+    }
+}
+
+std::filesystem::path MeshCache::entry_path(const std::filesystem::path& stl_path, const MeshLoadOptions& options) const {
+    std::string key = std::filesystem::absolute(stl_path).lexically_normal().string();
+    std::ostringstream name;
+    name << std::hex << hash_bytes(key.data(), key.size(), options_hash(options)) << ".meshcache";
+    return dir / name.str();
+}
+
+std::unique_ptr<MeshCacheEntry> MeshCache::find(const std::filesystem::path& stl_path, const MeshLoadOptions& options) const {
+    std::filesystem::path path = entry_path(stl_path, options);
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec) || !std::filesystem::exists(stl_path, ec)) {
+        return nullptr;
+    }
+
+    // Anything unreadable is a miss, the load then reports problems with the STL itself
+    std::unique_ptr<MappedFile> file;
+    try {
+        file = std::make_unique<MappedFile>(path);
+    } catch (const std::exception&) {
+        return nullptr;
+    }
+    const CacheHeader* header = valid_header(*file);
+    if (!header || header->options_hash != options_hash(options)) {
+        return nullptr;
+    }
+
+    // Size and mtime are the cheap check, a touched but identical file still hits via its hash
+    uint64_t size = std::filesystem::file_size(stl_path, ec);
+    if (ec || size != header->source_size) {
+        return nullptr;
+    }
+    int64_t mtime = mtime_of(stl_path, ec);
+    if (ec) {
+        return nullptr;
+    }
+    if (mtime != header->source_mtime) {
+        try {
+            if (hash_file(stl_path) != header->source_hash) {
+                return nullptr;
+            }
+        } catch (const std::exception&) {
+            return nullptr;
+        }
+        // Same content, remember the new mtime so the next open skips hashing
+        std::fstream patch(path, std::ios::binary | std::ios::in | std::ios::out);
+        patch.seekp(offsetof(CacheHeader, source_mtime));
+        patch.write(reinterpret_cast<const char*>(&mtime), sizeof(mtime));
+    }
+
+    // Write time doubles as the LRU stamp for eviction
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+
+    return std::make_unique<MeshCacheEntry>(std::move(file));
+}
+
+void MeshCache::store(const std::filesystem::path& stl_path, const MeshLoadOptions& options, const GpuMeshData& data,
+                      const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                      const MeshStats& stats) const {
+    CacheHeader header{};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.layout = static_cast<uint32_t>(data.layout);
+    header.options_hash = options_hash(options);
+
+    // The mesh is already processed, a cache that fails here only costs the next open
+    std::error_code ec;
+    header.source_size = std::filesystem::file_size(stl_path, ec);
+    if (!ec) {
+        header.source_mtime = mtime_of(stl_path, ec);
+    }
+    if (!ec) {
+        try {
+            header.source_hash = hash_file(stl_path);
+        } catch (const std::exception&) {
+            ec = std::make_error_code(std::errc::io_error);
+        }
+    }
+    if (ec) {
+        std::cerr << "Warning: not caching " << stl_path << ": " << ec.message() << "\n";
+        return;
+    }
+    for (int i = 0; i < 3; ++i) {
+        header.bounds_min[i] = data.bounds.min[i];
+        header.bounds_max[i] = data.bounds.max[i];
+    }
+    header.index_size = data.index_size;
+    header.vertex_count = data.vertex_count;
+    header.stats = stats;
+    std::string source = std::filesystem::absolute(stl_path).lexically_normal().string();
+
+    struct Blob {
+        CacheSection* section;
+        const void* data;
+        uint64_t bytes;
+    };
+    Blob blobs[] = {
+        {&header.gpu_vertices, data.vertex_data.data(), data.vertex_data.size()},
+        {&header.gpu_indices, data.index_data.data(), data.index_data.size()},
+        {&header.submeshes, data.submeshes.data(), data.submeshes.size() * sizeof(Submesh)},
+        {&header.cpu_vertices, vertices.data(), vertices.size() * sizeof(Vertex)},
+        {&header.cpu_indices, indices.data(), indices.size() * sizeof(unsigned int)},
+        {&header.lods, data.lods.data(), data.lods.size() * sizeof(LodRange)},
+        {&header.source_path, source.data(), source.size()},
+    };
+
+    uint64_t offset = CACHE_ALIGNMENT;
+    for (Blob& b : blobs) {
+        b.section->offset = offset;
+        b.section->bytes = b.bytes;
+        offset += (b.bytes + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+    }
+
+    // Written beside the final name and renamed so readers never see a partial entry, the
+    // temporary name is per writer since tasks and other instances may store the same entry
+    std::filesystem::path path = entry_path(stl_path, options);
+    std::filesystem::path temp = unique_temp_path(path);
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "Warning: could not write mesh cache entry " << temp << "\n";
+            return;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const Blob& b : blobs) {
+            out.seekp(static_cast<std::streamoff>(b.section->offset));
+            out.write(static_cast<const char*>(b.data), static_cast<std::streamsize>(b.bytes));
+        }
+        // Pad the tail so the last section is a whole number of pages as well
+        if (offset > CACHE_ALIGNMENT) {
+            out.seekp(static_cast<std::streamoff>(offset - 1));
+            out.put('\0');
+        }
+        if (!out) {
+            std::cerr << "Warning: failed writing mesh cache entry " << temp << "\n";
+            out.close();
+            std::filesystem::remove(temp, ec);
+            return;
+        }
+    }
+    std::filesystem::rename(temp, path, ec);
+    if (ec) {
+        std::cerr << "Warning: could not move mesh cache entry into place " << path << ": " << ec.message() << "\n";
+        std::filesystem::remove(temp, ec);
+        return;
+    }
+
+    evict();
+}
+
+void MeshCache::evict() const {
+    struct Entry {
+        std::filesystem::path path;
+        uint64_t size;
+        std::filesystem::file_time_type used;
+    };
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+
+    std::error_code ec;
+    const auto now = std::filesystem::file_time_type::clock::now();
+    for (const auto& e : std::filesystem::directory_iterator(dir, ec)) {
+        if (!e.is_regular_file(ec)) {
+            continue;
+        }
+        if (e.path().extension() == ".meshcache") {
+            entries.push_back({e.path(), e.file_size(ec), e.last_write_time(ec)});
+            total += entries.back().size;
+        } else if (e.path().extension() == ".tmp"
+                   && e.path().filename().string().find(".meshcache.") != std::string::npos) {
+            // Left by a writer that crashed before its rename, live ones still count
+            std::error_code time_ec;
+            if (now - e.last_write_time(time_ec) > TEMP_FILE_MAX_AGE && !time_ec) {
+                std::filesystem::remove(e.path(), ec);
+            } else {
+                total += e.file_size(ec);
+            }
+        }
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.used < b.used; });
+    for (const Entry& e : entries) {
+        if (total <= max_bytes) {
+            break;
+        }
+        // An entry still mapped elsewhere stays valid until unmapped, removal is safe
+        if (std::filesystem::remove(e.path, ec)) {
+            total -= e.size;
+        }
+    }
+}
+
+std::vector<MeshCacheInfo> MeshCache::list() const {
+    std::vector<MeshCacheInfo> entries;
+    std::error_code ec;
+    for (const auto& e : std::filesystem::directory_iterator(dir, ec)) {
+        if (!e.is_regular_file(ec) || e.path().extension() != ".meshcache") {
+            continue;
+        }
+        // Entries from other versions or cut short are skipped, eviction cleans them up
+        std::unique_ptr<MappedFile> file;
+        try {
+            file = std::make_unique<MappedFile>(e.path());
+        } catch (const std::exception&) {
+            continue;
+        }
+        const CacheHeader* header = valid_header(*file);
+        if (!header) {
+            continue;
+        }
+
+        MeshCacheInfo info;
+        info.file = e.path();
+        info.source = std::string(reinterpret_cast<const char*>(file->data() + header->source_path.offset),
+                                  header->source_path.bytes);
+        info.bytes = file->size();
+        info.last_used = e.last_write_time(ec);
+        info.layout = static_cast<VertexLayout>(header->layout);
+        info.stats = header->stats;
+        // Cheap checks only, find() still accepts a touched file whose content hash matches
+        std::error_code source_ec;
+        uint64_t source_size = std::filesystem::file_size(info.source, source_ec);
+        info.stale = source_ec || source_size != header->source_size
+                     || mtime_of(info.source, source_ec) != header->source_mtime || source_ec;
+        entries.push_back(std::move(info));
+    }
+
+    std::sort(entries.begin(), entries.end(),
+              [](const MeshCacheInfo& a, const MeshCacheInfo& b) { return a.last_used > b.last_used; });
+    return entries;
+}
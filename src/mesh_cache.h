@@ -0,0 +1,78 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <vector>
+#include "mapped_file.h"
+#include "util.h"
+
+// Per-user default, $XDG_CACHE_HOME/stl_viewer or ~/.cache/stl_viewer
+std::filesystem::path default_cache_directory();
+
+// `path` with a suffix naming this process and thread, for writing a file beside its final
+// name before renaming it into place without racing other writers of the same file
+std::filesystem::path unique_temp_path(const std::filesystem::path& path);
+
+struct CacheHeader;
+
+// What list() reports about one entry
+struct MeshCacheInfo {
+    std::filesystem::path file;     // the entry itself
+    std::filesystem::path source;   // STL it was built from
+    uint64_t bytes = 0;
+    std::filesystem::file_time_type last_used;
+    VertexLayout layout = VertexLayout::PositionNormal;
+    MeshStats stats;
+    bool stale = false;     // source gone, or its size or mtime changed since the entry was written
+};
+
+// A validated cache file kept mapped, its sections can go straight to glBufferData
+class MeshCacheEntry {
+    public:
+        MeshCacheEntry(std::unique_ptr<MappedFile> file);
+
+        GpuMeshView gpu_view() const;
+
+        std::span<const Vertex> vertices() const;
+
+        std::span<const unsigned int> indices() const;
+
+        MeshStats stats() const;
+
+    private:
+        std::unique_ptr<MappedFile> file;
+        const CacheHeader* header;
+};
+
+// Directory of processed meshes, one file per source path and load options. An entry is
+// reused while the source keeps its size and either its mtime or its content hash.
+// Files are laid out in page aligned sections so they can be mapped and uploaded as is.
+class MeshCache {
+    public:
+        MeshCache(std::filesystem::path directory, uint64_t max_bytes = uint64_t(4) << 30);
+
+        std::unique_ptr<MeshCacheEntry> find(const std::filesystem::path& stl_path, const MeshLoadOptions& options) const;
+
+        void store(const std::filesystem::path& stl_path, const MeshLoadOptions& options, const GpuMeshData& data,
+                   const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                   const MeshStats& stats) const;
+
+        // Deletes least recently used entries until the directory fits in max_bytes
+        void evict() const;
+
+        // Valid entries of this version, most recently used first
+        std::vector<MeshCacheInfo> list() const;
+
+        const std::filesystem::path& directory() const { return dir; }
+
+    private:
+        std::filesystem::path dir;
+        uint64_t max_bytes;
+
+        std::filesystem::path entry_path(const std::filesystem::path& stl_path, const MeshLoadOptions& options) const;
+};
+
+#endif
@@ -0,0 +1,177 @@
+#include "normals.h"
+#include "parallel.h"
+#include "simplify.h"
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+struct FaceGroup {
+    glm::vec3 seed;     // unit normal of the group's first face
+    glm::vec3 sum;      // area weighted
+};
+
+// Groups the faces around one vertex, calling visit(slot, group) for each of its corners.
+// Degenerate faces have no direction, they join the first group and add nothing to it.
+template <typename F>
+void group_faces(uint32_t begin, uint32_t end, const uint32_t* corners, const glm::vec3* face_normals,
+                 float cos_crease, std::vector<FaceGroup>& groups, F&& visit) {
+    groups.clear();
+    for (uint32_t slot = begin; slot < end; ++slot) {
+        glm::vec3 n = face_normals[corners[slot] / 3];
+        float length = glm::length(n);
+        size_t group = 0;
+        if (length > 0.0f) {
+            glm::vec3 unit = n / length;
+            // A group started by a degenerate face takes the first real direction as its seed
+            while (group < groups.size() && groups[group].seed != glm::vec3(0.0f)
+                   && glm::dot(groups[group].seed, unit) < cos_crease) {
+                ++group;
+            }
+            if (group == groups.size()) {
+                groups.push_back({unit, glm::vec3(0.0f)});
+            } else if (groups[group].seed == glm::vec3(0.0f)) {
+                groups[group].seed = unit;
+            }
+        } else if (groups.empty()) {
+            groups.push_back({glm::vec3(0.0f), glm::vec3(0.0f)});
+        }
+        groups[group].sum += n;
+        visit(slot, group);
+    }
+}
+
+}
+
+size_t compute_smooth_normals(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, float crease_angle,
+                              unsigned int threads) {
+    const size_t vertex_count = vertices.size();
+    const size_t face_count = indices.size() / 3;
+    const float cos_crease = std::cos(glm::radians(crease_angle));
+
+    // The cross product's length is twice the area, which is the weight we want
+    std::vector<glm::vec3> face_normals(face_count);
+    parallel_for(face_count, [&](size_t begin, size_t end) {
+        for (size_t f = begin; f < end; ++f) {
+            glm::vec3 p0 = vertices[indices[f * 3]].position;
+            face_normals[f] = glm::cross(vertices[indices[f * 3 + 1]].position - p0,
+                                         vertices[indices[f * 3 + 2]].position - p0);
+        }
+    }, threads);
+
+    // Corners grouped by vertex, in index order
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (unsigned int index : indices) {
+        ++offsets[index + 1];
+    }
+    for (size_t v = 0; v < vertex_count; ++v) {
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<uint32_t> corners(indices.size());
+    {
+        std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t k = 0; k < indices.size(); ++k) {
+            corners[cursor[indices[k]]++] = static_cast<uint32_t>(k);
+        }
+    }
+
+    // First group stays on the vertex, the count of the others sizes the copies
+    std::vector<uint32_t> extra(vertex_count);
+    parallel_for(vertex_count, [&](size_t begin, size_t end) {
+        std::vector<FaceGroup> groups;
+        for (size_t v = begin; v < end; ++v) {
+            group_faces(offsets[v], offsets[v + 1], corners.data(), face_normals.data(), cos_crease, groups,
+                        [](uint32_t, size_t) {});
+            if (!groups.empty() && glm::length(groups[0].sum) > 0.0f) {
+                vertices[v].normal = glm::normalize(groups[0].sum);
+            }
+            extra[v] = groups.empty() ? 0 : static_cast<uint32_t>(groups.size() - 1);
+        }
+    }, threads);
+
+    std::vector<uint32_t> first_copy(vertex_count);
+    size_t added = 0;
+    for (size_t v = 0; v < vertex_count; ++v) {
+        first_copy[v] = static_cast<uint32_t>(vertex_count + added);
+        added += extra[v];
+    }
+    if (added == 0) {
+        return 0;
+    }
+
+    // Regrouping only the crease vertices is cheaper than keeping every corner's group
+    vertices.resize(vertex_count + added);
+    parallel_for(vertex_count, [&](size_t begin, size_t end) {
+        std::vector<FaceGroup> groups;
+        std::vector<std::pair<uint32_t, uint32_t>> moved;  // (slot, group) past the first
+        for (size_t v = begin; v < end; ++v) {
+            if (extra[v] == 0) {
+                continue;
+            }
+            moved.clear();
+            group_faces(offsets[v], offsets[v + 1], corners.data(), face_normals.data(), cos_crease, groups,
+                        [&](uint32_t slot, size_t group) {
+                if (group > 0) {
+                    moved.push_back({slot, static_cast<uint32_t>(group)});
+                }
+            });
+            for (size_t group = 1; group < groups.size(); ++group) {
+                Vertex& copy = vertices[first_copy[v] + group - 1];
+                copy.position = vertices[v].position;
+                copy.normal = glm::length(groups[group].sum) > 0.0f ? glm::normalize(groups[group].sum)
+                                                                    : vertices[v].normal;
+            }
+            for (const auto& [slot, group] : moved) {
+                indices[corners[slot]] = first_copy[v] + group - 1;
+            }
+        }
+    }, threads);
+    return added;
+}
+
+void assign_crease_copies(const std::vector<Vertex>& vertices, size_t welded_vertex_count,
+                          const std::vector<unsigned int>& welded_indices, const std::vector<unsigned int>& indices,
+                          std::vector<MeshLod>& lods) {
+    // Copies sit past the welded vertices, grouped here by the vertex they were split from
+    const size_t copy_count = vertices.size() - welded_vertex_count;
+    if (copy_count == 0 || lods.empty()) {
+        return;
+    }
+    std::vector<uint32_t> source(copy_count, ~0u);
+    for (size_t corner = 0; corner < indices.size(); ++corner) {
+        if (indices[corner] >= welded_vertex_count) {
+            source[indices[corner] - welded_vertex_count] = welded_indices[corner];
+        }
+    }
+    std::vector<uint32_t> first(welded_vertex_count + 1, 0);
+    for (uint32_t v : source) {
+        ++first[v + 1];
+    }
+    for (size_t v = 0; v < welded_vertex_count; ++v) {
+        first[v + 1] += first[v];
+    }
+    std::vector<uint32_t> copies(copy_count);
+    std::vector<uint32_t> fill(first.begin(), first.end() - 1);
+    for (size_t c = 0; c < copy_count; ++c) {
+        copies[fill[source[c]]++] = static_cast<uint32_t>(welded_vertex_count + c);
+    }
+
+    for (MeshLod& lod : lods) {
+        for (size_t f = 0; f + 2 < lod.indices.size(); f += 3) {
+            unsigned int* corner = &lod.indices[f];
+            glm::vec3 p0 = vertices[corner[0]].position;
+            glm::vec3 n = glm::cross(vertices[corner[1]].position - p0, vertices[corner[2]].position - p0);
+            for (int k = 0; k < 3; ++k) {
+                uint32_t v = corner[k];
+                float best = glm::dot(vertices[v].normal, n);
+                for (uint32_t i = first[v]; i < first[v + 1]; ++i) {
+                    float d = glm::dot(vertices[copies[i]].normal, n);
+                    if (d > best) {
+                        best = d;
+                        corner[k] = copies[i];
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef NORMALS_H
+#define NORMALS_H
+
+#include <cstddef>
+#include <vector>
+#include "vertex.h"
+
+struct MeshLod;
+
+enum class NormalMode {
+    File,       // facet normals stored in the STL, averaged where welding merges corners
+    Smooth,     // recomputed from the welded mesh, area weighted and split at creases
+};
+
+// Replaces every normal with the area weighted average of the faces around its vertex.
+// Faces around a vertex are grouped greedily, each joining the first group whose first
+// face is within `crease_angle` degrees of its own, and every group past the first gets a
+// copy of the vertex so hard edges stay sharp. Copies are appended and the indices of
+// their corners rewritten. Face normals and grouping run in parallel over contiguous
+// ranges, so the result is the same for any thread count. Returns the vertices added.
+size_t compute_smooth_normals(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, float crease_angle,
+                              unsigned int threads = 0);
+
+// LODs are simplified on the welded mesh, where a crease is still one shared edge rather
+// than two open borders that would collapse apart. This points their corners at the copy
+// compute_smooth_normals made of each vertex whose normal is closest to the LOD face's.
+// `welded_indices` and `welded_vertex_count` describe the mesh before the split.
+void assign_crease_copies(const std::vector<Vertex>& vertices, size_t welded_vertex_count,
+                          const std::vector<unsigned int>& welded_indices, const std::vector<unsigned int>& indices,
+                          std::vector<MeshLod>& lods);
+
+#endif
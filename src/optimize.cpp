@@ -0,0 +1,187 @@
+#include "optimize.h"
+#include <algorithm>
+#include <cmath>
+
+VertexCacheStats analyze_vertex_cache(const std::vector<unsigned int>& indices, size_t vertex_count,
+                                      unsigned int cache_size) {
+    VertexCacheStats stats;
+    if (indices.empty() || vertex_count == 0) {
+        return stats;
+    }
+
+    // A vertex is in the cache while fewer than cache_size misses happened since it entered
+    std::vector<size_t> entered(vertex_count, 0);
+    size_t misses = 0;
+    for (unsigned int v : indices) {
+        if (entered[v] == 0 || misses - entered[v] + 1 > cache_size) {
+            ++misses;
+            entered[v] = misses;
+        }
+    }
+
+    size_t used = 0;
+    for (size_t e : entered) {
+        used += e != 0;
+    }
+
+    stats.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+    stats.atvr = static_cast<float>(misses) / static_cast<float>(used);
+    return stats;
+}
+
+namespace {
+
+constexpr int CACHE_SIZE = 32;
+constexpr unsigned int MAX_VALENCE_SCORE = 32;
+
+// Scores from Forsyth's paper: recently used vertices score high except the last
+// triangle's own three, and low valence vertices get a boost so islands get finished
+struct ScoreTable {
+    float cache[CACHE_SIZE];
+    float valence[MAX_VALENCE_SCORE + 1];
+
+    ScoreTable() {
+        for (int i = 0; i < CACHE_SIZE; ++i) {
+            cache[i] = i < 3 ? 0.75f : std::pow(1.0f - float(i - 3) / float(CACHE_SIZE - 3), 1.5f);
+        }
+        valence[0] = 0.0f;
+        for (unsigned int i = 1; i <= MAX_VALENCE_SCORE; ++i) {
+            valence[i] = 2.0f / std::sqrt(float(i));
+        }
+    }
+
+    float score(int cache_position, unsigned int remaining) const {
+        if (remaining == 0) {
+            return -1.0f;
+        }
+        float s = cache_position >= 0 ? cache[cache_position] : 0.0f;
+        return s + valence[std::min(remaining, MAX_VALENCE_SCORE)];
+    }
+};
+
+}
+
+void optimize_vertex_cache(std::vector<unsigned int>& indices, size_t vertex_count) {
+    const size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0) {
+        return;
+    }
+    static const ScoreTable table;
+
+    // Per vertex list of triangles that still need emitting, stored CSR style
+    std::vector<unsigned int> offsets(vertex_count + 1, 0);
+    for (unsigned int v : indices) {
+        ++offsets[v + 1];
+    }
+    for (size_t v = 0; v < vertex_count; ++v) {
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<unsigned int> remaining(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v) {
+        remaining[v] = offsets[v + 1] - offsets[v];
+    }
+    std::vector<unsigned int> adjacency(indices.size());
+    {
+        std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); ++i) {
+            adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+        }
+    }
+
+    std::vector<int> cache_position(vertex_count, -1);
+    std::vector<float> vertex_score(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v) {
+        vertex_score[v] = table.score(-1, remaining[v]);
+    }
+
+    std::vector<bool> emitted(triangle_count, false);
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    std::vector<unsigned int> cache, next_cache;
+    cache.reserve(CACHE_SIZE + 3);
+    next_cache.reserve(CACHE_SIZE + 3);
+
+    size_t cursor = 0;  // first triangle that might still be pending, for restarts
+    long best = -1;
+
+    while (output.size() < indices.size()) {
+        if (best < 0) {
+            // Nothing in the cache touches pending triangles, start at the next one in input order
+            while (emitted[cursor]) {
+                ++cursor;
+            }
+            best = static_cast<long>(cursor);
+        }
+
+        const unsigned int* tri = &indices[best * 3];
+        emitted[best] = true;
+        next_cache.assign(tri, tri + 3);
+
+        for (int c = 0; c < 3; ++c) {
+            unsigned int v = tri[c];
+            output.push_back(v);
+
+            // Swap-remove the triangle from the vertex's pending list
+            unsigned int* begin = &adjacency[offsets[v]];
+            unsigned int* end = begin + remaining[v];
+            *std::find(begin, end, static_cast<unsigned int>(best)) = *(end - 1);
+            --remaining[v];
+        }
+
+        for (unsigned int v : cache) {
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                next_cache.push_back(v);
+            }
+        }
+
+        // Evicted vertices lose their cache bonus, then rescore everything that moved
+        for (size_t i = CACHE_SIZE; i < next_cache.size(); ++i) {
+            cache_position[next_cache[i]] = -1;
+            vertex_score[next_cache[i]] = table.score(-1, remaining[next_cache[i]]);
+        }
+        if (next_cache.size() > CACHE_SIZE) {
+            next_cache.resize(CACHE_SIZE);
+        }
+        for (size_t i = 0; i < next_cache.size(); ++i) {
+            unsigned int v = next_cache[i];
+            cache_position[v] = static_cast<int>(i);
+            vertex_score[v] = table.score(static_cast<int>(i), remaining[v]);
+        }
+        std::swap(cache, next_cache);
+
+        best = -1;
+        float best_score = -1.0f;
+        for (unsigned int v : cache) {
+            for (unsigned int k = 0; k < remaining[v]; ++k) {
+                unsigned int t = adjacency[offsets[v] + k];
+                float score = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] +
+                              vertex_score[indices[t * 3 + 2]];
+                if (score > best_score) {
+                    best_score = score;
+                    best = t;
+                }
+            }
+        }
+    }
+
+    indices = std::move(output);
+}
+
+std::vector<unsigned int> optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    constexpr unsigned int UNSEEN = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), UNSEEN);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+
+    for (unsigned int& i : indices) {
+        if (remap[i] == UNSEEN) {
+            remap[i] = static_cast<unsigned int>(reordered.size());
+            reordered.push_back(vertices[i]);
+        }
+        i = remap[i];
+    }
+
+    vertices = std::move(reordered);
+    return remap;
+}
@@ -0,0 +1,26 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include <cstddef>
+#include <vector>
+#include "vertex.h"
+
+struct VertexCacheStats {
+    float acmr = 0.0f;  // average cache miss ratio, transformed vertices per triangle
+    float atvr = 0.0f;  // average transform to vertex ratio, 1.0 is optimal
+};
+
+// Simulates a FIFO post-transform cache of `cache_size` entries over the index buffer
+VertexCacheStats analyze_vertex_cache(const std::vector<unsigned int>& indices, size_t vertex_count,
+                                      unsigned int cache_size = 16);
+
+// Reorders triangles for post-transform cache reuse using Forsyth's linear speed
+// vertex cache optimisation. Only the index buffer changes.
+void optimize_vertex_cache(std::vector<unsigned int>& indices, size_t vertex_count);
+
+// Renumbers vertices in order of first use so vertex fetch streams through memory.
+// Vertices no triangle references are dropped. Returns the new index of every old
+// vertex, ~0u for dropped ones, for other index buffers over the same vertices.
+std::vector<unsigned int> optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+#endif
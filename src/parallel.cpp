@@ -0,0 +1,137 @@
+#include "parallel.h"
+#include <atomic>
+#include <memory>
+#include <utility>
+
+ThreadPool::ThreadPool(unsigned int threads) {
+    threads = resolve_thread_count(threads);
+    workers.reserve(threads);
+    for (unsigned int i = 0; i < threads; ++i) {
+        workers.emplace_back([this] { worker_loop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(task));
+    }
+    wake.notify_one();
+}
+
+void ThreadPool::worker_loop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping && queue.empty()) {
+                return;
+            }
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::run(size_t count, unsigned int threads, const std::function<void(size_t)>& task) {
+    if (count == 0) {
+        return;
+    }
+    threads = resolve_thread_count(threads);
+
+    // Helpers may start after run() has returned, so the shared counters outlive this frame
+    struct Batch {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto batch = std::make_shared<Batch>();
+
+    auto drain = [batch, count, &task] {
+        size_t i;
+        while ((i = batch->next.fetch_add(1)) < count) {
+            task(i);
+            if (batch->done.fetch_add(1) + 1 == count) {
+                std::lock_guard<std::mutex> lock(batch->mutex);
+                batch->finished.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min<size_t>({count - 1, static_cast<size_t>(threads) - 1, workers.size()});
+    for (size_t h = 0; h < helpers; ++h) {
+        // A late helper finds next >= count and never touches `task`
+        submit(drain);
+    }
+    drain();
+
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->finished.wait(lock, [&] { return batch->done.load() == count; });
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+TaskGroup::~TaskGroup() {
+    // Tasks reference the group, never let it go away underneath them
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return running == 0; });
+}
+
+void TaskGroup::run(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++running;
+    }
+    pool.submit([this, task = std::move(task)] {
+        std::exception_ptr error;
+        try {
+            task();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (error && !failure) {
+            failure = error;
+        }
+        if (--running == 0) {
+            idle.notify_all();
+        }
+    });
+}
+
+void TaskGroup::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return running == 0; });
+    if (failure) {
+        std::rethrow_exception(std::exchange(failure, nullptr));
+    }
+}
+
+size_t TaskGroup::pending() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return running;
+}
+
+unsigned int resolve_thread_count(unsigned int threads) {
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    return std::max(threads, 1u);
+}
@@ -0,0 +1,95 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads fed from a single FIFO queue
+class ThreadPool {
+    public:
+        explicit ThreadPool(unsigned int threads = 0);
+
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        void submit(std::function<void()> task);
+
+        // Runs task(0) .. task(count - 1) on at most `threads` threads including the
+        // caller, which keeps working until every item is done. Safe to call from inside
+        // a pool task since the caller never blocks while items are still queued.
+        void run(size_t count, unsigned int threads, const std::function<void(size_t)>& task);
+
+        unsigned int size() const { return static_cast<unsigned int>(workers.size()); }
+
+        // Process wide pool sized to the machine
+        static ThreadPool& shared();
+
+    private:
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> queue;
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool stopping = false;
+
+        void worker_loop();
+};
+
+// Tasks submitted to a pool that the submitter can wait on as a group. Exceptions thrown
+// by a task are caught, the first one is rethrown from wait().
+class TaskGroup {
+    public:
+        explicit TaskGroup(ThreadPool& pool = ThreadPool::shared()) : pool(pool) {}
+
+        ~TaskGroup();
+
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+        void run(std::function<void()> task);
+
+        void wait();
+
+        size_t pending() const;
+
+    private:
+        ThreadPool& pool;
+        mutable std::mutex mutex;
+        std::condition_variable idle;
+        size_t running = 0;
+        std::exception_ptr failure;
+};
+
+// Resolves a thread count knob, 0 means every core
+unsigned int resolve_thread_count(unsigned int threads);
+
+// Splits [0, count) into contiguous chunks and calls fn(begin, end) for each. Chunk
+// boundaries depend only on count, grain and the thread count, never on scheduling,
+// so anything writing to index-addressed output is deterministic.
+template <typename F>
+void parallel_for(size_t count, F&& fn, unsigned int threads = 0, size_t grain = 4096) {
+    if (count == 0) {
+        return;
+    }
+
+    threads = resolve_thread_count(threads);
+    size_t chunks = std::min<size_t>((count + grain - 1) / grain, static_cast<size_t>(threads) * 4);
+    if (chunks <= 1) {
+        fn(size_t(0), count);
+        return;
+    }
+
+    ThreadPool::shared().run(chunks, threads, [&](size_t chunk) {
+        fn(count * chunk / chunks, count * (chunk + 1) / chunks);
+    });
+}
+
+#endif
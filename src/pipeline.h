@@ -0,0 +1,105 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+#include "parallel.h"
+
+// Runs produce(i) for every i in [0, count) on up to `producers` threads of its own while the
+// calling thread runs consume(i, result) in index order. Producers only claim an item
+// while fewer than `capacity` items are waiting to be consumed, so memory stays bounded
+// however far ahead they could get, and a slow item holds back at most `capacity` others.
+// produce should catch per item failures itself and report them in its result. Anything
+// thrown out of produce or consume stops the pipeline and is rethrown here once every
+// producer has returned. Producers are not pool workers, a producer waiting for room never
+// keeps the pool from running parallel_for helpers or tasks the consumer hands out.
+template <typename T, typename Produce, typename Consume>
+void run_pipeline(size_t count, size_t capacity, unsigned int producers, Produce&& produce, Consume&& consume) {
+    if (count == 0) {
+        return;
+    }
+    capacity = std::max<size_t>(capacity, 1);
+
+    struct State {
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::vector<std::optional<T>> window;   // item i waits in slot i % capacity
+        size_t next_claim = 0;
+        size_t next_consume = 0;
+        bool stopping = false;
+        std::exception_ptr failure;
+    } state;
+    state.window.resize(capacity);
+
+    auto stop = [&](std::exception_ptr error) {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (!state.failure) {
+            state.failure = error;
+        }
+        state.stopping = true;
+        state.changed.notify_all();
+    };
+
+    std::vector<std::thread> threads;
+    producers = static_cast<unsigned int>(std::min<size_t>(resolve_thread_count(producers), count));
+    for (unsigned int p = 0; p < producers; ++p) {
+        threads.emplace_back([&] {
+            try {
+                while (true) {
+                    size_t i;
+                    {
+                        std::unique_lock<std::mutex> lock(state.mutex);
+                        state.changed.wait(lock, [&] {
+                            return state.stopping || state.next_claim == count
+                                || state.next_claim < state.next_consume + capacity;
+                        });
+                        if (state.stopping || state.next_claim == count) {
+                            return;
+                        }
+                        i = state.next_claim++;
+                    }
+                    T result = produce(i);
+                    std::lock_guard<std::mutex> lock(state.mutex);
+                    state.window[i % capacity].emplace(std::move(result));
+                    state.changed.notify_all();
+                }
+            } catch (...) {
+                stop(std::current_exception());
+            }
+        });
+    }
+
+    try {
+        for (size_t i = 0; i < count; ++i) {
+            std::optional<T> item;
+            {
+                std::unique_lock<std::mutex> lock(state.mutex);
+                state.changed.wait(lock, [&] { return state.stopping || state.window[i % capacity].has_value(); });
+                if (state.stopping) {
+                    break;
+                }
+                item.swap(state.window[i % capacity]);
+                ++state.next_consume;
+                state.changed.notify_all();
+            }
+            consume(i, std::move(*item));
+        }
+    } catch (...) {
+        stop(std::current_exception());
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    if (state.failure) {
+        std::rethrow_exception(state.failure);
+    }
+}
+
+#endif
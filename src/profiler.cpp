@@ -0,0 +1,276 @@
+#include "profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+
+constexpr uint32_t GPU_THREAD = 0;
+
+// Small stable ids read better in trace viewers than hashed std::thread::ids
+uint32_t thread_index() {
+    static std::atomic<uint32_t> next{GPU_THREAD + 1};
+    thread_local uint32_t index = next++;
+    return index;
+}
+
+void add_stage(std::vector<StageTime>& stages, const char* name, double ms) {
+    for (StageTime& stage : stages) {
+        if (stage.name == name || std::strcmp(stage.name, name) == 0) {
+            stage.ms += ms;
+            return;
+        }
+    }
+    stages.push_back({name, ms});
+}
+
+// Fixed per stage, so a bar keeps its color when stages before it come and go
+struct StageColor {
+    const char* name;
+    float rgb[3];
+};
+
+constexpr StageColor STAGE_COLORS[] = {
+    {"input", {0.90f, 0.30f, 0.25f}},
+    {"stream upload", {0.95f, 0.55f, 0.15f}},
+    {"clear", {0.55f, 0.55f, 0.55f}},
+    {"pick", {0.95f, 0.40f, 0.70f}},
+    {"uniforms", {0.95f, 0.80f, 0.20f}},
+    {"culling", {0.30f, 0.75f, 0.35f}},
+    {"draws", {0.25f, 0.55f, 0.90f}},
+    {"swap", {0.65f, 0.40f, 0.85f}},
+};
+
+// Anything else is hashed onto its own list, stable from frame to frame
+constexpr float OTHER_COLORS[][3] = {
+    {0.20f, 0.80f, 0.80f}, {0.75f, 0.85f, 0.35f}, {0.85f, 0.65f, 0.50f}, {0.50f, 0.35f, 0.25f},
+};
+
+const float* stage_color(const char* name) {
+    for (const StageColor& stage : STAGE_COLORS) {
+        if (std::strcmp(stage.name, name) == 0) {
+            return stage.rgb;
+        }
+    }
+    size_t hash = std::hash<std::string_view>{}(name);
+    return OTHER_COLORS[hash % std::size(OTHER_COLORS)];
+}
+
+void fill_rect(int x, int y, int width, int height, const float* rgb) {
+    glScissor(x, y, width, height);
+    glClearColor(rgb[0], rgb[1], rgb[2], 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+// 3x5 capitals and digits, one octal digit per row from the top, set bits are lit
+uint16_t glyph(char c) {
+    static constexpr uint16_t LETTERS[26] = {
+        025755, 065656, 034443, 065556, 074647, 074644, 034553, 055755, 072227, 011152, 055655, 044447, 057755,
+        065555, 025552, 065644, 025563, 065655, 034216, 072222, 055557, 055552, 055775, 055255, 055222, 071247,
+    };
+    static constexpr uint16_t DIGITS[10] = {
+        075557, 026227, 061247, 061216, 055711, 074616, 034757, 071222, 075757, 075716,
+    };
+    if (c >= 'a' && c <= 'z') {
+        return LETTERS[c - 'a'];
+    }
+    if (c >= 'A' && c <= 'Z') {
+        return LETTERS[c - 'A'];
+    }
+    if (c >= '0' && c <= '9') {
+        return DIGITS[c - '0'];
+    }
+    return c == '.' ? 000002 : 0;
+}
+
+int text_width(std::string_view text, int scale) {
+    return static_cast<int>(text.size()) * 4 * scale;
+}
+
+// With scissored clears like the bars, one per run of lit pixels in a glyph row
+void draw_text(int x, int y, int scale, std::string_view text, const float* rgb) {
+    glClearColor(rgb[0], rgb[1], rgb[2], 1.0f);
+    for (char c : text) {
+        uint16_t bits = glyph(c);
+        for (int row = 0; row < 5; ++row) {
+            unsigned int pixels = (bits >> (3 * (4 - row))) & 7;
+            int top = y + (4 - row) * scale;
+            for (int col = 0; col < 3;) {
+                if (!(pixels & (4 >> col))) {
+                    ++col;
+                    continue;
+                }
+                int run = col;
+                while (run < 3 && (pixels & (4 >> run))) {
+                    ++run;
+                }
+                glScissor(x + col * scale, top, (run - col) * scale, scale);
+                glClear(GL_COLOR_BUFFER_BIT);
+                col = run;
+            }
+        }
+        x += 4 * scale;
+    }
+}
+
+// Names are literals from our own code, only quotes and backslashes would need escaping
+void write_json_string(std::ofstream& out, const char* text) {
+    out << '"';
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\';
+        }
+        out << *c;
+    }
+    out << '"';
+}
+
+}
+
+Profiler::Profiler(size_t max_events) : max_events(max_events) {
+}
+
+Profiler::~Profiler() {
+    for (GpuFrame& slot : gpu_frames) {
+        if (!slot.queries.empty()) {
+            glDeleteQueries(static_cast<GLsizei>(slot.queries.size()), slot.queries.data());
+        }
+    }
+}
+
+double Profiler::now_us() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Profiler::record(const char* name, double start_us, double duration_us, const char* category) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (events.size() < max_events) {
+        events.push_back({name, category, start_us, duration_us,
+                          category == std::string_view("gpu") ? GPU_THREAD : thread_index()});
+    }
+    if (category != std::string_view("gpu")) {
+        add_stage(frame_cpu, name, duration_us / 1000.0);
+    }
+}
+
+void Profiler::collect(GpuFrame& slot) {
+    if (slot.ranges.empty()) {
+        return;
+    }
+    // Queries finish in order, so the last one being ready means they all are
+    GLint available = 0;
+    glGetQueryObjectiv(slot.ranges.back().query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        ++dropped_frames;
+        slot.ranges.clear();
+        return;
+    }
+
+    // GL_TIME_ELAPSED has no timestamp, so ranges sit at their submission time
+    last_gpu.clear();
+    for (const GpuRange& range : slot.ranges) {
+        GLuint64 elapsed_ns = 0;
+        glGetQueryObjectui64v(range.query, GL_QUERY_RESULT, &elapsed_ns);
+        record(range.name, range.start_us, static_cast<double>(elapsed_ns) / 1000.0, "gpu");
+        add_stage(last_gpu, range.name, static_cast<double>(elapsed_ns) / 1e6);
+    }
+    slot.ranges.clear();
+}
+
+void Profiler::begin_frame() {
+    ++frame;
+    collect(gpu_frames[frame % FRAMES_IN_FLIGHT]);
+    std::lock_guard<std::mutex> lock(mutex);
+    frame_cpu.clear();
+}
+
+void Profiler::end_frame() {
+    if (gpu_open) {
+        gpu_end();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    last_cpu = frame_cpu;
+}
+
+void Profiler::gpu_begin(const char* name) {
+    if (gpu_open) {
+        throw std::logic_error("GPU profile ranges can't nest");
+    }
+    GpuFrame& slot = gpu_frames[frame % FRAMES_IN_FLIGHT];
+    if (slot.ranges.size() == slot.queries.size()) {
+        GLuint query;
+        glGenQueries(1, &query);
+        slot.queries.push_back(query);
+    }
+    GLuint query = slot.queries[slot.ranges.size()];
+    slot.ranges.push_back({name, query, now_us()});
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    gpu_open = true;
+}
+
+void Profiler::gpu_end() {
+    glEndQuery(GL_TIME_ELAPSED);
+    gpu_open = false;
+}
+
+void Profiler::write_chrome_trace(const std::filesystem::path& path) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ofstream out(path, std::ios::trunc);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << GPU_THREAD
+        << ",\"args\":{\"name\":\"GPU\"}}";
+    for (const ProfileEvent& event : events) {
+        out << ",\n{\"name\":";
+        write_json_string(out, event.name);
+        out << ",\"cat\":\"" << event.category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+            << ",\"ts\":" << event.start_us << ",\"dur\":" << event.duration_us << "}";
+    }
+    out << "\n]}\n";
+    if (!out) {
+        throw std::runtime_error("Failed to write " + path.string());
+    }
+}
+
+void Profiler::draw_overlay(int width, int height) const {
+    const double FRAME_MS = 1000.0 / 60.0;
+    const int BAR_HEIGHT = std::max(height / 100, 4);
+    const int SCALE = std::max(height / 300, 1);
+
+    glEnable(GL_SCISSOR_TEST);
+    const std::vector<StageTime>* rows[] = {&last_gpu, &last_cpu};
+    std::vector<const char*> legend;
+    for (int row = 0; row < 2; ++row) {
+        int y = 2 + row * (BAR_HEIGHT + 2);
+        int x = 0;
+        for (const StageTime& stage : *rows[row]) {
+            int bar = std::max(static_cast<int>(stage.ms / FRAME_MS * width), 1);
+            fill_rect(x, y, bar, BAR_HEIGHT, stage_color(stage.name));
+            x += bar;
+            if (std::none_of(legend.begin(), legend.end(),
+                             [&](const char* name) { return std::strcmp(name, stage.name) == 0; })) {
+                legend.push_back(stage.name);
+            }
+        }
+    }
+
+    // Swatch and name of every stage in the bars, wrapping above them
+    const float TEXT[3] = {0.95f, 0.95f, 0.95f};
+    const int LINE = 7 * SCALE;
+    int x = 2;
+    int y = 2 + 2 * (BAR_HEIGHT + 2) + SCALE;
+    for (const char* name : legend) {
+        int entry = 7 * SCALE + text_width(name, SCALE);
+        if (x > 2 && x + entry > width) {
+            x = 2;
+            y += LINE;
+        }
+        fill_rect(x, y, 5 * SCALE, 5 * SCALE, stage_color(name));
+        draw_text(x + 7 * SCALE, y, SCALE, name, TEXT);
+        x += entry + 4 * SCALE;
+    }
+    glDisable(GL_SCISSOR_TEST);
+}
@@ -0,0 +1,120 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+#include <glad/glad.h>
+
+// One timed range. Names and categories are string literals, they are never copied.
+struct ProfileEvent {
+    const char* name;
+    const char* category;   // "cpu" or "gpu"
+    double start_us;        // since the profiler was created
+    double duration_us;
+    uint32_t thread;        // small id per recording thread, the GPU has its own
+};
+
+// Time spent in one stage of the last finished frame, for the overlay
+struct StageTime {
+    const char* name;
+    double ms;
+};
+
+// Per frame CPU and GPU timing. CPU ranges come from ProfileScope and may be recorded on
+// any thread. GPU ranges are GL_TIME_ELAPSED queries kept in a ring of frames and read
+// back only once available, so profiling never waits on the GPU; a frame whose results
+// are still pending when its slot comes around again is dropped. Timer queries can't
+// nest, so GPU ranges must not overlap.
+//
+// Every event is kept, up to max_events, for write_chrome_trace().
+class Profiler {
+    public:
+        explicit Profiler(size_t max_events = size_t(1) << 20);
+
+        ~Profiler();
+
+        Profiler(const Profiler&) = delete;
+        Profiler& operator=(const Profiler&) = delete;
+
+        // Collects GPU results that have arrived and starts the next frame's slot
+        void begin_frame();
+
+        // Publishes the frame's CPU stages to cpu_stages()
+        void end_frame();
+
+        double now_us() const;
+
+        void record(const char* name, double start_us, double duration_us, const char* category = "cpu");
+
+        void gpu_begin(const char* name);
+
+        void gpu_end();
+
+        const std::vector<StageTime>& cpu_stages() const { return last_cpu; }
+
+        // Of the newest frame whose queries have come back, a few frames old
+        const std::vector<StageTime>& gpu_stages() const { return last_gpu; }
+
+        size_t dropped_gpu_frames() const { return dropped_frames; }
+
+        // Chrome's trace event format, loadable in about:tracing or Perfetto
+        void write_chrome_trace(const std::filesystem::path& path) const;
+
+        // Stacked bars along the bottom of the bound framebuffer, CPU above GPU, full
+        // width being one 60 Hz frame, with a legend naming each stage's color above them.
+        // Drawn with scissored clears, text included, so no program is needed.
+        void draw_overlay(int width, int height) const;
+
+    private:
+        static constexpr size_t FRAMES_IN_FLIGHT = 4;
+
+        struct GpuRange {
+            const char* name;
+            GLuint query;
+            double start_us;
+        };
+
+        struct GpuFrame {
+            std::vector<GpuRange> ranges;
+            std::vector<GLuint> queries;    // pooled, ranges use a prefix
+        };
+
+        std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+        size_t max_events;
+
+        mutable std::mutex mutex;
+        std::vector<ProfileEvent> events;
+        std::vector<StageTime> frame_cpu;
+
+        std::array<GpuFrame, FRAMES_IN_FLIGHT> gpu_frames;
+        size_t frame = 0;
+        bool gpu_open = false;
+        size_t dropped_frames = 0;
+
+        std::vector<StageTime> last_cpu, last_gpu;
+
+        void collect(GpuFrame& slot);
+};
+
+// CPU range from construction to destruction
+class ProfileScope {
+    public:
+        ProfileScope(Profiler& profiler, const char* name) : profiler(profiler), name(name), start(profiler.now_us()) {}
+
+        ~ProfileScope() { profiler.record(name, start, profiler.now_us() - start); }
+
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+
+    private:
+        Profiler& profiler;
+        const char* name;
+        double start;
+};
+
+#endif
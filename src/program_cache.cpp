@@ -0,0 +1,125 @@
+#include "program_cache.h"
+#include "hash.h"
+#include "mesh_cache.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+constexpr char PROGRAM_MAGIC[8] = {'S', 'T', 'L', 'P', 'R', 'O', 'G', '\0'};
+constexpr uint32_t PROGRAM_VERSION = 1;
+
+struct ProgramHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t format;    // binaryFormat from glGetProgramBinary
+    uint64_t key;
+    uint64_t bytes;
+};
+
+std::filesystem::path default_program_cache_directory() {
+    return default_cache_directory() / "programs";
+}
+
+ProgramCache::ProgramCache(std::filesystem::path directory) : dir(std::move(directory)) {
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+}
+
+uint64_t ProgramCache::key(std::string_view vs_source, std::string_view fs_source) {
+    uint64_t key = PROGRAM_VERSION;
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION}) {
+        const char* text = reinterpret_cast<const char*>(glGetString(name));
+        key = hash_bytes(text, text ? std::strlen(text) : 0, key);
+    }
+    key = hash_bytes(vs_source.data(), vs_source.size(), key);
+    return hash_bytes(fs_source.data(), fs_source.size(), key);
+}
+
+bool ProgramCache::supported() {
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+std::filesystem::path ProgramCache::entry_path(uint64_t key) const {
+    std::ostringstream name;
+    name << std::hex << key << ".glprogram";
+    return dir / name.str();
+}
+
+bool ProgramCache::load(GLuint program, uint64_t key) const {
+    std::filesystem::path path = entry_path(key);
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    ProgramHeader header{};
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || std::memcmp(header.magic, PROGRAM_MAGIC, sizeof(PROGRAM_MAGIC)) != 0 || header.version != PROGRAM_VERSION
+        || header.key != key) {
+        return false;
+    }
+    // A truncated or corrupt entry is a miss, never an allocation sized by whatever it claims
+    std::error_code ec;
+    uintmax_t file_bytes = std::filesystem::file_size(path, ec);
+    if (ec || file_bytes != sizeof(header) + header.bytes
+        || header.bytes > static_cast<uint64_t>(std::numeric_limits<GLsizei>::max())) {
+        return false;
+    }
+    std::vector<char> binary(header.bytes);
+    if (!in.read(binary.data(), static_cast<std::streamsize>(binary.size()))) {
+        return false;
+    }
+
+    glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE;
+}
+
+void ProgramCache::store(GLuint program, uint64_t key) const {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<char> binary(static_cast<size_t>(length));
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0) {
+        return;
+    }
+
+    ProgramHeader header{};
+    std::memcpy(header.magic, PROGRAM_MAGIC, sizeof(PROGRAM_MAGIC));
+    header.version = PROGRAM_VERSION;
+    header.format = format;
+    header.key = key;
+    header.bytes = static_cast<uint64_t>(written);
+
+    // Written beside the final name and renamed so a second instance never reads half a file
+    std::filesystem::path path = entry_path(key);
+    std::filesystem::path temp = unique_temp_path(path);
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(binary.data(), written);
+        if (!out) {
+            std::cerr << "Warning: could not write program cache entry " << temp << "\n";
+            out.close();
+            std::error_code ec;
+            std::filesystem::remove(temp, ec);
+            return;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(temp, path, ec);
+    if (ec) {
+        std::cerr << "Warning: could not move program cache entry into place " << path << ": " << ec.message() << "\n";
+        std::filesystem::remove(temp, ec);
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+#include <glad/glad.h>
+
+// default_cache_directory()/programs
+std::filesystem::path default_program_cache_directory();
+
+// Linked programs saved with glGetProgramBinary, one file per key. Binaries only load on
+// the driver that produced them, so keys cover the GL vendor, renderer and version along
+// with the shader sources. A driver may still reject a binary after an update, load()
+// then reports a miss and the caller links from source as usual.
+class ProgramCache {
+    public:
+        explicit ProgramCache(std::filesystem::path directory = default_program_cache_directory());
+
+        // Key for these sources on the driver of the current context
+        static uint64_t key(std::string_view vs_source, std::string_view fs_source);
+
+        // False when the driver offers no binary formats, load() and store() then do nothing
+        static bool supported();
+
+        // Loads the stored binary into `program`, true when it linked
+        bool load(GLuint program, uint64_t key) const;
+
+        // Saves the binary of the linked `program`, which must have been linked with
+        // GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+        void store(GLuint program, uint64_t key) const;
+
+        const std::filesystem::path& directory() const { return dir; }
+
+    private:
+        std::filesystem::path dir;
+
+        std::filesystem::path entry_path(uint64_t key) const;
+};
+
+#endif
@@ -1,11 +1,21 @@
 #include "renderer.h"
+#include "analysis.h"
+#include "hash.h"
+#include "mapped_file.h"
+#include "mesh_cache.h"
+#include "profiler.h"
+#include "program_cache.h"
+#include "scene.h"
+#include "streaming.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
-void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
-    glViewport(0, 0, width, height);
-}
-
 void Renderer::init() {
     if (!glfwInit()) {
         throw std::runtime_error("Failed to initialize GLFW");
@@ -21,6 +31,9 @@ void Renderer::create_main_window(int width, int height, std::string_view name)
     main_window.height = height;
     glfwMakeContextCurrent(main_window.handle);
     glfwSetFramebufferSizeCallback(main_window.handle, framebuffer_size_callback);
+    glfwSetWindowRefreshCallback(main_window.handle, window_refresh_callback);
+    glfwSetWindowUserPointer(main_window.handle, this);
+    glfwSetMouseButtonCallback(main_window.handle, mouse_button_callback);
 
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
         throw std::runtime_error("Failed to initialize GLAD");
@@ -33,22 +46,238 @@ void Renderer::handle_input(GLFWwindow* w) {
     }
 }
 
-Renderer::Renderer() {
+void Renderer::mouse_button_callback(GLFWwindow* window, int button, int action, int) {
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
+        Renderer* renderer = static_cast<Renderer*>(glfwGetWindowUserPointer(window));
+        glfwGetCursorPos(window, &renderer->pick_x, &renderer->pick_y);
+        renderer->pick_requested = true;
+        renderer->needs_redraw = true;
+    }
+}
+
+void Renderer::framebuffer_size_callback(GLFWwindow* window, int width, int height) {
+    glViewport(0, 0, width, height);
+    request_redraw(window);
+}
+
+void Renderer::window_refresh_callback(GLFWwindow* window) {
+    request_redraw(window);
+}
+
+void Renderer::request_redraw(GLFWwindow* window) {
+    static_cast<Renderer*>(glfwGetWindowUserPointer(window))->needs_redraw = true;
+}
+
+Renderer::Renderer(const RendererOptions& options) {
+    if (options.stl_paths.empty()) {
+        throw std::runtime_error("No STL files to view");
+    }
+    // Startup runs until the first frame is on screen, compare runs with a cold and a warm cache
+    const auto startup = std::chrono::steady_clock::now();
     init();
     create_main_window(800, 600, "STL Viewer");
+    glfwSwapInterval(options.vsync ? 1 : 0);
 
-    Shader s("src/shaders/shader.vert", "src/shaders/shader.frag");
+    Profiler profiler;
+    std::unique_ptr<ProgramCache> programs;
+    if (options.use_cache) {
+        programs = std::make_unique<ProgramCache>(options.cache_directory.empty()
+                                                      ? default_program_cache_directory()
+                                                      : options.cache_directory / "programs");
+    }
+    double shader_ms = 0.0;
+    Shader s = [&] {
+        ProfileScope scope(profiler, "shaders");
+        auto start = std::chrono::steady_clock::now();
+        Shader shader = Shader::embedded("shader.vert", options.lighting ? "lit.frag" : "shader.frag", programs.get());
+        shader_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return shader;
+    }();
+    const GLint color_location = s.location("color");
+    CameraUniforms camera;
 
-    auto cube = Mesh("TestCube.stl");
+    std::unique_ptr<MeshCache> cache;
+    MeshLoadOptions load_options;
+    load_options.lod_ratios = {0.5f, 0.25f, 0.1f, 0.02f};
+    load_options.normals = options.normals;
+    if (options.use_cache) {
+        cache = std::make_unique<MeshCache>(options.cache_directory.empty() ? default_cache_directory()
+                                                                            : options.cache_directory,
+                                            options.cache_max_bytes);
+        load_options.cache = cache.get();
+    }
+
+    // Streaming draws whatever has been decoded so far instead of blocking on the full load
+    Scene scene(load_options.layout, load_options.split_16bit);
+    std::vector<size_t> instance_input;     // index into options.stl_paths of each scene instance
+    std::unique_ptr<StreamingMesh> stream;
+    if (options.streaming) {
+        if (options.stl_paths.size() > 1) {
+            std::cerr << "Warning: streaming only loads the first of " << options.stl_paths.size() << " parts\n";
+        }
+        // Batches wake the loop from glfwWaitEvents, which is safe to call from any thread
+        stream = std::make_unique<StreamingMesh>(options.stl_paths.front(), load_options.layout, 1 << 16, [this] {
+            needs_redraw = true;
+            glfwPostEmptyEvent();
+        });
+    } else {
+        // Files with identical content load once and become one instance of one mesh, since
+        // every copy would draw the same pixels. The hash only finds candidates, a byte
+        // compare confirms them.
+        std::vector<std::filesystem::path> unique_paths;
+        std::vector<size_t> mesh_of(options.stl_paths.size());
+        std::map<std::filesystem::path, size_t> by_path;
+        std::unordered_map<uint64_t, std::vector<size_t>> by_content;
+        {
+            ProfileScope scope(profiler, "hash files");
+            for (size_t i = 0; i < options.stl_paths.size(); ++i) {
+                // Overlapping patterns can name one file twice, only the first needs reading
+                std::filesystem::path path = options.stl_paths[i].lexically_normal();
+                if (auto it = by_path.find(path); it != by_path.end()) {
+                    mesh_of[i] = it->second;
+                    continue;
+                }
+
+                MappedFile file(path);
+                uint64_t size = file.size();
+                uint64_t key = hash_bytes(&size, sizeof(size), hash_content(file.data(), file.size()));
+                std::vector<size_t>& candidates = by_content[key];
+                auto same = std::find_if(candidates.begin(), candidates.end(), [&](size_t mesh) {
+                    MappedFile other(unique_paths[mesh]);
+                    return other.size() == file.size()
+                           && (file.size() == 0 || std::memcmp(other.data(), file.data(), file.size()) == 0);
+                });
+                if (same != candidates.end()) {
+                    mesh_of[i] = *same;
+                } else {
+                    mesh_of[i] = unique_paths.size();
+                    candidates.push_back(unique_paths.size());
+                    unique_paths.push_back(path);
+                }
+                by_path.emplace(path, mesh_of[i]);
+            }
+        }
+
+        // Parsing, welding and simplification run across meshes in parallel, only the upload is serial
+        std::vector<PreparedMesh> prepared;
+        {
+            ProfileScope scope(profiler, "prepare meshes");
+            prepared = prepare_meshes(unique_paths, load_options);
+        }
+        // The scene copies the geometry into its arena and builds a BVH per mesh for picking
+        {
+            ProfileScope scope(profiler, "upload meshes");
+            for (const PreparedMesh& part_data : prepared) {
+                scene.add_mesh(part_data);
+            }
+        }
+
+        MeshStats totals;
+        double bvh_ms = 0.0;
+        for (size_t part = 0; part < prepared.size(); ++part) {
+            const PreparedMesh& part_data = prepared[part];
+            MeshStats stats = part_data.stats();
+            totals.loaded_triangles += stats.loaded_triangles;
+            totals.vertices_before_weld += stats.vertices_before_weld;
+            totals.vertices_after_weld += stats.vertices_after_weld;
+            if (options.stl_paths.size() == 1) {
+                const ArenaMesh& mesh = scene.mesh(part);
+                std::cout << "Loaded " << stats.loaded_triangles << " triangles, welded "
+                          << stats.vertices_before_weld << " -> " << stats.vertices_after_weld
+                          << " vertices, ACMR "
+                          << stats.cache_before.acmr << " -> " << stats.cache_after.acmr << ", ATVR "
+                          << stats.cache_before.atvr << " -> " << stats.cache_after.atvr << "\n";
+                for (size_t lod = 1; lod < mesh.lods.size(); ++lod) {
+                    std::cout << "LOD " << lod << ": " << mesh.triangle_count(lod) << " triangles, error "
+                              << mesh.lods[lod].error << "\n";
+                }
+            }
+            if (options.analyze) {
+                ProfileScope scope(profiler, "analyze");
+                print_analysis(std::cout, unique_paths[part],
+                               analyze_mesh(part_data.vertices(), part_data.indices(), load_options.threads));
+            }
+            if (const Bvh* bvh = scene.bvh(part)) {
+                bvh_ms += bvh->stats().build_ms;
+            }
+        }
+        // Picks name the first input behind each instance, not the instance index
+        for (size_t i = 0; i < mesh_of.size(); ++i) {
+            if (mesh_of[i] == instance_input.size()) {
+                instance_input.push_back(i);
+                scene.add_instance(mesh_of[i]);
+            }
+        }
+        if (options.stl_paths.size() > 1) {
+            std::cout << "Loaded " << options.stl_paths.size() << " parts (" << scene.mesh_count() << " unique, "
+                      << options.stl_paths.size() - scene.instance_count() << " identical copies skipped), "
+                      << totals.loaded_triangles << " unique triangles, welded " << totals.vertices_before_weld
+                      << " -> " << totals.vertices_after_weld << " vertices\n";
+        }
+        std::cout << "Built BVHs in " << bvh_ms << " ms\n";
+    }
 
     glEnable(GL_DEPTH_TEST);
+    SceneStats last_stats;
+    bool first_frame_shown = false;
+    bool stream_done = false;
+
+    const double frame_interval = options.max_fps > 0.0 ? 1.0 / options.max_fps : 0.0;
+    double next_frame = 0.0;
 
     while (!glfwWindowShouldClose(main_window.handle)) {
+        // Sleep until something changes. Occlusion results still in flight are polled at
+        // the frame rate and only cost a frame when they change what is visible.
+        if (options.continuous) {
+            needs_redraw = true;
+            glfwPollEvents();
+        } else if (needs_redraw) {
+            glfwPollEvents();
+        } else if (scene.queries_pending()) {
+            glfwWaitEventsTimeout(std::max(frame_interval, 0.001));
+            if (scene.poll_queries()) {
+                needs_redraw = true;
+            }
+        } else {
+            glfwWaitEvents();
+        }
 
+        double input_start = profiler.now_us();
         handle_input(main_window.handle);
+        double input_us = profiler.now_us() - input_start;
+        if (!needs_redraw || glfwWindowShouldClose(main_window.handle)) {
+            continue;
+        }
+
+        // Hold redraws to the cap, events arriving meanwhile still wake the wait
+        double now = glfwGetTime();
+        if (now < next_frame) {
+            glfwWaitEventsTimeout(next_frame - now);
+            continue;
+        }
+        next_frame = now + frame_interval;
+        needs_redraw = false;
+
+        // Idle iterations don't count as frames, so the GPU query ring only turns on real ones
+        profiler.begin_frame();
+        profiler.record("input", input_start, input_us);
+        if (stream && !stream_done) {
+            ProfileScope scope(profiler, "stream upload");
+            // Uploads are capped per frame, so anything that arrived may have more behind it.
+            // A decode failure is rethrown here and ends the viewer like a failed load.
+            if (stream->upload_ready()) {
+                needs_redraw = true;
+            }
+            if (stream->finished()) {
+                std::cout << "Streamed " << stream->uploaded_triangles() << " triangles\n";
+                stream_done = true;
+            }
+        }
 
+        profiler.gpu_begin("clear");
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        profiler.gpu_end();
 
         s.use();
         glm::mat4 model = glm::mat4(1.0f);
@@ -57,13 +286,94 @@ Renderer::Renderer() {
         view = glm::translate(view, glm::vec3(0.0, 0.0, -60.0));
         glm::mat4 projection;
         projection = glm::perspective(glm::radians(45.0f), 800.0f/600.0f, 0.1f, 200.0f); // Careful with aspect ratio
-        s.set_mat4("model", model);
-        s.set_mat4("view", view);
-        s.set_mat4("projection", projection);
-        cube.draw();
 
-        glfwSwapBuffers(main_window.handle);
-        glfwPollEvents();
+        if (pick_requested && scene.instance_count() > 0) {
+            ProfileScope scope(profiler, "pick");
+            pick_requested = false;
+            int width, height;
+            glfwGetWindowSize(main_window.handle, &width, &height);
+            glm::vec4 viewport(0.0f, 0.0f, width, height);
+            // Unprojecting with view * model puts the ray in scene space
+            glm::vec3 window_pos(pick_x, height - pick_y, 0.0f);
+            glm::vec3 near_point = glm::unProject(window_pos, view * model, projection, viewport);
+            window_pos.z = 1.0f;
+            glm::vec3 far_point = glm::unProject(window_pos, view * model, projection, viewport);
+
+            auto start = std::chrono::steady_clock::now();
+            auto hit = scene.pick(near_point, far_point - near_point, 0.0f, 1.0f);
+            double query_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+            std::string title = "STL Viewer";
+            if (hit) {
+                glm::vec3 world = glm::vec3(model * glm::vec4(hit->point, 1.0f));
+                size_t part = instance_input[hit->mesh];
+                std::cout << "Picked triangle " << hit->triangle << " of part " << part << " ("
+                          << options.stl_paths[part].string() << ") at (" << world.x << ", " << world.y << ", "
+                          << world.z << ") in " << query_us << " us\n";
+                title += " - part " + std::to_string(part) + " triangle " + std::to_string(hit->triangle)
+                         + " at (" + std::to_string(world.x) + ", " + std::to_string(world.y) + ", "
+                         + std::to_string(world.z) + ")";
+            } else {
+                std::cout << "Picked nothing in " << query_us << " us\n";
+            }
+            glfwSetWindowTitle(main_window.handle, title.c_str());
+        }
+
+        // The global rotation is folded into the view so each part's transform is its model matrix
+        {
+            ProfileScope scope(profiler, "uniforms");
+            profiler.gpu_begin("uniforms");
+            camera.update(view * model, projection);
+            s.set_vec3(color_location, 0.3f, 0.5f, 0.4f);
+            profiler.gpu_end();
+        }
+        {
+            ProfileScope scope(profiler, "culling");
+            scene.cull(view * model, projection);
+        }
+        {
+            ProfileScope scope(profiler, "draws");
+            profiler.gpu_begin("draws");
+            scene.submit();
+            if (stream) {
+                set_model_matrix(glm::mat4(1.0f));
+                stream->draw();
+            }
+            profiler.gpu_end();
+        }
+        if (options.profile_overlay) {
+            int width, height;
+            glfwGetFramebufferSize(main_window.handle, &width, &height);
+            profiler.draw_overlay(width, height);
+        }
+        // Occlusion results flip these often, so they are only printed while profiling
+        if (options.profile_overlay && scene.instance_count() > 0 && scene.stats() != last_stats) {
+            last_stats = scene.stats();
+            std::cout << "Drew " << last_stats.drawn << " of " << last_stats.meshes << " parts ("
+                      << last_stats.frustum_culled << " outside the frustum, " << last_stats.occlusion_culled
+                      << " occluded, " << last_stats.simplified << " simplified), " << last_stats.triangles_drawn
+                      << " of " << last_stats.triangles << " triangles in " << last_stats.draw_calls
+                      << " draw calls\n";
+        }
+
+        {
+            ProfileScope scope(profiler, "swap");
+            glfwSwapBuffers(main_window.handle);
+        }
+        profiler.end_frame();
+
+        if (!first_frame_shown) {
+            first_frame_shown = true;
+            std::cout << "First frame after "
+                      << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startup).count()
+                      << " ms, shaders took " << shader_ms << " ms ("
+                      << (s.from_cache ? "program cache" : "compiled") << ")\n";
+        }
+    }
+
+    if (!options.trace_path.empty()) {
+        profiler.write_chrome_trace(options.trace_path);
+        std::cout << "Wrote trace to " << options.trace_path << "\n";
     }
 }
 
@@ -1,7 +1,11 @@
 #ifndef RENDERER_H
 #define RENDERER_H
 
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
 #include <string>
+#include <vector>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "util.h"
@@ -13,17 +17,46 @@ struct Window {
 
 };
 
+struct RendererOptions {
+    std::vector<std::filesystem::path> stl_paths;       // parts of one assembly, at least one
+    std::filesystem::path cache_directory;              // empty uses default_cache_directory()
+    uint64_t cache_max_bytes = uint64_t(4) << 30;
+    bool use_cache = true;
+    bool streaming = false;     // progressive load of the first part, draws batches as they are decoded
+    bool vsync = true;
+    double max_fps = 60.0;      // cap on redraws, 0 for none
+    bool continuous = false;    // redraw every frame instead of only when something changed
+    bool lighting = true;       // lit.frag, or the flat shader.frag
+    NormalMode normals = NormalMode::Smooth;    // File keeps the STL's facet normals
+    bool analyze = false;       // print watertightness, area and volume of every unique part after loading
+    bool profile_overlay = false;   // CPU and GPU stage timings as bars along the bottom, culling stats printed on change
+    std::filesystem::path trace_path;   // Chrome trace of the load and every frame, written on exit
+};
+
 class Renderer {
 private:
     Window main_window;
 
+    // Left click position waiting to be picked on the next frame
+    bool pick_requested = false;
+    double pick_x = 0.0, pick_y = 0.0;
+
+    // Set by input, resize and streaming progress, the loop sleeps while it is clear.
+    // Atomic since the streaming thread sets it too.
+    std::atomic<bool> needs_redraw{true};
+
 private:
     void init();
     void create_main_window(int width, int height, std::string_view name);
     void handle_input(GLFWwindow* w);
+
+    static void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+    static void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+    static void window_refresh_callback(GLFWwindow* window);
+    static void request_redraw(GLFWwindow* window);
     
 public:
-    Renderer();
+    Renderer(const RendererOptions& options = {});
 
     ~Renderer();
 
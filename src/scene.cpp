@@ -0,0 +1,387 @@
+#include "scene.h"
+#include <algorithm>
+#include <limits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Gribb/Hartmann planes from the rows of projection * view, pointing inward
+void extract_planes(const glm::mat4& m, glm::vec4 planes[6]) {
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; ++i) {
+        row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+    }
+    planes[0] = row[3] + row[0];
+    planes[1] = row[3] - row[0];
+    planes[2] = row[3] + row[1];
+    planes[3] = row[3] - row[1];
+    planes[4] = row[3] + row[2];
+    planes[5] = row[3] - row[2];
+}
+
+// A box is outside when its corner furthest along a plane's normal is still behind it
+void frustum_test(const glm::vec4 planes[6], const float* min_x, const float* min_y, const float* min_z,
+                  const float* max_x, const float* max_y, const float* max_z, size_t count, uint8_t* out) {
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + 4 <= count; i += 4) {
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p) {
+            const glm::vec4& plane = planes[p];
+            __m128 x = _mm_loadu_ps((plane.x > 0.0f ? max_x : min_x) + i);
+            __m128 y = _mm_loadu_ps((plane.y > 0.0f ? max_y : min_y) + i);
+            __m128 z = _mm_loadu_ps((plane.z > 0.0f ? max_z : min_z) + i);
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+                                  _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_setzero_ps()));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (int k = 0; k < 4; ++k) {
+            out[i + k] = (mask >> k) & 1;
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; ++p) {
+            const glm::vec4& plane = planes[p];
+            float x = plane.x > 0.0f ? max_x[i] : min_x[i];
+            float y = plane.y > 0.0f ? max_y[i] : min_y[i];
+            float z = plane.z > 0.0f ? max_z[i] : min_z[i];
+            inside = plane.x * x + plane.y * y + plane.z * z + plane.w >= 0.0f;
+        }
+        out[i] = inside;
+    }
+}
+
+Bounds transform_bounds(const Bounds& local, const glm::mat4& transform) {
+    Bounds world{glm::vec3(std::numeric_limits<float>::max()), glm::vec3(-std::numeric_limits<float>::max())};
+    for (int c = 0; c < 8; ++c) {
+        glm::vec3 corner((c & 1) ? local.max.x : local.min.x, (c & 2) ? local.max.y : local.min.y,
+                         (c & 4) ? local.max.z : local.min.z);
+        glm::vec3 p = glm::vec3(transform * glm::vec4(corner, 1.0f));
+        world.min = glm::min(world.min, p);
+        world.max = glm::max(world.max, p);
+    }
+    return world;
+}
+
+// Corners of the unit cube as a mesh of the arena's format
+GpuMeshData make_unit_box(VertexLayout layout, bool split_16bit) {
+    std::vector<Vertex> vertices;
+    for (int c = 0; c < 8; ++c) {
+        vertices.push_back({glm::vec3(c & 1, (c >> 1) & 1, (c >> 2) & 1), glm::vec3(0.0f)});
+    }
+    std::vector<unsigned int> indices = {
+        0, 2, 1, 1, 2, 3,   4, 5, 6, 5, 7, 6,   0, 1, 4, 1, 5, 4,
+        2, 6, 3, 3, 6, 7,   0, 4, 2, 2, 4, 6,   1, 3, 5, 3, 7, 5,
+    };
+    return build_gpu_mesh(vertices, indices, layout, split_16bit);
+}
+
+InstanceData instance_data_for(const ArenaMesh& mesh, const glm::mat4& model) {
+    return {model, glm::vec4(position_offset(mesh.layout, mesh.bounds), 0.0f),
+            glm::vec4(position_scale(mesh.layout, mesh.bounds), 0.0f)};
+}
+
+}
+
+Scene::Scene(VertexLayout layout, bool split_16bit) : arena(layout, split_16bit ? 2 : 4), split_16bit(split_16bit) {
+}
+
+Scene::~Scene() {
+    for (Instance& instance : instances) {
+        if (instance.query) {
+            glDeleteQueries(1, &instance.query);
+        }
+    }
+    if (instance_buffer) {
+        glDeleteBuffers(1, &instance_buffer);
+    }
+    if (command_buffer) {
+        glDeleteBuffers(1, &command_buffer);
+    }
+}
+
+size_t Scene::add_mesh(const PreparedMesh& mesh) {
+    Part part{arena.add(mesh.gpu_view()), nullptr};
+    if (!mesh.indices().empty()) {
+        part.bvh = std::make_unique<Bvh>(mesh.vertices(), mesh.indices());
+    }
+    parts.push_back(std::move(part));
+    return parts.size() - 1;
+}
+
+size_t Scene::add_instance(size_t mesh, const glm::mat4& transform) {
+    Instance instance{mesh, transform};
+    glGenQueries(1, &instance.query);
+
+    Bounds world = transform_bounds(this->mesh(mesh).bounds, transform);
+    min_x.push_back(world.min.x);
+    min_y.push_back(world.min.y);
+    min_z.push_back(world.min.z);
+    max_x.push_back(world.max.x);
+    max_y.push_back(world.max.y);
+    max_z.push_back(world.max.z);
+
+    instances.push_back(instance);
+    return instances.size() - 1;
+}
+
+Bounds Scene::bounds() const {
+    if (instances.empty()) {
+        return Bounds{glm::vec3(0.0f), glm::vec3(0.0f)};
+    }
+    Bounds result{glm::vec3(std::numeric_limits<float>::max()), glm::vec3(-std::numeric_limits<float>::max())};
+    for (size_t i = 0; i < instances.size(); ++i) {
+        result.min = glm::min(result.min, glm::vec3(min_x[i], min_y[i], min_z[i]));
+        result.max = glm::max(result.max, glm::vec3(max_x[i], max_y[i], max_z[i]));
+    }
+    return result;
+}
+
+size_t Scene::select_lod(size_t index, glm::vec3 eye, float pixels_per_unit) const {
+    const Instance& instance = instances[index];
+    const ArenaMesh& mesh = this->mesh(instance.part);
+    // Nearest point of the world box, so an instance never looks coarser than its closest corner
+    glm::vec3 nearest = glm::clamp(eye, glm::vec3(min_x[index], min_y[index], min_z[index]),
+                                   glm::vec3(max_x[index], max_y[index], max_z[index]));
+    float distance = glm::length(nearest - eye);
+    if (distance <= 0.0f) {
+        return 0;
+    }
+    float scale = std::max({glm::length(glm::vec3(instance.transform[0])),
+                            glm::length(glm::vec3(instance.transform[1])),
+                            glm::length(glm::vec3(instance.transform[2]))});
+    for (size_t lod = mesh.lods.size(); lod-- > 1;) {
+        if (mesh.lods[lod].error * scale * pixels_per_unit / distance <= max_screen_error) {
+            return lod;
+        }
+    }
+    return 0;
+}
+
+void Scene::draw(const glm::mat4& view, const glm::mat4& projection) {
+    cull(view, projection);
+    submit();
+}
+
+void Scene::cull(const glm::mat4& view, const glm::mat4& projection) {
+    frame_stats = SceneStats();
+    frame_stats.meshes = instances.size();
+    frame_stats.unique_meshes = parts.size();
+    for (const Instance& instance : instances) {
+        frame_stats.triangles += mesh(instance.part).triangle_count();
+    }
+
+    glm::vec4 planes[6];
+    extract_planes(projection * view, planes);
+    in_frustum.resize(instances.size());
+    frustum_test(planes, min_x.data(), min_y.data(), min_z.data(), max_x.data(), max_y.data(), max_z.data(),
+                 instances.size(), in_frustum.data());
+
+    glm::vec3 eye = glm::vec3(glm::inverse(view)[3]);
+
+    // Pixels covered by one unit of length at distance 1
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    float pixels_per_unit = projection[1][1] * static_cast<float>(viewport[3]) * 0.5f;
+
+    // Instances keep their last answer until the GPU has the new one
+    if (occlusion_culling) {
+        poll_queries();
+    }
+
+    batch.clear();
+    proxies.clear();
+    for (size_t i = 0; i < instances.size(); ++i) {
+        Instance& instance = instances[i];
+        if (!in_frustum[i]) {
+            ++frame_stats.frustum_culled;
+            continue;
+        }
+        if (occlusion_culling) {
+            // The proxy box is clipped away when the camera is inside it
+            bool eye_inside = eye.x >= min_x[i] && eye.x <= max_x[i] && eye.y >= min_y[i] && eye.y <= max_y[i]
+                              && eye.z >= min_z[i] && eye.z <= max_z[i];
+            if (eye_inside) {
+                instance.occluded = false;
+            }
+            if (instance.occluded) {
+                ++frame_stats.occlusion_culled;
+                if (!instance.query_pending && proxies.size() < occlusion_queries) {
+                    proxies.push_back(i);
+                }
+                continue;
+            }
+        } else {
+            instance.occluded = false;
+        }
+
+        size_t lod = select_lod(i, eye, pixels_per_unit);
+        batch.push_back({(uint64_t(instance.part) << 8) | lod, i});
+        ++frame_stats.drawn;
+        frame_stats.simplified += lod > 0;
+        frame_stats.triangles_drawn += mesh(instance.part).triangle_count(lod);
+    }
+
+    // Visible instances are rechecked round robin with whatever query budget is left
+    if (occlusion_culling && !instances.empty()) {
+        size_t hidden_proxies = proxies.size();
+        for (size_t n = 0; n < instances.size() && proxies.size() < occlusion_queries; ++n) {
+            size_t i = (query_cursor + n) % instances.size();
+            if (in_frustum[i] && !instances[i].occluded && !instances[i].query_pending) {
+                proxies.push_back(i);
+            }
+        }
+        if (proxies.size() > hidden_proxies) {
+            query_cursor = (proxies.back() + 1) % instances.size();
+        }
+    }
+
+    // Proxies test against the box mesh, which has to be in the arena before its commands are built
+    if (!proxies.empty() && !box) {
+        box = arena.add(make_unit_box(arena.vertex_layout(), split_16bit).view());
+    }
+
+    // Commands for every group of one part and LOD, reading consecutive InstanceData, then
+    // one command per proxy box. Both buffers are filled in one pass.
+    std::sort(batch.begin(), batch.end());
+    instance_data.clear();
+    commands.clear();
+    for (size_t b = 0; b < batch.size();) {
+        size_t first = b;
+        size_t part = instances[batch[b].second].part;
+        const ArenaMesh& group_mesh = mesh(part);
+        for (; b < batch.size() && batch[b].first == batch[first].first; ++b) {
+            instance_data.push_back(instance_data_for(group_mesh, instances[batch[b].second].transform));
+        }
+        const LodRange& range = group_mesh.lods[batch[first].first & 0xff];
+        for (unsigned int s = 0; s < range.submesh_count; ++s) {
+            DrawElementsIndirectCommand command = group_mesh.submeshes[range.first_submesh + s];
+            command.instance_count = static_cast<GLuint>(b - first);
+            command.base_instance = static_cast<GLuint>(first);
+            commands.push_back(command);
+        }
+    }
+    for (size_t i : proxies) {
+        // Padded so flat parts still cover pixels
+        const ArenaMesh& box_mesh = arena.mesh(*box);
+        const Bounds& local = mesh(instances[i].part).bounds;
+        glm::vec3 extent = local.extent();
+        glm::vec3 pad = glm::vec3(std::max({extent.x, extent.y, extent.z}) * 0.01f + 1e-5f);
+        glm::mat4 model = glm::translate(instances[i].transform, local.min - pad);
+        DrawElementsIndirectCommand command = box_mesh.submeshes.front();
+        command.instance_count = 1;
+        command.base_instance = static_cast<GLuint>(instance_data.size());
+        commands.push_back(command);
+        instance_data.push_back(instance_data_for(box_mesh, glm::scale(model, extent + pad * 2.0f)));
+    }
+    group_commands = commands.size() - proxies.size();
+}
+
+void Scene::submit() {
+    if (commands.empty()) {
+        return;
+    }
+
+    if (!instance_buffer) {
+        glGenBuffers(1, &instance_buffer);
+        glGenBuffers(1, &command_buffer);
+    }
+    // Orphan last frame's storage rather than wait for draws still reading it
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+    glBufferData(GL_ARRAY_BUFFER, instance_data.size() * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instance_data.size() * sizeof(InstanceData), instance_data.data());
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), nullptr,
+                 GL_STREAM_DRAW);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand),
+                    commands.data());
+
+    arena.bind(instance_buffer);
+    frame_stats.draw_calls += arena.draw_indirect(0, group_commands);
+
+    if (!proxies.empty()) {
+        // Proxies test against the finished depth buffer without writing to it
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+        for (size_t k = 0; k < proxies.size(); ++k) {
+            Instance& instance = instances[proxies[k]];
+            glBeginQuery(GL_ANY_SAMPLES_PASSED, instance.query);
+            frame_stats.draw_calls +=
+                arena.draw_indirect((group_commands + k) * sizeof(DrawElementsIndirectCommand), 1);
+            glEndQuery(GL_ANY_SAMPLES_PASSED);
+            instance.query_pending = true;
+        }
+        glDepthMask(GL_TRUE);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+bool Scene::poll_queries() {
+    bool changed = false;
+    for (Instance& instance : instances) {
+        if (!instance.query_pending) {
+            continue;
+        }
+        GLuint available = 0;
+        glGetQueryObjectuiv(instance.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            continue;
+        }
+        GLuint samples = 0;
+        glGetQueryObjectuiv(instance.query, GL_QUERY_RESULT, &samples);
+        changed |= instance.occluded != (samples == 0);
+        instance.occluded = samples == 0;
+        instance.query_pending = false;
+    }
+    return changed;
+}
+
+bool Scene::queries_pending() const {
+    return std::any_of(instances.begin(), instances.end(), [](const Instance& instance) {
+        return instance.query_pending;
+    });
+}
+
+std::optional<ScenePick> Scene::pick(glm::vec3 origin, glm::vec3 direction, float t_min, float t_max) const {
+    std::optional<ScenePick> best;
+    float closest = t_max;
+    for (size_t i = 0; i < instances.size(); ++i) {
+        const Instance& instance = instances[i];
+        const Bvh* bvh = parts[instance.part].bvh.get();
+        if (!bvh) {
+            continue;
+        }
+        // Slab test on the world box before transforming the ray into the mesh
+        float t0 = t_min, t1 = closest;
+        glm::vec3 lo(min_x[i], min_y[i], min_z[i]), hi(max_x[i], max_y[i], max_z[i]);
+        for (int a = 0; a < 3; ++a) {
+            float inv = 1.0f / direction[a];
+            float near_t = (lo[a] - origin[a]) * inv;
+            float far_t = (hi[a] - origin[a]) * inv;
+            t0 = std::max(t0, std::min(near_t, far_t));
+            t1 = std::min(t1, std::max(near_t, far_t));
+        }
+        if (t0 > t1) {
+            continue;
+        }
+
+        // An affine transform keeps t the same along the ray
+        glm::mat4 inverse = glm::inverse(instance.transform);
+        glm::vec3 local_origin = glm::vec3(inverse * glm::vec4(origin, 1.0f));
+        glm::vec3 local_direction = glm::vec3(inverse * glm::vec4(direction, 0.0f));
+        if (auto hit = bvh->intersect(local_origin, local_direction, t_min, closest)) {
+            closest = hit->t;
+            best = ScenePick{i, hit->triangle, hit->t, glm::vec3(instance.transform * glm::vec4(hit->point, 1.0f))};
+        }
+    }
+    return best;
+}
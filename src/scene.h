@@ -0,0 +1,135 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <glm/glm.hpp>
+#include "arena.h"
+#include "bvh.h"
+#include "util.h"
+
+// Counts for the last draw(), instances and triangles as submitted vs. culled
+struct SceneStats {
+    size_t meshes = 0;          // instances in the scene
+    size_t unique_meshes = 0;
+    size_t frustum_culled = 0;
+    size_t occlusion_culled = 0;
+    size_t drawn = 0;
+    size_t simplified = 0;      // drawn at a coarser LOD than the full mesh
+    size_t triangles = 0;
+    size_t triangles_drawn = 0;
+    size_t draw_calls = 0;      // indirect draws plus occlusion proxies
+
+    bool operator==(const SceneStats&) const = default;
+};
+
+struct ScenePick {
+    size_t mesh;        // instance index
+    uint32_t triangle;
+    float t;
+    glm::vec3 point;    // in scene space
+};
+
+// Unique meshes placed by any number of instance transforms, culled per frame before
+// drawing. Instance boxes are kept as a structure of arrays and tested against the
+// frustum four at a time. All geometry lives in one MeshArena, so after culling the
+// surviving instances, grouped by mesh and LOD, become indirect commands reading
+// InstanceData through baseInstance, and the whole visible set is a single
+// glMultiDrawElementsIndirect. Each instance uses its mesh's coarsest LOD whose error,
+// projected at the instance's distance, stays under max_screen_error pixels.
+//
+// Occlusion uses GL_ANY_SAMPLES_PASSED queries on bounding box proxies against the
+// finished depth buffer, read back a frame or more later. Up to occlusion_queries
+// proxies are issued per frame, hidden instances first, so drawing stays batched.
+class Scene {
+    public:
+        bool occlusion_culling = true;
+        float max_screen_error = 1.0f;
+        size_t occlusion_queries = 64;
+
+        // Meshes added must all be built with this layout and index split. Without the split
+        // the arena holds 32 bit indices and widens small meshes' 16 bit ones.
+        explicit Scene(VertexLayout layout = VertexLayout::PositionNormal, bool split_16bit = true);
+
+        ~Scene();
+
+        Scene(const Scene&) = delete;
+        Scene& operator=(const Scene&) = delete;
+
+        // Copies the mesh's GPU buffers into the arena and builds its BVH from the CPU data
+        size_t add_mesh(const PreparedMesh& mesh);
+
+        size_t add_instance(size_t mesh, const glm::mat4& transform = glm::mat4(1.0f));
+
+        // Culls against view/projection, which the Camera block should hold as well. Models
+        // come from the instance buffer.
+        void draw(const glm::mat4& view, const glm::mat4& projection);
+
+        // The two halves of draw(): building the frame's instance data and commands on the
+        // CPU, then uploading and drawing them
+        void cull(const glm::mat4& view, const glm::mat4& projection);
+
+        void submit();
+
+        // Reads back finished occlusion queries. Returns true when an instance changed
+        // between hidden and visible, which is worth another frame.
+        bool poll_queries();
+
+        bool queries_pending() const;
+
+        // Closest hit over every instance whose mesh has a BVH, for origin + t * direction
+        std::optional<ScenePick> pick(glm::vec3 origin, glm::vec3 direction, float t_min = 0.0f,
+                                      float t_max = 3.402823466e+38f) const;
+
+        size_t mesh_count() const { return parts.size(); }
+
+        size_t instance_count() const { return instances.size(); }
+
+        const ArenaMesh& mesh(size_t index) const { return arena.mesh(parts[index].mesh); }
+
+        const Bvh* bvh(size_t index) const { return parts[index].bvh.get(); }
+
+        Bounds bounds() const;
+
+        const SceneStats& stats() const { return frame_stats; }
+
+    private:
+        struct Part {
+            size_t mesh;        // in the arena
+            std::unique_ptr<Bvh> bvh;
+        };
+
+        struct Instance {
+            size_t part;
+            glm::mat4 transform;
+            GLuint query = 0;
+            bool query_pending = false;
+            bool occluded = false;
+        };
+
+        MeshArena arena;
+        bool split_16bit;
+        std::vector<Part> parts;
+        std::vector<Instance> instances;
+        std::vector<float> min_x, min_y, min_z, max_x, max_y, max_z;
+        std::vector<uint8_t> in_frustum;
+
+        // Per frame scratch
+        std::vector<std::pair<uint64_t, size_t>> batch;     // (part << 8 | lod, instance)
+        std::vector<size_t> proxies;
+        std::vector<InstanceData> instance_data;
+        std::vector<DrawElementsIndirectCommand> commands;     // groups, then one per proxy
+        size_t group_commands = 0;
+        size_t query_cursor = 0;
+
+        GLuint instance_buffer = 0;
+        GLuint command_buffer = 0;
+        std::optional<size_t> box;      // arena mesh of the unit cube drawn as the occlusion proxy
+        SceneStats frame_stats;
+
+        size_t select_lod(size_t instance, glm::vec3 eye, float pixels_per_unit) const;
+};
+
+#endif
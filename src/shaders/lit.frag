@@ -0,0 +1,21 @@
+#version 330 core
+in vec3 o_normal;
+out vec4 FragColor;
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+};
+
+uniform vec3 color;
+
+// Headlight: a key light and highlight from the camera, plus a sky/ground fill so faces
+// turned away still read. SoftwareRasterizer mirrors this per pixel.
+void main() {
+    vec3 n = normalize(mat3(view) * o_normal);
+    n = gl_FrontFacing ? n : -n;
+    float key = max(n.z, 0.0);
+    float fill = 0.5 + 0.5 * n.y;
+    float highlight = pow(key, 32.0);
+    FragColor = vec4(color * (0.2 + 0.15 * fill + 0.65 * key) + vec3(0.15 * highlight), 1.0);
+}
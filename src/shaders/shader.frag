@@ -1,7 +1,9 @@
 #version 330 core
-in vec3 o_color;
+in vec3 o_normal;
 out vec4 FragColor;
 
+uniform vec3 color;
+
 void main() {
-    FragColor = vec4(o_color, 1.0);
+    FragColor = vec4(color, 1.0);
 }
\ No newline at end of file
@@ -1,14 +1,31 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aColor;
+layout (location = 1) in vec2 aNormal;
+// InstanceData: per instance from an instance buffer, or constant attribute values for
+// single draws. The offset and scale are identity for float layouts and the mesh bounds
+// for 16 bit quantized positions.
+layout (location = 3) in mat4 model;
+layout (location = 7) in vec3 position_offset;
+layout (location = 8) in vec3 position_scale;
 
-out vec3 o_color;
+out vec3 o_normal;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Shared by every program, bound to CAMERA_BINDING
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+};
+
+vec3 decode_octahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
 
 void main() {
-    o_color = aColor;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    vec3 position = aPos * position_scale + position_offset;
+    o_normal = mat3(model) * decode_octahedral(aNormal);
+    gl_Position = projection * view * model * vec4(position, 1.0);
+}
@@ -0,0 +1,363 @@
+#include "simplify.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+namespace {
+
+// Sum of squared distances to a set of weighted planes, as (p^T A p + 2 b.p + c)
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+    double b0 = 0, b1 = 0, b2 = 0;
+    double c = 0;
+    double weight = 0;
+
+    static Quadric plane(glm::vec3 normal, double d, double w) {
+        double n[3] = {normal.x, normal.y, normal.z};
+        Quadric q;
+        q.a00 = w * n[0] * n[0]; q.a01 = w * n[0] * n[1]; q.a02 = w * n[0] * n[2];
+        q.a11 = w * n[1] * n[1]; q.a12 = w * n[1] * n[2]; q.a22 = w * n[2] * n[2];
+        q.b0 = w * d * n[0]; q.b1 = w * d * n[1]; q.b2 = w * d * n[2];
+        q.c = w * d * d;
+        q.weight = w;
+        return q;
+    }
+
+    Quadric& operator+=(const Quadric& o) {
+        a00 += o.a00; a01 += o.a01; a02 += o.a02; a11 += o.a11; a12 += o.a12; a22 += o.a22;
+        b0 += o.b0; b1 += o.b1; b2 += o.b2;
+        c += o.c;
+        weight += o.weight;
+        return *this;
+    }
+
+    double evaluate(glm::vec3 point) const {
+        double x = point.x, y = point.y, z = point.z;
+        double e = a00 * x * x + a11 * y * y + a22 * z * z
+                 + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+                 + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        return std::max(e, 0.0);
+    }
+};
+
+// Borders are weighted up so the outline of an open mesh holds its shape
+constexpr double BORDER_WEIGHT = 10.0;
+
+uint64_t edge_key(unsigned int a, unsigned int b) {
+    return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+
+struct Collapse {
+    double cost;
+    unsigned int from, to;
+};
+
+class Simplifier {
+    public:
+        Simplifier(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+            : positions(vertices.size()), quadrics(vertices.size()), remap(vertices.size()), indices(indices),
+              stamp(vertices.size(), 0) {
+            for (size_t v = 0; v < vertices.size(); ++v) {
+                positions[v] = vertices[v].position;
+                remap[v] = static_cast<unsigned int>(v);
+            }
+            seed_quadrics();
+        }
+
+        // Collapses until at most target triangles remain, false when it got stuck first
+        bool reduce_to(size_t target_triangles) {
+            while (indices.size() / 3 > target_triangles) {
+                if (!pass(indices.size() / 3 - target_triangles)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        const std::vector<unsigned int>& current() const { return indices; }
+
+        float error() const { return static_cast<float>(max_error); }
+
+    private:
+        std::vector<glm::vec3> positions;
+        std::vector<Quadric> quadrics;
+        std::vector<unsigned int> remap;
+        std::vector<unsigned int> indices;
+        std::vector<unsigned int> stamp;    // per vertex marks for link checks
+        unsigned int stamp_value = 0;
+        double max_error = 0.0;
+
+        // Face planes weighted by area, plus a perpendicular plane along every border edge
+        void seed_quadrics() {
+            struct EdgeRef {
+                uint64_t key;
+                size_t triangle;
+                int corner;
+            };
+            std::vector<EdgeRef> edges;
+            edges.reserve(indices.size());
+
+            for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+                glm::vec3 p0 = positions[indices[t]], p1 = positions[indices[t + 1]], p2 = positions[indices[t + 2]];
+                glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+                float length = glm::length(n);
+                if (length > 0.0f) {
+                    n /= length;
+                    Quadric q = Quadric::plane(n, -glm::dot(n, p0), length * 0.5);
+                    for (int c = 0; c < 3; ++c) {
+                        quadrics[indices[t + c]] += q;
+                    }
+                }
+                for (int c = 0; c < 3; ++c) {
+                    edges.push_back({edge_key(indices[t + c], indices[t + (c + 1) % 3]), t, c});
+                }
+            }
+
+            std::sort(edges.begin(), edges.end(), [](const EdgeRef& a, const EdgeRef& b) { return a.key < b.key; });
+            for (size_t i = 0; i < edges.size(); ++i) {
+                bool shared = (i > 0 && edges[i - 1].key == edges[i].key)
+                              || (i + 1 < edges.size() && edges[i + 1].key == edges[i].key);
+                if (shared) {
+                    continue;
+                }
+                size_t t = edges[i].triangle;
+                unsigned int a = indices[t + edges[i].corner], b = indices[t + (edges[i].corner + 1) % 3];
+                glm::vec3 p0 = positions[indices[t]], p1 = positions[indices[t + 1]], p2 = positions[indices[t + 2]];
+                glm::vec3 face = glm::cross(p1 - p0, p2 - p0);
+                glm::vec3 edge = positions[b] - positions[a];
+                glm::vec3 n = glm::cross(edge, face);
+                float length = glm::length(n);
+                if (length > 0.0f) {
+                    n /= length;
+                    Quadric q = Quadric::plane(n, -glm::dot(n, positions[a]), glm::dot(edge, edge) * BORDER_WEIGHT);
+                    quadrics[a] += q;
+                    quadrics[b] += q;
+                }
+            }
+        }
+
+        // Moving `from` onto `to` must not fold any surviving triangle around `from`
+        bool flips(unsigned int from, unsigned int to, const unsigned int* ring, size_t ring_size) const {
+            for (size_t r = 0; r < ring_size; ++r) {
+                size_t t = ring[r];
+                unsigned int v[3] = {remap[indices[t]], remap[indices[t + 1]], remap[indices[t + 2]]};
+                if (v[0] == to || v[1] == to || v[2] == to) {
+                    continue;   // collapses away with the edge
+                }
+                glm::vec3 p[3], q[3];
+                for (int c = 0; c < 3; ++c) {
+                    p[c] = positions[v[c]];
+                    q[c] = v[c] == from ? positions[to] : p[c];
+                }
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                if (glm::dot(before, after) <= 0.0f) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Link condition: the two ends may only share the neighbours opposite the edge, or
+        // the collapse pinches the surface into a non-manifold fold
+        bool pinches(unsigned int from, unsigned int to, const unsigned int* from_ring, size_t from_ring_size,
+                     const unsigned int* to_ring, size_t to_ring_size) {
+            ++stamp_value;
+            size_t opposite = 0;
+            for (size_t r = 0; r < from_ring_size; ++r) {
+                size_t t = from_ring[r];
+                bool has_to = false;
+                for (int k = 0; k < 3; ++k) {
+                    unsigned int v = remap[indices[t + k]];
+                    has_to |= v == to;
+                    if (v != from && v != to) {
+                        stamp[v] = stamp_value;
+                    }
+                }
+                opposite += has_to;
+            }
+
+            ++stamp_value;
+            size_t shared = 0;
+            for (size_t r = 0; r < to_ring_size; ++r) {
+                size_t t = to_ring[r];
+                for (int k = 0; k < 3; ++k) {
+                    unsigned int v = remap[indices[t + k]];
+                    if (stamp[v] == stamp_value - 1) {
+                        stamp[v] = stamp_value;
+                        ++shared;
+                    }
+                }
+            }
+            return shared > opposite;
+        }
+
+        // One round of independent collapses, cheapest first, each vertex touched at most
+        // once. Returns false when nothing could collapse.
+        bool pass(size_t triangles_to_remove) {
+            const size_t triangle_count = indices.size() / 3;
+
+            // Unique edges, an edge used by anything but exactly two triangles is a border
+            std::vector<uint64_t> keys;
+            keys.reserve(indices.size());
+            for (size_t t = 0; t < indices.size(); t += 3) {
+                for (int c = 0; c < 3; ++c) {
+                    keys.push_back(edge_key(indices[t + c], indices[t + (c + 1) % 3]));
+                }
+            }
+            std::sort(keys.begin(), keys.end());
+
+            std::vector<uint8_t> border(positions.size(), 0);
+            struct Edge {
+                unsigned int a, b;
+                bool border;
+            };
+            std::vector<Edge> edges;
+            edges.reserve(keys.size() / 2);
+            for (size_t i = 0; i < keys.size();) {
+                size_t j = i;
+                while (j < keys.size() && keys[j] == keys[i]) {
+                    ++j;
+                }
+                Edge e{static_cast<unsigned int>(keys[i] >> 32), static_cast<unsigned int>(keys[i]), j - i != 2};
+                if (e.border) {
+                    border[e.a] = border[e.b] = 1;
+                }
+                edges.push_back(e);
+                i = j;
+            }
+
+            // A border vertex may only slide along a border edge
+            std::vector<Collapse> candidates;
+            candidates.reserve(edges.size());
+            for (const Edge& e : edges) {
+                Quadric q = quadrics[e.a];
+                q += quadrics[e.b];
+                bool a_to_b = !border[e.a] || e.border;
+                bool b_to_a = !border[e.b] || e.border;
+                double cost_ab = a_to_b ? q.evaluate(positions[e.b]) : HUGE_VAL;
+                double cost_ba = b_to_a ? q.evaluate(positions[e.a]) : HUGE_VAL;
+                if (!a_to_b && !b_to_a) {
+                    continue;
+                }
+                double w = std::max(q.weight, 1e-30);
+                if (cost_ab <= cost_ba) {
+                    candidates.push_back({cost_ab / w, e.a, e.b});
+                } else {
+                    candidates.push_back({cost_ba / w, e.b, e.a});
+                }
+            }
+            std::sort(candidates.begin(), candidates.end(),
+                      [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+            // Vertex to triangle adjacency as offsets into one array
+            std::vector<unsigned int> offsets(positions.size() + 1, 0);
+            for (unsigned int v : indices) {
+                ++offsets[v + 1];
+            }
+            for (size_t v = 0; v < positions.size(); ++v) {
+                offsets[v + 1] += offsets[v];
+            }
+            std::vector<unsigned int> ring(indices.size());
+            {
+                std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+                for (size_t t = 0; t < indices.size(); t += 3) {
+                    for (int c = 0; c < 3; ++c) {
+                        ring[fill[indices[t + c]]++] = static_cast<unsigned int>(t);
+                    }
+                }
+            }
+
+            // Later candidates cost more than the ones that lost to a locked neighbour,
+            // so only the cheaper part of the list gets a chance this round
+            size_t limit = std::max<size_t>(candidates.size() / 3, std::min(candidates.size(), triangles_to_remove));
+            std::vector<uint8_t> locked(positions.size(), 0);
+            size_t removed = 0;
+            size_t collapses = 0;
+            for (size_t i = 0; i < limit && removed < triangles_to_remove; ++i) {
+                const Collapse& c = candidates[i];
+                if (locked[c.from] || locked[c.to]) {
+                    continue;
+                }
+                const unsigned int* from_ring = ring.data() + offsets[c.from];
+                size_t from_ring_size = offsets[c.from + 1] - offsets[c.from];
+                const unsigned int* to_ring = ring.data() + offsets[c.to];
+                size_t to_ring_size = offsets[c.to + 1] - offsets[c.to];
+                if (flips(c.from, c.to, from_ring, from_ring_size)
+                    || pinches(c.from, c.to, from_ring, from_ring_size, to_ring, to_ring_size)) {
+                    continue;
+                }
+
+                for (size_t r = 0; r < from_ring_size; ++r) {
+                    size_t t = from_ring[r];
+                    removed += remap[indices[t]] == c.to || remap[indices[t + 1]] == c.to || remap[indices[t + 2]] == c.to;
+                }
+                // Lock both rings so no other collapse this round works from stale neighbours
+                for (const auto& [ring_begin, ring_size] :
+                     {std::pair(from_ring, from_ring_size), std::pair(to_ring, to_ring_size)}) {
+                    for (size_t r = 0; r < ring_size; ++r) {
+                        size_t t = ring_begin[r];
+                        for (int k = 0; k < 3; ++k) {
+                            locked[remap[indices[t + k]]] = 1;
+                        }
+                    }
+                }
+
+                quadrics[c.to] += quadrics[c.from];
+                remap[c.from] = c.to;
+                max_error = std::max(max_error, std::sqrt(c.cost));
+                ++collapses;
+            }
+
+            if (collapses == 0) {
+                return false;
+            }
+
+            // Rewrite through the remap and drop triangles that lost a corner
+            size_t write = 0;
+            for (size_t t = 0; t < triangle_count * 3; t += 3) {
+                unsigned int a = remap[indices[t]], b = remap[indices[t + 1]], c = remap[indices[t + 2]];
+                if (a == b || b == c || a == c) {
+                    continue;
+                }
+                indices[write++] = a;
+                indices[write++] = b;
+                indices[write++] = c;
+            }
+            indices.resize(write);
+            return true;
+        }
+};
+
+}
+
+std::vector<MeshLod> build_lod_chain(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                                     const std::vector<float>& ratios) {
+    std::vector<float> sorted = ratios;
+    std::sort(sorted.begin(), sorted.end(), std::greater<float>());
+
+    std::vector<MeshLod> chain;
+    Simplifier simplifier(vertices, indices);
+    const size_t triangles = indices.size() / 3;
+    for (float ratio : sorted) {
+        size_t target = static_cast<size_t>(static_cast<double>(triangles) * std::clamp(ratio, 0.0f, 1.0f));
+        // A tetrahedron is as far as a closed surface can go
+        bool reached = simplifier.reduce_to(std::max<size_t>(target, 4));
+        if (!chain.empty() && chain.back().indices.size() == simplifier.current().size()) {
+            break;      // stuck, every further level would come out the same
+        }
+        chain.push_back({simplifier.current(), simplifier.error()});
+        if (!reached) {
+            break;
+        }
+    }
+    return chain;
+}
+
+MeshLod simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                 size_t target_index_count) {
+    Simplifier simplifier(vertices, indices);
+    simplifier.reduce_to(std::max<size_t>(target_index_count / 3, 4));
+    return {simplifier.current(), simplifier.error()};
+}
@@ -0,0 +1,27 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include <cstddef>
+#include <vector>
+#include "vertex.h"
+
+// One level of detail, an index buffer over the same vertices as the full mesh
+struct MeshLod {
+    std::vector<unsigned int> indices;
+    float error = 0.0f;     // largest distance a collapse moved the surface, in mesh units
+};
+
+// Quadric error metric edge collapse (Garland & Heckbert) down to roughly each of
+// `ratios` times the full triangle count, largest ratio first. Collapses move one end of
+// an edge onto the other, so every level indexes a subset of `vertices` and can share
+// their buffer. Open borders only collapse along themselves. The chain is a single run
+// snapshotted at each target, a level stops short when no valid collapse remains.
+// Needs a welded mesh.
+std::vector<MeshLod> build_lod_chain(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                                     const std::vector<float>& ratios);
+
+// Single level version of build_lod_chain
+MeshLod simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                 size_t target_index_count);
+
+#endif
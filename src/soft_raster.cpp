@@ -0,0 +1,324 @@
+#include "soft_raster.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr int TILE_SIZE = 64;
+constexpr float SUBPIXEL = 256.0f;  // window coordinates snap to 1/256 pixel like GPUs do
+
+// Setup result for one screen space triangle. Edge i is w_i = a_i x + b_i y + c_i, positive
+// inside, and depth is the plane z = za x + zb y + zc. The view space normal divided by
+// clip w is affine in screen space too, na x + nb y + nc.
+struct RasterTriangle {
+    float a[3], b[3], c[3];
+    bool inclusive[3];
+    float za, zb, zc;
+    glm::vec3 na, nb, nc;
+    int min_x, min_y, max_x, max_y;
+    bool front;         // counter-clockwise on screen, GL's default front face
+};
+
+uint32_t pack_rgba(glm::vec4 c) {
+    auto channel = [](float v) { return static_cast<uint32_t>(std::lround(std::clamp(v, 0.0f, 1.0f) * 255.0f)); };
+    return channel(c.x) | channel(c.y) << 8 | channel(c.z) << 16 | channel(c.w) << 24;
+}
+
+// lit.frag's lighting for a view space normal already facing the camera
+glm::vec3 shade(glm::vec3 color, glm::vec3 n) {
+    float key = std::max(n.z, 0.0f);
+    float fill = 0.5f + 0.5f * n.y;
+    float highlight = std::pow(key, 32.0f);
+    return color * (0.2f + 0.15f * fill + 0.65f * key) + glm::vec3(0.15f * highlight);
+}
+
+// Clips against the near plane (z >= -w in GL clip space), interpolating the normals along
+// with the positions. Returns the vertex count.
+int clip_near(const glm::vec4 in[3], const glm::vec3 in_normals[3], glm::vec4 out[4], glm::vec3 out_normals[4]) {
+    int count = 0;
+    for (int i = 0; i < 3; ++i) {
+        int j = (i + 1) % 3;
+        const glm::vec4& p = in[i];
+        const glm::vec4& q = in[j];
+        float dp = p.z + p.w;
+        float dq = q.z + q.w;
+        if (dp >= 0.0f) {
+            out_normals[count] = in_normals[i];
+            out[count++] = p;
+        }
+        if ((dp >= 0.0f) != (dq >= 0.0f)) {
+            float t = dp / (dp - dq);
+            out_normals[count] = in_normals[i] + (in_normals[j] - in_normals[i]) * t;
+            out[count++] = p + (q - p) * t;
+        }
+    }
+    return count;
+}
+
+bool setup(const glm::vec4 clip[3], const glm::vec3 normals[3], int width, int height, RasterTriangle& tri) {
+    float x[3], y[3], z[3];
+    glm::vec3 n[3];
+    for (int i = 0; i < 3; ++i) {
+        float inv_w = 1.0f / clip[i].w;
+        n[i] = normals[i] * inv_w;
+        x[i] = std::round((clip[i].x * inv_w * 0.5f + 0.5f) * width * SUBPIXEL) / SUBPIXEL;
+        y[i] = std::round((clip[i].y * inv_w * 0.5f + 0.5f) * height * SUBPIXEL) / SUBPIXEL;
+        z[i] = clip[i].z * inv_w * 0.5f + 0.5f;
+    }
+
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area == 0.0f) {
+        return false;
+    }
+    // No face culling in the GL path either, flip clockwise triangles so inside is positive
+    float sign = area > 0.0f ? 1.0f : -1.0f;
+    tri.front = area > 0.0f;
+    area *= sign;
+
+    for (int i = 0; i < 3; ++i) {
+        int j = (i + 1) % 3;
+        int k = (i + 2) % 3;
+        tri.a[i] = -(y[k] - y[j]) * sign;
+        tri.b[i] = (x[k] - x[j]) * sign;
+        tri.c[i] = -(tri.a[i] * x[j] + tri.b[i] * y[j]);
+        // Top-left rule: pixels exactly on a left or top edge belong to this triangle
+        tri.inclusive[i] = tri.a[i] > 0.0f || (tri.a[i] == 0.0f && tri.b[i] < 0.0f);
+    }
+
+    tri.za = (tri.a[0] * z[0] + tri.a[1] * z[1] + tri.a[2] * z[2]) / area;
+    tri.zb = (tri.b[0] * z[0] + tri.b[1] * z[1] + tri.b[2] * z[2]) / area;
+    tri.zc = (tri.c[0] * z[0] + tri.c[1] * z[1] + tri.c[2] * z[2]) / area;
+    tri.na = (tri.a[0] * n[0] + tri.a[1] * n[1] + tri.a[2] * n[2]) / area;
+    tri.nb = (tri.b[0] * n[0] + tri.b[1] * n[1] + tri.b[2] * n[2]) / area;
+    tri.nc = (tri.c[0] * n[0] + tri.c[1] * n[1] + tri.c[2] * n[2]) / area;
+
+    // Pixel centers at +0.5 inside the bounding box, clamped to the viewport
+    tri.min_x = std::max(0, static_cast<int>(std::ceil(std::min({x[0], x[1], x[2]}) - 0.5f)));
+    tri.min_y = std::max(0, static_cast<int>(std::ceil(std::min({y[0], y[1], y[2]}) - 0.5f)));
+    tri.max_x = std::min(width - 1, static_cast<int>(std::floor(std::max({x[0], x[1], x[2]}) - 0.5f)));
+    tri.max_y = std::min(height - 1, static_cast<int>(std::floor(std::max({y[0], y[1], y[2]}) - 0.5f)));
+    return tri.min_x <= tri.max_x && tri.min_y <= tri.max_y;
+}
+
+// lit.frag at the pixel center (px, py). Perspective correct interpolation would divide the
+// normal plane by the 1/w plane, a positive scale that normalizing discards anyway.
+uint32_t shade_pixel(const RasterTriangle& tri, glm::vec3 color, float px, float py) {
+    glm::vec3 n = tri.na * px + tri.nb * py + tri.nc;
+    float length = glm::length(n);
+    n = length > 0.0f ? n / length : glm::vec3(0.0f, 0.0f, 1.0f);
+    return pack_rgba(glm::vec4(shade(color, tri.front ? n : -n), 1.0f));
+}
+
+void raster_tile(const RasterTriangle& tri, glm::vec3 color, int x0, int y0, int x1, int y1, int stride,
+                 uint32_t* color_buffer, float* depth_buffer) {
+    int min_x = std::max(tri.min_x, x0);
+    int max_x = std::min(tri.max_x, x1 - 1);
+    int min_y = std::max(tri.min_y, y0);
+    int max_y = std::min(tri.max_y, y1 - 1);
+    if (min_x > max_x || min_y > max_y) {
+        return;
+    }
+    // 4-wide blocks stay aligned to the tile, which starts on a multiple of 4
+    int block_x = min_x & ~3;
+
+#ifdef __SSE2__
+    const __m128 lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 span_min = _mm_set1_ps(static_cast<float>(min_x));
+    const __m128 span_max = _mm_set1_ps(static_cast<float>(max_x + 1));
+
+    __m128 a[3], inclusive[3];
+    for (int e = 0; e < 3; ++e) {
+        a[e] = _mm_set1_ps(tri.a[e]);
+        inclusive[e] = _mm_castsi128_ps(_mm_set1_epi32(tri.inclusive[e] ? -1 : 0));
+    }
+    const __m128 za = _mm_set1_ps(tri.za);
+
+    for (int y = min_y; y <= max_y; ++y) {
+        float py = y + 0.5f;
+        __m128 row[3];
+        for (int e = 0; e < 3; ++e) {
+            row[e] = _mm_set1_ps(tri.b[e] * py + tri.c[e]);
+        }
+        __m128 z_row = _mm_set1_ps(tri.zb * py + tri.zc);
+
+        for (int x = block_x; x <= max_x; x += 4) {
+            __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lane);
+            // Lanes left of the span or past its end are masked off
+            __m128 mask = _mm_and_ps(_mm_cmpge_ps(px, span_min), _mm_cmplt_ps(px, span_max));
+            for (int e = 0; e < 3; ++e) {
+                __m128 w = _mm_add_ps(_mm_mul_ps(a[e], px), row[e]);
+                __m128 inside = _mm_or_ps(_mm_cmpgt_ps(w, zero), _mm_and_ps(_mm_cmpeq_ps(w, zero), inclusive[e]));
+                mask = _mm_and_ps(mask, inside);
+            }
+            if (_mm_movemask_ps(mask) == 0) {
+                continue;
+            }
+
+            float* depth = depth_buffer + static_cast<size_t>(y) * stride + x;
+            uint32_t* pixel = color_buffer + static_cast<size_t>(y) * stride + x;
+            __m128 z = _mm_add_ps(_mm_mul_ps(za, px), z_row);
+            __m128 old_depth = _mm_loadu_ps(depth);
+            mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmplt_ps(z, old_depth), _mm_and_ps(_mm_cmpge_ps(z, zero),
+                                                                                         _mm_cmple_ps(z, one))));
+
+            int lanes = _mm_movemask_ps(mask);
+            if (lanes == 0) {
+                continue;
+            }
+
+            // Shading is scalar and only runs for the lanes that passed the depth test
+            alignas(16) uint32_t shaded[4] = {};
+            for (int l = 0; l < 4; ++l) {
+                if (lanes & (1 << l)) {
+                    shaded[l] = shade_pixel(tri, color, x + l + 0.5f, py);
+                }
+            }
+            __m128i fill = _mm_load_si128(reinterpret_cast<const __m128i*>(shaded));
+
+            _mm_storeu_ps(depth, _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, old_depth)));
+            __m128i m = _mm_castps_si128(mask);
+            __m128i old_color = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixel));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pixel),
+                             _mm_or_si128(_mm_and_si128(m, fill), _mm_andnot_si128(m, old_color)));
+        }
+    }
+#else
+    for (int y = min_y; y <= max_y; ++y) {
+        float py = y + 0.5f;
+        for (int x = block_x; x <= max_x; ++x) {
+            if (x < min_x) {
+                continue;
+            }
+            float px = x + 0.5f;
+            bool inside = true;
+            for (int e = 0; e < 3; ++e) {
+                float w = tri.a[e] * px + tri.b[e] * py + tri.c[e];
+                inside = inside && (w > 0.0f || (w == 0.0f && tri.inclusive[e]));
+            }
+            if (!inside) {
+                continue;
+            }
+            size_t i = static_cast<size_t>(y) * stride + x;
+            float z = tri.za * px + tri.zb * py + tri.zc;
+            if (z < depth_buffer[i] && z >= 0.0f && z <= 1.0f) {
+                depth_buffer[i] = z;
+                color_buffer[i] = shade_pixel(tri, color, px, py);
+            }
+        }
+    }
+#endif
+}
+
+}
+
+SoftwareRasterizer::SoftwareRasterizer(int width, int height, unsigned int threads)
+    : w(width), h(height), stride((width + 3) & ~3), threads(resolve_thread_count(threads)),
+      color_buffer(static_cast<size_t>(stride) * height, 0), depth_buffer(static_cast<size_t>(stride) * height, 1.0f) {
+}
+
+void SoftwareRasterizer::clear(glm::vec4 color) {
+    std::fill(color_buffer.begin(), color_buffer.end(), pack_rgba(color));
+    std::fill(depth_buffer.begin(), depth_buffer.end(), 1.0f);
+}
+
+void SoftwareRasterizer::draw(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                              const glm::mat4& model, const Camera& camera, glm::vec3 color) {
+    const glm::mat4 mvp = camera.projection * camera.view * model;
+    const glm::mat3 normal_to_view = glm::mat3(camera.view * model);
+
+    std::vector<glm::vec4> clip(vertices.size());
+    std::vector<glm::vec3> normals(vertices.size());
+    parallel_for(vertices.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            clip[i] = mvp * glm::vec4(vertices[i].position, 1.0f);
+            // mat3(view) * mat3(model) * normal, as shader.vert and lit.frag apply it
+            normals[i] = normal_to_view * vertices[i].normal;
+        }
+    }, threads);
+
+    const int tiles_x = (w + TILE_SIZE - 1) / TILE_SIZE;
+    const int tiles_y = (h + TILE_SIZE - 1) / TILE_SIZE;
+    const size_t tile_count = static_cast<size_t>(tiles_x) * tiles_y;
+
+    // Each chunk of input triangles sets up and bins on its own; tiles then walk the chunks
+    // in order, which keeps submission order and so depth ties identical to a serial run
+    const size_t triangle_count = indices.size() / 3;
+    const size_t chunks = std::clamp<size_t>(triangle_count / 4096, 1, static_cast<size_t>(threads) * 4);
+    std::vector<std::vector<RasterTriangle>> triangles(chunks);
+    std::vector<std::vector<std::vector<uint32_t>>> bins(chunks, std::vector<std::vector<uint32_t>>(tile_count));
+
+    parallel_for(chunks, [&](size_t chunk_begin, size_t chunk_end) {
+        for (size_t chunk = chunk_begin; chunk < chunk_end; ++chunk) {
+            size_t first = triangle_count * chunk / chunks;
+            size_t last = triangle_count * (chunk + 1) / chunks;
+            for (size_t t = first; t < last; ++t) {
+                glm::vec4 corners[3] = {clip[indices[t * 3]], clip[indices[t * 3 + 1]], clip[indices[t * 3 + 2]]};
+                glm::vec3 corner_normals[3] = {normals[indices[t * 3]], normals[indices[t * 3 + 1]],
+                                               normals[indices[t * 3 + 2]]};
+
+                // Entirely beyond one frustum plane, nothing to draw
+                bool outside = false;
+                for (int axis = 0; axis < 3 && !outside; ++axis) {
+                    outside = (corners[0][axis] > corners[0].w && corners[1][axis] > corners[1].w &&
+                               corners[2][axis] > corners[2].w) ||
+                              (corners[0][axis] < -corners[0].w && corners[1][axis] < -corners[1].w &&
+                               corners[2][axis] < -corners[2].w);
+                }
+                if (outside) {
+                    continue;
+                }
+
+                glm::vec4 polygon[4];
+                glm::vec3 polygon_normals[4];
+                int count = clip_near(corners, corner_normals, polygon, polygon_normals);
+                for (int fan = 1; fan + 1 < count; ++fan) {
+                    glm::vec4 piece[3] = {polygon[0], polygon[fan], polygon[fan + 1]};
+                    glm::vec3 piece_normals[3] = {polygon_normals[0], polygon_normals[fan], polygon_normals[fan + 1]};
+                    RasterTriangle tri;
+                    if (!setup(piece, piece_normals, w, h, tri)) {
+                        continue;
+                    }
+                    uint32_t id = static_cast<uint32_t>(triangles[chunk].size());
+                    triangles[chunk].push_back(tri);
+                    for (int ty = tri.min_y / TILE_SIZE; ty <= tri.max_y / TILE_SIZE; ++ty) {
+                        for (int tx = tri.min_x / TILE_SIZE; tx <= tri.max_x / TILE_SIZE; ++tx) {
+                            bins[chunk][static_cast<size_t>(ty) * tiles_x + tx].push_back(id);
+                        }
+                    }
+                }
+            }
+        }
+    }, threads, 1);
+
+    parallel_for(tile_count, [&](size_t begin, size_t end) {
+        for (size_t tile = begin; tile < end; ++tile) {
+            int x0 = static_cast<int>(tile % tiles_x) * TILE_SIZE;
+            int y0 = static_cast<int>(tile / tiles_x) * TILE_SIZE;
+            int x1 = std::min(x0 + TILE_SIZE, w);
+            int y1 = std::min(y0 + TILE_SIZE, h);
+            for (size_t chunk = 0; chunk < chunks; ++chunk) {
+                for (uint32_t id : bins[chunk][tile]) {
+                    raster_tile(triangles[chunk][id], color, x0, y0, x1, y1, stride, color_buffer.data(),
+                                depth_buffer.data());
+                }
+            }
+        }
+    }, threads, 1);
+}
+
+std::vector<unsigned char> SoftwareRasterizer::pixels() const {
+    std::vector<unsigned char> out(static_cast<size_t>(w) * h * 4);
+    for (int y = 0; y < h; ++y) {
+        std::memcpy(out.data() + static_cast<size_t>(y) * w * 4, color_buffer.data() + static_cast<size_t>(y) * stride,
+                    static_cast<size_t>(w) * 4);
+    }
+    return out;
+}
@@ -0,0 +1,39 @@
+#ifndef SOFT_RASTER_H
+#define SOFT_RASTER_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "camera.h"
+#include "vertex.h"
+
+// CPU rasterizer producing the image shader.vert/lit.frag would: same transform chain,
+// GL clip space and depth range, pixel center sampling, top-left fill rule, a LESS depth
+// test, and lit.frag's lighting per pixel from perspective correct vertex normals. The
+// screen is cut into tiles, triangles are binned per tile, and tiles are shaded in
+// parallel with 4-wide SSE edge functions.
+class SoftwareRasterizer {
+    public:
+        SoftwareRasterizer(int width, int height, unsigned int threads = 0);
+
+        void clear(glm::vec4 color);
+
+        void draw(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                  const glm::mat4& model, const Camera& camera, glm::vec3 color);
+
+        int width() const { return w; }
+
+        int height() const { return h; }
+
+        // Tightly packed RGBA8 rows from bottom to top, the order glReadPixels returns
+        std::vector<unsigned char> pixels() const;
+
+    private:
+        int w, h;
+        int stride;     // row pitch in pixels, padded so 4-wide stores never leave the row
+        unsigned int threads;
+        std::vector<uint32_t> color_buffer;
+        std::vector<float> depth_buffer;
+};
+
+#endif
@@ -0,0 +1,307 @@
+#include "stl.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+static glm::vec3 read_vec3(const unsigned char* p) {
+    float xyz[3];
+    std::memcpy(xyz, p, sizeof(xyz));
+    return glm::vec3(xyz[0], xyz[1], xyz[2]);
+}
+
+// Exporters sometimes leave the facet normal zeroed, derive it from the winding
+static glm::vec3 facet_normal(glm::vec3 stored, const glm::vec3* p) {
+    float length = glm::length(stored);
+    if (!(length > 0.0f)) {
+        stored = glm::cross(p[1] - p[0], p[2] - p[0]);
+        length = glm::length(stored);
+    }
+    return length > 0.0f ? stored / length : glm::vec3(0.0f, 0.0f, 1.0f);
+}
+
+bool is_ascii_stl(const unsigned char* data, size_t size) {
+    // Plenty of binary exporters also start the header with "solid", so a file whose size
+    // matches its binary triangle count is binary no matter what the header says
+    if (size >= STL_RECORD_OFFSET) {
+        unsigned int count;
+        std::memcpy(&count, data + STL_HEADER_SIZE, sizeof(count));
+        if (STL_RECORD_OFFSET + static_cast<uint64_t>(count) * STL_RECORD_SIZE == size) {
+            return false;
+        }
+    }
+
+    std::string_view text(reinterpret_cast<const char*>(data), std::min<size_t>(size, 1024));
+    size_t start = text.find_first_not_of(" \t\r\n");
+    if (start == std::string_view::npos || text.substr(start, 5) != "solid") {
+        return false;
+    }
+    return text.find("facet") != std::string_view::npos || size < 1024;
+}
+
+void decode_binary_records(const unsigned char* records, size_t first, size_t count, Vertex* out) {
+    const unsigned char* record = records + first * STL_RECORD_SIZE;
+    for (size_t t = 0; t < count; ++t) {
+        glm::vec3 p[3];
+        for (int v = 0; v < 3; ++v) {
+            p[v] = read_vec3(record + 12 + v * 12);
+        }
+        glm::vec3 normal = facet_normal(read_vec3(record), p);
+
+        // Attribute byte count trails the vertices and is ignored
+        for (int v = 0; v < 3; ++v) {
+            *out++ = {p[v], normal};
+        }
+        record += STL_RECORD_SIZE;
+    }
+}
+
+static void load_binary(const MappedFile& file, StlLoadResult& result, const StlLoadOptions& options) {
+    if (file.size() < STL_RECORD_OFFSET) {
+        throw std::runtime_error("STL file too small to hold a header");
+    }
+
+    std::memcpy(&result.declared_triangles, file.data() + STL_HEADER_SIZE, sizeof(unsigned int));
+
+    // Size is checked once up front, the decode loop below never touches a partial record
+    size_t available = (file.size() - STL_RECORD_OFFSET) / STL_RECORD_SIZE;
+    result.recovered_triangles = static_cast<unsigned int>(
+        std::min<size_t>(available, result.declared_triangles));
+
+    result.vertices.resize(static_cast<size_t>(result.recovered_triangles) * 3);
+
+    const unsigned char* records = file.data() + STL_RECORD_OFFSET;
+    Vertex* vertices = result.vertices.data();
+    parallel_for(result.recovered_triangles, [&](size_t begin, size_t end) {
+        decode_binary_records(records, begin, end - begin, vertices + begin * 3);
+    }, options.threads);
+}
+
+namespace {
+
+// Cursor over one slice of an ASCII STL, no allocation and no locale
+struct AsciiScanner {
+    const char* p;
+    const char* end;
+
+    static bool is_space(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+    }
+
+    std::string_view word() {
+        while (p < end && is_space(*p)) {
+            ++p;
+        }
+        const char* start = p;
+        while (p < end && !is_space(*p)) {
+            ++p;
+        }
+        return std::string_view(start, p - start);
+    }
+
+    void skip_line() {
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        p = nl ? nl + 1 : end;
+    }
+
+    bool number(float& out) {
+        while (p < end && is_space(*p)) {
+            ++p;
+        }
+        // from_chars rejects a leading '+', which some exporters emit
+        if (p < end && *p == '+') {
+            ++p;
+        }
+        auto [next, ec] = std::from_chars(p, end, out);
+        if (ec != std::errc()) {
+            return false;
+        }
+        p = next;
+        return true;
+    }
+
+    bool vec3(glm::vec3& out) {
+        return number(out.x) && number(out.y) && number(out.z);
+    }
+};
+
+}
+
+void parse_ascii_facets(const char* begin, const char* end, std::vector<Vertex>& out) {
+    AsciiScanner scan{begin, end};
+    glm::vec3 normal(0.0f);
+    glm::vec3 corners[3];
+    int corner_count = 0;
+    bool valid = false;
+
+    while (scan.p < scan.end) {
+        std::string_view w = scan.word();
+        if (w == "vertex") {
+            glm::vec3 v;
+            if (scan.vec3(v) && corner_count < 3) {
+                corners[corner_count++] = v;
+            } else {
+                valid = false;
+            }
+        } else if (w == "facet") {
+            corner_count = 0;
+            valid = scan.word() == "normal" && scan.vec3(normal);
+        } else if (w == "endfacet") {
+            if (valid && corner_count == 3) {
+                glm::vec3 n = facet_normal(normal, corners);
+                for (const glm::vec3& c : corners) {
+                    out.push_back({c, n});
+                }
+            }
+            valid = false;
+        } else if (w == "solid" || w == "endsolid") {
+            // Followed by a free form name
+            scan.skip_line();
+        }
+    }
+}
+
+static void load_ascii(const MappedFile& file, StlLoadResult& result, const StlLoadOptions& options) {
+    const char* text = reinterpret_cast<const char*>(file.data());
+    const char* text_end = text + file.size();
+    std::string_view view(text, file.size());
+
+    // Facets are independent, so cut the text into slices that each start right after an
+    // "endfacet". Slice count and boundaries depend only on the file and thread count.
+    unsigned int threads = resolve_thread_count(options.threads);
+    constexpr size_t MIN_SLICE = 1 << 20;
+    size_t slices = std::clamp<size_t>(file.size() / MIN_SLICE, 1, static_cast<size_t>(threads) * 4);
+
+    std::vector<const char*> cuts{text};
+    for (size_t s = 1; s < slices; ++s) {
+        size_t target = std::max<size_t>(file.size() * s / slices, cuts.back() - text);
+        size_t found = view.find("endfacet", target);
+        if (found == std::string_view::npos) {
+            break;
+        }
+        cuts.push_back(text + found + 8);
+    }
+    cuts.push_back(text_end);
+
+    std::vector<std::vector<Vertex>> parts(cuts.size() - 1);
+    parallel_for(parts.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            parse_ascii_facets(cuts[i], cuts[i + 1], parts[i]);
+        }
+    }, threads, 1);
+
+    std::vector<size_t> offsets(parts.size() + 1, 0);
+    for (size_t i = 0; i < parts.size(); ++i) {
+        offsets[i + 1] = offsets[i] + parts[i].size();
+    }
+    result.vertices.resize(offsets.back());
+    parallel_for(parts.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            std::copy(parts[i].begin(), parts[i].end(), result.vertices.begin() + offsets[i]);
+        }
+    }, threads, 1);
+
+    // ASCII has no stored count, everything parsed counts as declared
+    result.ascii = true;
+    result.declared_triangles = result.recovered_triangles = static_cast<unsigned int>(result.vertices.size() / 3);
+}
+
+StlLoadResult load_stl(const std::filesystem::path& path, const StlLoadOptions& options) {
+    if (!std::filesystem::exists(path)) {
+        throw std::runtime_error("STL file not found");
+    }
+
+    MappedFile file(path);
+    StlLoadResult result;
+
+    if (is_ascii_stl(file.data(), file.size())) {
+        load_ascii(file, result, options);
+    } else {
+        load_binary(file, result, options);
+    }
+    return result;
+}
+
+static void append_float(std::string& out, float value) {
+    char buffer[32];
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, end);
+}
+
+static void append_vec3(std::string& out, const char* prefix, const glm::vec3& v) {
+    out += prefix;
+    append_float(out, v.x);
+    out += ' ';
+    append_float(out, v.y);
+    out += ' ';
+    append_float(out, v.z);
+    out += '\n';
+}
+
+void write_stl(const std::filesystem::path& path, const std::vector<Vertex>& vertices, bool ascii) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Could not open " + path.string() + " for writing");
+    }
+
+    const size_t triangles = vertices.size() / 3;
+    // Buffered a batch of triangles at a time rather than one small write per value
+    constexpr size_t BATCH = 4096;
+    std::string buffer;
+    if (ascii) {
+        out << "solid stl_viewer\n";
+        for (size_t t = 0; t < triangles; ++t) {
+            const Vertex* v = &vertices[t * 3];
+            append_vec3(buffer, "  facet normal ", v[0].normal);
+            buffer += "    outer loop\n";
+            for (int k = 0; k < 3; ++k) {
+                append_vec3(buffer, "      vertex ", v[k].position);
+            }
+            buffer += "    endloop\n  endfacet\n";
+            if ((t + 1) % BATCH == 0) {
+                out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                buffer.clear();
+            }
+        }
+        buffer += "endsolid stl_viewer\n";
+    } else {
+        if (triangles > std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error("Too many triangles for a binary STL");
+        }
+        char header[STL_HEADER_SIZE] = "binary STL written by stl_viewer";
+        uint32_t count = static_cast<uint32_t>(triangles);
+        out.write(header, sizeof(header));
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        buffer.resize(BATCH * STL_RECORD_SIZE);
+        size_t used = 0;
+        for (size_t t = 0; t < triangles; ++t) {
+            const Vertex* v = &vertices[t * 3];
+            float values[12] = {v[0].normal.x, v[0].normal.y, v[0].normal.z};
+            for (int k = 0; k < 3; ++k) {
+                values[3 + k * 3] = v[k].position.x;
+                values[4 + k * 3] = v[k].position.y;
+                values[5 + k * 3] = v[k].position.z;
+            }
+            char* record = buffer.data() + used;
+            std::memcpy(record, values, sizeof(values));
+            std::memset(record + sizeof(values), 0, 2);
+            used += STL_RECORD_SIZE;
+            if (used == buffer.size()) {
+                out.write(buffer.data(), static_cast<std::streamsize>(used));
+                used = 0;
+            }
+        }
+        buffer.resize(used);
+    }
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    if (!out) {
+        throw std::runtime_error("Failed writing " + path.string());
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef STL_H
+#define STL_H
+
+#include <filesystem>
+#include <vector>
+#include "vertex.h"
+
+// Binary STL layout: 80 byte header, uint32 triangle count, then 50 byte records
+// (normal, three vertices, uint16 attribute byte count)
+constexpr size_t STL_HEADER_SIZE = 80;
+constexpr size_t STL_RECORD_OFFSET = STL_HEADER_SIZE + 4;
+constexpr size_t STL_RECORD_SIZE = 50;
+
+struct StlLoadOptions {
+    unsigned int threads = 0;   // decode threads, 0 uses every core
+};
+
+struct StlLoadResult {
+    std::vector<Vertex> vertices;       // three vertices per triangle, in file order
+    unsigned int declared_triangles = 0;    // count stored in the header
+    unsigned int recovered_triangles = 0;   // complete records actually present in the file
+    bool ascii = false;
+
+    bool truncated() const { return recovered_triangles < declared_triangles; }
+};
+
+// True for text STL ("solid ..." with facets) whose size doesn't match a binary count
+bool is_ascii_stl(const unsigned char* data, size_t size);
+
+// Decodes `count` binary records starting at record `first` into 3 * count vertices
+void decode_binary_records(const unsigned char* records, size_t first, size_t count, Vertex* out);
+
+// Appends every complete facet in the ASCII text [begin, end). Facets missing vertices or
+// holding unparsable numbers are dropped, so a truncated tail costs only its last facet.
+void parse_ascii_facets(const char* begin, const char* end, std::vector<Vertex>& out);
+
+// Maps the file and decodes every complete record, binary or ASCII. Truncated files are
+// not an error, the result just holds fewer triangles than the header declares.
+// Binary records are decoded in parallel chunks, each writing its own slice of the
+// presized vertex array. ASCII text is split at "endfacet" boundaries and parsed in
+// parallel. Either way the output is identical for any thread count.
+StlLoadResult load_stl(const std::filesystem::path& path, const StlLoadOptions& options = {});
+
+// Writes a triangle soup as load_stl returns it, three vertices per triangle. The facet
+// normal is taken from the first vertex of each triangle. ASCII output uses the shortest
+// text that reads back to the same floats, so converting either way loses nothing.
+void write_stl(const std::filesystem::path& path, const std::vector<Vertex>& vertices, bool ascii = false);
+
+#endif
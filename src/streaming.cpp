@@ -0,0 +1,195 @@
+#include "streaming.h"
+#include "mapped_file.h"
+#include "stl.h"
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+// Rough lower bound on the text of one ASCII facet, used to size the initial buffer
+constexpr size_t ASCII_BYTES_PER_FACET = 200;
+
+StreamingMesh::StreamingMesh(std::filesystem::path stl_path, VertexLayout layout, size_t batch_triangles,
+                             std::function<void()> on_progress)
+    : layout(layout_is_quantized(layout) ? VertexLayout::PositionNormal : layout),
+      batch_triangles(std::max<size_t>(batch_triangles, 1)), on_progress(std::move(on_progress)) {
+    if (!std::filesystem::exists(stl_path)) {
+        throw std::runtime_error("STL file not found");
+    }
+
+    // Size the buffer from the file up front so the common binary case never reallocates
+    size_t file_size = std::filesystem::file_size(stl_path);
+    size_t triangles;
+    {
+        MappedFile file(stl_path);
+        if (is_ascii_stl(file.data(), file.size())) {
+            triangles = file_size / ASCII_BYTES_PER_FACET;
+        } else {
+            unsigned int declared = 0;
+            if (file.size() >= STL_RECORD_OFFSET) {
+                std::memcpy(&declared, file.data() + STL_HEADER_SIZE, sizeof(declared));
+            }
+            size_t available = file.size() >= STL_RECORD_OFFSET ? (file.size() - STL_RECORD_OFFSET) / STL_RECORD_SIZE : 0;
+            triangles = std::min<size_t>(declared, available);
+        }
+    }
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    expected_vertices = triangles * 3;
+    reserve(std::max<size_t>(triangles, 1) * 3);
+
+    worker = std::thread([this, stl_path] { decode(stl_path); });
+}
+
+StreamingMesh::~StreamingMesh() {
+    cancel = true;
+    if (worker.joinable()) {
+        worker.join();
+    }
+    glDeleteBuffers(1, &VBO);
+    glDeleteVertexArrays(1, &VAO);
+}
+
+void StreamingMesh::decode(std::filesystem::path stl_path) {
+    try {
+        MappedFile file(stl_path);
+        std::vector<Vertex> batch;
+        batch.reserve(batch_triangles * 3);
+
+        if (is_ascii_stl(file.data(), file.size())) {
+            const char* text = reinterpret_cast<const char*>(file.data());
+            std::string_view view(text, file.size());
+            size_t slice_bytes = batch_triangles * ASCII_BYTES_PER_FACET;
+
+            size_t start = 0;
+            while (start < view.size() && !cancel) {
+                size_t found = view.find("endfacet", std::min(start + slice_bytes, view.size()));
+                size_t end = found == std::string_view::npos ? view.size() : found + 8;
+                batch.clear();
+                parse_ascii_facets(text + start, text + end, batch);
+                publish(batch);
+                start = end;
+            }
+        } else if (file.size() >= STL_RECORD_OFFSET) {
+            unsigned int declared;
+            std::memcpy(&declared, file.data() + STL_HEADER_SIZE, sizeof(declared));
+            size_t available = (file.size() - STL_RECORD_OFFSET) / STL_RECORD_SIZE;
+            size_t total = std::min<size_t>(declared, available);
+
+            const unsigned char* records = file.data() + STL_RECORD_OFFSET;
+            for (size_t first = 0; first < total && !cancel; first += batch_triangles) {
+                size_t count = std::min(batch_triangles, total - first);
+                batch.resize(count * 3);
+                decode_binary_records(records, first, count, batch.data());
+                publish(batch);
+            }
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        failure = std::current_exception();
+    }
+    decoding_done = true;
+    if (on_progress) {
+        on_progress();
+    }
+}
+
+void StreamingMesh::publish(const std::vector<Vertex>& batch) {
+    if (batch.empty()) {
+        return;
+    }
+    // Packing happens here so the render thread only copies bytes
+    std::vector<unsigned char> packed = pack_vertices(batch, layout, Bounds{});
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.push_back(std::move(packed));
+    }
+    if (on_progress) {
+        on_progress();
+    }
+}
+
+void StreamingMesh::reserve(size_t vertices) {
+    if (vertices <= capacity_vertices) {
+        return;
+    }
+
+    const size_t stride = vertex_stride(layout);
+    unsigned int grown;
+    glGenBuffers(1, &grown);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+    glBufferData(GL_COPY_WRITE_BUFFER, vertices * stride, nullptr, GL_STATIC_DRAW);
+
+    if (uploaded_vertices > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, VBO);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, uploaded_vertices * stride);
+    }
+    glDeleteBuffers(1, &VBO);
+    VBO = grown;
+    capacity_vertices = vertices;
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    setup_vertex_attributes(layout);
+    glBindVertexArray(0);
+}
+
+bool StreamingMesh::upload_ready(size_t max_bytes) {
+    const size_t stride = vertex_stride(layout);
+    size_t uploaded_bytes = 0;
+    bool progressed = false;
+
+    while (uploaded_bytes < max_bytes) {
+        std::vector<unsigned char> batch;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (failure) {
+                std::rethrow_exception(std::exchange(failure, nullptr));
+            }
+            if (ready.empty()) {
+                break;
+            }
+            batch = std::move(ready.front());
+            ready.pop_front();
+        }
+
+        size_t vertices = batch.size() / stride;
+        if (uploaded_vertices + vertices > capacity_vertices) {
+            reserve(std::max(capacity_vertices * 2, uploaded_vertices + vertices));
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, uploaded_vertices * stride, batch.size(), batch.data());
+        uploaded_vertices += vertices;
+        uploaded_bytes += batch.size();
+        progressed = true;
+    }
+
+    // Once everything is in, the estimate for ASCII files becomes the real count
+    if (finished()) {
+        expected_vertices = uploaded_vertices;
+    }
+    return progressed;
+}
+
+void StreamingMesh::draw() const {
+    if (uploaded_vertices == 0) {
+        return;
+    }
+    glVertexAttrib3f(POSITION_OFFSET_LOCATION, 0.0f, 0.0f, 0.0f);
+    glVertexAttrib3f(POSITION_SCALE_LOCATION, 1.0f, 1.0f, 1.0f);
+
+    glBindVertexArray(VAO);
+    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(uploaded_vertices));
+    glBindVertexArray(0);
+}
+
+bool StreamingMesh::finished() const {
+    if (!decoding_done) {
+        return false;
+    }
+    // A failure stays unfinished until upload_ready() has rethrown it
+    std::lock_guard<std::mutex> lock(mutex);
+    return ready.empty() && !failure;
+}
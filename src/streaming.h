@@ -0,0 +1,69 @@
+#ifndef STREAMING_H
+#define STREAMING_H
+
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "util.h"
+
+// Triangle soup decoded on a background thread in fixed size batches and appended to a
+// preallocated vertex buffer from the render loop, so drawing starts with the first batch.
+// Geometry is not welded or reordered; only float position layouts are supported since
+// quantization needs bounds of the whole file.
+class StreamingMesh {
+    public:
+        // `on_progress` runs on the decoding thread after each batch and once decoding ends,
+        // so an idle render loop can be woken to upload it
+        StreamingMesh(std::filesystem::path stl_path, VertexLayout layout = VertexLayout::PositionNormal,
+                      size_t batch_triangles = 1 << 16, std::function<void()> on_progress = {});
+
+        ~StreamingMesh();
+
+        StreamingMesh(const StreamingMesh&) = delete;
+        StreamingMesh& operator=(const StreamingMesh&) = delete;
+
+        // Uploads decoded batches with glBufferSubData, at most `max_bytes` per call so a
+        // frame never stalls on a huge copy. Returns true when anything new arrived.
+        // Rethrows a decode failure on the calling thread.
+        bool upload_ready(size_t max_bytes = size_t(32) << 20);
+
+        void draw() const;
+
+        // Decoding is done and every batch has been uploaded, false while a decode failure
+        // is waiting for upload_ready() to rethrow it
+        bool finished() const;
+
+        size_t uploaded_triangles() const { return uploaded_vertices / 3; }
+
+        // Exact for binary files, an estimate for ASCII until decoding finishes
+        size_t expected_triangles() const { return expected_vertices / 3; }
+
+    private:
+        VertexLayout layout;
+        size_t batch_triangles;
+        unsigned int VAO = 0, VBO = 0;
+        size_t capacity_vertices = 0;
+        size_t uploaded_vertices = 0;
+        size_t expected_vertices = 0;
+        std::function<void()> on_progress;
+
+        mutable std::mutex mutex;
+        std::deque<std::vector<unsigned char>> ready;   // packed batches waiting for upload
+        std::exception_ptr failure;
+        std::atomic<bool> decoding_done{false};
+        std::atomic<bool> cancel{false};
+        std::thread worker;
+
+        void decode(std::filesystem::path stl_path);
+
+        void publish(const std::vector<Vertex>& batch);
+
+        void reserve(size_t vertices);
+};
+
+#endif
@@ -1,9 +1,40 @@
 #include "util.h"
+#include "stl.h"
+#include "weld.h"
+#include "mesh_cache.h"
+#include "parallel.h"
+#include "program_cache.h"
+#include "shaders.h"
+#include <glm/gtc/type_ptr.hpp>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
 #include <array>
+#include <cstddef>
+#include <cstdlib>
 #include <cstring>
+#include <numeric>
+#include <utility>
+
+std::string shader_source(std::string_view name) {
+    if (const char* dir = std::getenv("STL_VIEWER_SHADER_DIR"); dir && *dir) {
+        std::filesystem::path path = std::filesystem::path(dir) / name;
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open shader file " + path.string());
+        }
+        std::stringstream stream;
+        stream << file.rdbuf();
+        return stream.str();
+    }
+    for (const EmbeddedShader& shader : EMBEDDED_SHADERS) {
+        if (shader.name == name) {
+            return std::string(shader.source);
+        }
+    }
+    throw std::runtime_error("No embedded shader named " + std::string(name));
+}
 
 Shader::Shader(std::filesystem::path vs_path, std::filesystem::path fs_path) {
     if(!std::filesystem::exists(vs_path)) {
@@ -13,8 +44,6 @@ Shader::Shader(std::filesystem::path vs_path, std::filesystem::path fs_path) {
         throw std::runtime_error("Fragment shader file does not exist");
     }
     
-    std::string vs_code;
-    std::string fs_code;
     std::ifstream vs_file(vs_path);
     std::ifstream fs_file(fs_path);
 
@@ -29,87 +58,223 @@ Shader::Shader(std::filesystem::path vs_path, std::filesystem::path fs_path) {
     vs_stream << vs_file.rdbuf();
     fs_stream << fs_file.rdbuf();
 
-    vs_file.close();
-    fs_file.close();
+    build(vs_stream.str(), fs_stream.str(), nullptr);
+}
 
-    vs_code = vs_stream.str();
-    fs_code = fs_stream.str();
+Shader Shader::from_sources(std::string_view vs_source, std::string_view fs_source, const ProgramCache* cache) {
+    Shader shader;
+    shader.build(vs_source, fs_source, cache);
+    return shader;
+}
 
-    const char* cstr_vs = vs_code.c_str();
-    const char* cstr_fs = fs_code.c_str();
+Shader Shader::embedded(std::string_view vs_name, std::string_view fs_name, const ProgramCache* cache) {
+    return from_sources(shader_source(vs_name), shader_source(fs_name), cache);
+}
 
-    unsigned int vs_id, fs_id;
-    
-    vs_id = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vs_id, 1, &cstr_vs, NULL);
-    glCompileShader(vs_id);
-    check_compile_error(vs_id, "Vertex");
+void Shader::build(std::string_view vs_source, std::string_view fs_source, const ProgramCache* cache) {
+    id = glCreateProgram();
 
-    fs_id = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fs_id, 1, &cstr_fs, NULL);
-    glCompileShader(fs_id);
-    check_compile_error(fs_id, "Fragment");
+    uint64_t key = 0;
+    if (cache && ProgramCache::supported()) {
+        key = ProgramCache::key(vs_source, fs_source);
+        from_cache = cache->load(id, key);
+    } else {
+        cache = nullptr;
+    }
 
-    id = glCreateProgram();
-    glAttachShader(id, vs_id);
-    glAttachShader(id, fs_id);
-    glLinkProgram(id);
-    check_compile_error(id, "Program");
+    if (!from_cache) {
+        const char* cstr_vs = vs_source.data();
+        const char* cstr_fs = fs_source.data();
+        GLint vs_length = static_cast<GLint>(vs_source.size());
+        GLint fs_length = static_cast<GLint>(fs_source.size());
+
+        unsigned int vs_id, fs_id;
+
+        vs_id = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vs_id, 1, &cstr_vs, &vs_length);
+        glCompileShader(vs_id);
+        check_compile_error(vs_id, "Vertex");
+
+        fs_id = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fs_id, 1, &cstr_fs, &fs_length);
+        glCompileShader(fs_id);
+        check_compile_error(fs_id, "Fragment");
+
+        glAttachShader(id, vs_id);
+        glAttachShader(id, fs_id);
+        if (cache) {
+            glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glLinkProgram(id);
+        check_compile_error(id, "Program");
+
+        glDetachShader(id, vs_id);
+        glDetachShader(id, fs_id);
+        glDeleteShader(vs_id);
+        glDeleteShader(fs_id);
+
+        if (cache) {
+            cache->store(id, key);
+        }
+    }
+
+    reflect();
+}
+
+void Shader::reflect() {
+    // Reflect once so setters never go through glGetUniformLocation
+    GLint count = 0, max_length = 0;
+    glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+    std::string name(std::max(max_length, 1), '\0');
+    for (GLint i = 0; i < count; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(id, static_cast<GLuint>(i), max_length, &length, &size, &type, name.data());
+        std::string uniform(name.data(), length);
+        // Members of uniform blocks have no location
+        GLint uniform_location = glGetUniformLocation(id, uniform.c_str());
+        if (uniform_location < 0) {
+            continue;
+        }
+        if (uniform.ends_with("[0]")) {
+            uniforms.emplace(uniform.substr(0, uniform.size() - 3), uniform_location);
+        }
+        uniforms.emplace(std::move(uniform), uniform_location);
+    }
+
+    GLuint camera_block = glGetUniformBlockIndex(id, "Camera");
+    if (camera_block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(id, camera_block, CAMERA_BINDING);
+    }
+}
+
+Shader::~Shader() {
+    if (id) {
+        glDeleteProgram(id);
+    }
+}
+
+Shader::Shader(Shader&& other) noexcept
+    : id(std::exchange(other.id, 0)), uniforms(std::move(other.uniforms)), from_cache(other.from_cache) {
+}
 
-    glDeleteShader(vs_id);
-    glDeleteShader(fs_id);
+Shader& Shader::operator=(Shader&& other) noexcept {
+    if (this != &other) {
+        if (id) {
+            glDeleteProgram(id);
+        }
+        id = std::exchange(other.id, 0);
+        uniforms = std::move(other.uniforms);
+        from_cache = other.from_cache;
+    }
+    return *this;
 }
 
 void Shader::use() {
     glUseProgram(id);
 }
 
+GLint Shader::location(std::string_view name) const {
+    auto it = uniforms.find(name);
+    return it == uniforms.end() ? -1 : it->second;
+}
+
 void Shader::set_bool(std::string_view name, bool value) const {
-    glUniform1i(glGetUniformLocation(id, name.data()), (int) value);
+    set_bool(location(name), value);
 }
 
 void Shader::set_int(std::string_view name, int value) const {
-    glUniform1i(glGetUniformLocation(id, name.data()), value);
+    set_int(location(name), value);
 }
 
 void Shader::set_float(std::string_view name, float value) const {
-    glUniform1f(glGetUniformLocation(id, name.data()), value);
+    set_float(location(name), value);
 }
 
 void Shader::set_vec2(std::string_view name, glm::vec2 value) const {
-    glUniform2fv(glGetUniformLocation(id, name.data()), 1, &value[0]);
+    set_vec2(location(name), value);
 }
 
 void Shader::set_vec2(std::string_view name, float x, float y) const {
-    glUniform2f(glGetUniformLocation(id, name.data()), x, y);
+    set_vec2(location(name), x, y);
 }
 
 void Shader::set_vec3(std::string_view name, glm::vec3 value) const {
-    glUniform3fv(glGetUniformLocation(id, name.data()), 1, &value[0]);
+    set_vec3(location(name), value);
 }
 
 void Shader::set_vec3(std::string_view name, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(id, name.data()), x, y, z);
+    set_vec3(location(name), x, y, z);
 }
 
 void Shader::set_vec4(std::string_view name, glm::vec4 value) const {
-    glUniform4fv(glGetUniformLocation(id, name.data()), 1, &value[0]);
+    set_vec4(location(name), value);
 }
 
 void Shader::set_vec4(std::string_view name, float x, float y, float z, float w) const {
-    glUniform4f(glGetUniformLocation(id, name.data()), x, y, z, w);
+    set_vec4(location(name), x, y, z, w);
 }
 
 void Shader::set_mat2(std::string_view name, glm::mat2 value) const {
-    glUniformMatrix2fv(glGetUniformLocation(id, name.data()), 1, GL_FALSE, &value[0][0]);
+    set_mat2(location(name), value);
 }
 
 void Shader::set_mat3(std::string_view name, glm::mat3 value) const {
-    glUniformMatrix3fv(glGetUniformLocation(id, name.data()), 1, GL_FALSE, &value[0][0]);
+    set_mat3(location(name), value);
 }
 
 void Shader::set_mat4(std::string_view name, glm::mat4 value) const {
-    glUniformMatrix4fv(glGetUniformLocation(id, name.data()), 1, GL_FALSE, &value[0][0]);
+    set_mat4(location(name), value);
+}
+
+void Shader::set_bool(GLint location, bool value) const {
+    glUniform1i(location, (int) value);
+}
+
+void Shader::set_int(GLint location, int value) const {
+    glUniform1i(location, value);
+}
+
+void Shader::set_float(GLint location, float value) const {
+    glUniform1f(location, value);
+}
+
+void Shader::set_vec2(GLint location, glm::vec2 value) const {
+    glUniform2fv(location, 1, &value[0]);
+}
+
+void Shader::set_vec2(GLint location, float x, float y) const {
+    glUniform2f(location, x, y);
+}
+
+void Shader::set_vec3(GLint location, glm::vec3 value) const {
+    glUniform3fv(location, 1, &value[0]);
+}
+
+void Shader::set_vec3(GLint location, float x, float y, float z) const {
+    glUniform3f(location, x, y, z);
+}
+
+void Shader::set_vec4(GLint location, glm::vec4 value) const {
+    glUniform4fv(location, 1, &value[0]);
+}
+
+void Shader::set_vec4(GLint location, float x, float y, float z, float w) const {
+    glUniform4f(location, x, y, z, w);
+}
+
+void Shader::set_mat2(GLint location, glm::mat2 value) const {
+    glUniformMatrix2fv(location, 1, GL_FALSE, &value[0][0]);
+}
+
+void Shader::set_mat3(GLint location, glm::mat3 value) const {
+    glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]);
+}
+
+void Shader::set_mat4(GLint location, glm::mat4 value) const {
+    glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
 }
 
 void Shader::check_compile_error(GLuint id, std::string type) const {
@@ -131,97 +296,239 @@ void Shader::check_compile_error(GLuint id, std::string type) const {
     }
 }
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices) : vertices(vertices), indices(indices) {
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+CameraUniforms::CameraUniforms() {
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BINDING, buffer);
+}
 
-    glBindVertexArray(VAO);
+CameraUniforms::~CameraUniforms() {
+    glDeleteBuffers(1, &buffer);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+void CameraUniforms::update(const glm::mat4& view, const glm::mat4& projection) {
+    CameraBlock block{view, projection};
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+MeshData process_stl(const std::filesystem::path& stl_path, const MeshLoadOptions& options) {
+    StlLoadOptions stl_options;
+    stl_options.threads = options.threads;
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) 0);
+    StlLoadResult stl = load_stl(stl_path, stl_options);
+    if (stl.truncated()) {
+        std::cerr << "Warning: " << stl_path << " is truncated, recovered " << stl.recovered_triangles
+                  << " of " << stl.declared_triangles << " triangles\n";
+    }
 
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, color));
+    MeshData data;
+    data.vertices = std::move(stl.vertices);
+    data.indices.resize(data.vertices.size());
+    std::iota(data.indices.begin(), data.indices.end(), 0u);
 
-    glBindVertexArray(0);
-}
+    data.stats.declared_triangles = stl.declared_triangles;
+    data.stats.loaded_triangles = stl.recovered_triangles;
+    data.stats.vertices_before_weld = data.vertices.size();
+    data.stats.vertices_after_weld = data.vertices.size();
 
-Mesh::Mesh(std::filesystem::path stl_path) {
-    if (!std::filesystem::exists(stl_path)) {
-        throw std::runtime_error("STL file not found");
-    }
+    if (options.weld) {
+        WeldStats weld = weld_vertices(data.vertices, data.indices, options.weld_epsilon);
+        data.stats.vertices_after_weld = weld.vertices_after;
+
+        // Simplified before creases are split, so both sides of a hard edge collapse together
+        if (!options.lod_ratios.empty()) {
+            data.lods = build_lod_chain(data.vertices, data.indices, options.lod_ratios);
+        }
+
+        // Creases add vertices, so this runs before the optimizer sees the final set
+        if (options.normals == NormalMode::Smooth) {
+            const size_t welded_count = data.vertices.size();
+            std::vector<unsigned int> welded_indices;
+            if (!data.lods.empty()) {
+                welded_indices = data.indices;
+            }
+            data.stats.crease_vertices = compute_smooth_normals(data.vertices, data.indices, options.crease_angle,
+                                                                options.threads);
+            assign_crease_copies(data.vertices, welded_count, welded_indices, data.indices, data.lods);
+        }
 
-    std::ifstream file(stl_path, std::ios::binary);
-    if (!file) {
-        throw std::runtime_error("Error: Could not open the file");
+        if (options.optimize) {
+            data.stats.cache_before = analyze_vertex_cache(data.indices, data.vertices.size());
+            optimize_vertex_cache(data.indices, data.vertices.size());
+            std::vector<unsigned int> remap = optimize_vertex_fetch(data.vertices, data.indices);
+            data.stats.cache_after = analyze_vertex_cache(data.indices, data.vertices.size());
+
+            // Every vertex a LOD uses is used by the full mesh too, so none were dropped
+            for (MeshLod& lod : data.lods) {
+                for (unsigned int& i : lod.indices) {
+                    i = remap[i];
+                }
+                optimize_vertex_cache(lod.indices, data.vertices.size());
+            }
+        }
     }
 
-    file.seekg(80, std::ios::beg);
-    if (!file) {
-        throw std::runtime_error("Failed to skip past header");
+    return data;
+}
+
+MeshData load_mesh_data(const std::filesystem::path& stl_path, const MeshLoadOptions& options) {
+    if (options.cache) {
+        if (auto entry = options.cache->find(stl_path, options)) {
+            MeshData data;
+            data.vertices.assign(entry->vertices().begin(), entry->vertices().end());
+            data.indices.assign(entry->indices().begin(), entry->indices().end());
+            data.stats = entry->stats();
+            return data;
+        }
     }
+    return process_stl(stl_path, options);
+}
 
-    std::array<char, 4> buffer;
+void setup_vertex_attributes(VertexLayout layout, size_t offset) {
+    GLsizei stride = static_cast<GLsizei>(vertex_stride(layout));
 
-    file.read(buffer.data(), buffer.size());
-    if (!file) {
-        throw std::runtime_error("Failed to read triangle count");
+    glEnableVertexAttribArray(0);
+    if (layout_is_quantized(layout)) {
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*) offset);
+    } else {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*) offset);
     }
 
-    unsigned int triangle_count;
-    std::memcpy(&triangle_count, buffer.data(), sizeof(triangle_count));
+    if (layout_has_normal(layout)) {
+        size_t normal_offset = layout_is_quantized(layout) ? 8 : 12;
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*) (offset + normal_offset));
+    } else {
+        glDisableVertexAttribArray(1);
+    }
+}
 
-    vertices.reserve(triangle_count * 3);
-    indices.reserve(triangle_count * 3);
+void setup_instance_attributes(size_t offset) {
+    for (GLuint column = 0; column < 4; ++column) {
+        GLuint location = INSTANCE_MODEL_LOCATION + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              (void*) (offset + offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+    }
+    glEnableVertexAttribArray(POSITION_OFFSET_LOCATION);
+    glVertexAttribPointer(POSITION_OFFSET_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                          (void*) (offset + offsetof(InstanceData, position_offset)));
+    glVertexAttribDivisor(POSITION_OFFSET_LOCATION, 1);
+    glEnableVertexAttribArray(POSITION_SCALE_LOCATION);
+    glVertexAttribPointer(POSITION_SCALE_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                          (void*) (offset + offsetof(InstanceData, position_scale)));
+    glVertexAttribDivisor(POSITION_SCALE_LOCATION, 1);
+}
 
-    int index = 0;
+void set_model_matrix(const glm::mat4& model) {
+    for (GLuint column = 0; column < 4; ++column) {
+        glVertexAttrib4fv(INSTANCE_MODEL_LOCATION + column, glm::value_ptr(model) + column * 4);
+    }
+}
 
-    while (triangle_count > 0) {
-        // Skip normal vector (12 bytes)
-        file.seekg(12, std::ios::cur);
+void set_dequantization(VertexLayout layout, const Bounds& bounds) {
+    glm::vec3 offset = position_offset(layout, bounds);
+    glm::vec3 scale = position_scale(layout, bounds);
+    glVertexAttrib3f(POSITION_OFFSET_LOCATION, offset.x, offset.y, offset.z);
+    glVertexAttrib3f(POSITION_SCALE_LOCATION, scale.x, scale.y, scale.z);
+}
 
-        for (int v = 0; v < 3; ++v) {
-            float x, y, z;
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, const MeshLoadOptions& options)
+    : vertices(std::move(vertices)), indices(std::move(indices)), layout(options.layout) {
+    upload(build_gpu_mesh(this->vertices, this->indices, layout, options.split_16bit).view());
+    if (!options.keep_cpu_data) {
+        release_cpu_data();
+    }
+}
 
-            // Read x, y, z coordinates
-            file.read(buffer.data(), buffer.size());
-            if (!file) break;
-            std::memcpy(&x, buffer.data(), sizeof(float));
+PreparedMesh::PreparedMesh() = default;
+PreparedMesh::PreparedMesh(PreparedMesh&& other) noexcept = default;
+PreparedMesh& PreparedMesh::operator=(PreparedMesh&& other) noexcept = default;
+PreparedMesh::~PreparedMesh() = default;
 
-            file.read(buffer.data(), buffer.size());
-            if (!file) break;
-            std::memcpy(&y, buffer.data(), sizeof(float));
+GpuMeshView PreparedMesh::gpu_view() const {
+    return entry ? entry->gpu_view() : gpu.view();
+}
+
+std::span<const Vertex> PreparedMesh::vertices() const {
+    return entry ? entry->vertices() : std::span<const Vertex>(data.vertices);
+}
 
-            file.read(buffer.data(), buffer.size());
-            if (!file) break;
-            std::memcpy(&z, buffer.data(), sizeof(float));
+std::span<const unsigned int> PreparedMesh::indices() const {
+    return entry ? entry->indices() : std::span<const unsigned int>(data.indices);
+}
 
-            // Push vertex with hardcoded color
-            // std::cout << "Triangle: " << triangle_count << " x, y, z " << x << " " << y << " " << z << "\n";
-            vertices.push_back({glm::vec3(x, y, z), glm::vec3(0.3, 0.5, 0.4)});
+MeshStats PreparedMesh::stats() const {
+    return entry ? entry->stats() : data.stats;
+}
 
-            indices.push_back(index++);
+PreparedMesh prepare_mesh(const std::filesystem::path& stl_path, const MeshLoadOptions& options) {
+    PreparedMesh prepared;
+    if (options.cache) {
+        prepared.entry = options.cache->find(stl_path, options);
+        if (prepared.entry) {
+            return prepared;
         }
+    }
+
+    prepared.data = process_stl(stl_path, options);
+    prepared.gpu = build_gpu_mesh(prepared.data.vertices, prepared.data.indices, options.layout, options.split_16bit,
+                                  prepared.data.lods);
+    if (options.cache) {
+        options.cache->store(stl_path, options, prepared.gpu, prepared.data.vertices, prepared.data.indices,
+                             prepared.data.stats);
+    }
+    return prepared;
+}
 
-        // Skip attribute byte count (2 bytes)
-        file.seekg(2, std::ios::cur);
+std::vector<PreparedMesh> prepare_meshes(const std::vector<std::filesystem::path>& stl_paths,
+                                         const MeshLoadOptions& options) {
+    std::vector<PreparedMesh> prepared(stl_paths.size());
+    TaskGroup tasks;
+    for (size_t i = 0; i < stl_paths.size(); ++i) {
+        tasks.run([&, i] { prepared[i] = prepare_mesh(stl_paths[i], options); });
+    }
+    tasks.wait();
+    return prepared;
+}
 
-        --triangle_count;
+Mesh::Mesh(std::filesystem::path stl_path, const MeshLoadOptions& options)
+    : Mesh(prepare_mesh(stl_path, options), options) {
+}
 
-        if (!file) {
-            std::cerr << "Error reading file data\n";
-            break;
+Mesh::Mesh(PreparedMesh prepared, const MeshLoadOptions& options) : layout(options.layout) {
+    if (prepared.entry) {
+        if (options.keep_cpu_data) {
+            vertices.assign(prepared.entry->vertices().begin(), prepared.entry->vertices().end());
+            indices.assign(prepared.entry->indices().begin(), prepared.entry->indices().end());
         }
+        stats = prepared.entry->stats();
+        from_cache = true;
+        upload(prepared.entry->gpu_view());
+        return;
     }
 
-    file.close();
+    vertices = std::move(prepared.data.vertices);
+    indices = std::move(prepared.data.indices);
+    stats = prepared.data.stats;
+    upload(prepared.gpu.view());
+    if (!options.keep_cpu_data) {
+        release_cpu_data();
+    }
+}
+
+void Mesh::upload(const GpuMeshView& data) {
+    layout = data.layout;
+    bounds = data.bounds;
+    index_type = data.index_size == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    submeshes.assign(data.submeshes.begin(), data.submeshes.end());
+    lods.assign(data.lods.begin(), data.lods.end());
+    if (lods.empty()) {
+        lods.push_back({0, static_cast<unsigned int>(submeshes.size()), 0.0f});
+    }
 
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
@@ -230,28 +537,79 @@ Mesh::Mesh(std::filesystem::path stl_path) {
     glBindVertexArray(VAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, data.vertex_data.size(), data.vertex_data.data(), GL_STATIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.index_data.size(), data.index_data.data(), GL_STATIC_DRAW);
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) 0);
-
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, color));
+    setup_vertex_attributes(layout);
 
     glBindVertexArray(0);
+}
 
+Mesh::~Mesh() {
+    release_gpu_data();
 }
 
+Mesh::Mesh(Mesh&& other) noexcept
+    : vertices(std::move(other.vertices)), indices(std::move(other.indices)), VAO(std::exchange(other.VAO, 0)),
+      layout(other.layout), bounds(other.bounds), stats(other.stats), from_cache(other.from_cache),
+      VBO(std::exchange(other.VBO, 0)), EBO(std::exchange(other.EBO, 0)), index_type(other.index_type),
+      submeshes(std::move(other.submeshes)), lods(std::move(other.lods)) {
+}
 
-Mesh::~Mesh() {
+Mesh& Mesh::operator=(Mesh&& other) noexcept {
+    if (this != &other) {
+        release_gpu_data();
+        vertices = std::move(other.vertices);
+        indices = std::move(other.indices);
+        VAO = std::exchange(other.VAO, 0);
+        layout = other.layout;
+        bounds = other.bounds;
+        stats = other.stats;
+        from_cache = other.from_cache;
+        VBO = std::exchange(other.VBO, 0);
+        EBO = std::exchange(other.EBO, 0);
+        index_type = other.index_type;
+        submeshes = std::move(other.submeshes);
+        lods = std::move(other.lods);
+    }
+    return *this;
+}
 
+void Mesh::release_cpu_data() {
+    // swap with empty vectors, clear() alone keeps the allocation
+    std::vector<Vertex>().swap(vertices);
+    std::vector<unsigned int>().swap(indices);
 }
 
-void Mesh::draw() const {
+void Mesh::release_gpu_data() {
+    // Deleting name 0 is a no-op, moved-from meshes are safe
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    VAO = VBO = EBO = 0;
+}
+
+size_t Mesh::triangle_count(size_t lod) const {
+    if (lod >= lods.size()) {
+        return 0;
+    }
+    size_t count = 0;
+    for (unsigned int i = 0; i < lods[lod].submesh_count; ++i) {
+        count += submeshes[lods[lod].first_submesh + i].index_count;
+    }
+    return count / 3;
+}
+
+void Mesh::draw(size_t lod) const {
+    set_dequantization(layout, bounds);
+
     glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+    const LodRange& range = lods[lod];
+    for (unsigned int i = 0; i < range.submesh_count; ++i) {
+        const Submesh& sub = submeshes[range.first_submesh + i];
+        glDrawElementsBaseVertex(GL_TRIANGLES, sub.index_count, index_type, (void*) sub.index_offset, sub.base_vertex);
+    }
     glBindVertexArray(0);
 }
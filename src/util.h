@@ -6,14 +6,70 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <vector>
 #include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <span>
+#include "vertex.h"
+#include "gpu_mesh.h"
+#include "normals.h"
+#include "optimize.h"
+#include "simplify.h"
+
+// Hashes string_view and string alike so lookups by string_view don't allocate
+struct StringHash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view text) const { return std::hash<std::string_view>{}(text); }
+};
+
+// Binding point of the Camera uniform block, shared by every program
+constexpr GLuint CAMERA_BINDING = 0;
+
+// std140 layout of the Camera uniform block in the shaders
+struct CameraBlock {
+    glm::mat4 view;
+    glm::mat4 projection;
+};
+
+class ProgramCache;
+
+// GLSL source of a file in src/shaders, built into the executable so it runs from any
+// directory. Setting STL_VIEWER_SHADER_DIR reads the files from there instead, for
+// editing shaders without rebuilding.
+std::string shader_source(std::string_view name);
 
 struct Shader {
-    unsigned int id; // shader id
+    unsigned int id = 0; // shader id
+    // Locations of the active default block uniforms, reflected once at link time.
+    // Arrays are listed both as "name[0]" and "name".
+    std::unordered_map<std::string, GLint, StringHash, std::equal_to<>> uniforms;
+    bool from_cache = false;    // linked from a program binary rather than compiled
 
     Shader(std::filesystem::path vs_path, std::filesystem::path fs_path);
 
+    // Compiles and links the sources. With a cache, a binary stored by an earlier run on
+    // the same driver is loaded instead, and a freshly linked program is stored for the next.
+    static Shader from_sources(std::string_view vs_source, std::string_view fs_source,
+                               const ProgramCache* cache = nullptr);
+
+    // from_sources with shader_source(vs_name) and shader_source(fs_name)
+    static Shader embedded(std::string_view vs_name, std::string_view fs_name, const ProgramCache* cache = nullptr);
+
+    ~Shader();
+
+    // Owns the GL program, so it moves but never copies
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+    Shader(Shader&& other) noexcept;
+    Shader& operator=(Shader&& other) noexcept;
+
     void use();
 
+    // Cached location, -1 like glGetUniformLocation when the program has no such uniform
+    GLint location(std::string_view name) const;
+
     void set_bool(std::string_view name, bool value) const;
 
     void set_int(std::string_view name, int value) const;
@@ -38,30 +94,207 @@ struct Shader {
 
     void set_mat4(std::string_view name, glm::mat4 value) const;
 
+    // By a location from location(), skipping the name lookup for uniforms set every frame
+    void set_bool(GLint location, bool value) const;
+
+    void set_int(GLint location, int value) const;
+
+    void set_float(GLint location, float value) const;
+
+    void set_vec2(GLint location, glm::vec2 value) const;
+
+    void set_vec2(GLint location, float x, float y) const;
+
+    void set_vec3(GLint location, glm::vec3 value) const;
+
+    void set_vec3(GLint location, float x, float y, float z) const;
+
+    void set_vec4(GLint location, glm::vec4 value) const;
+
+    void set_vec4(GLint location, float x, float y, float z, float w) const;
+
+    void set_mat2(GLint location, glm::mat2 value) const;
+
+    void set_mat3(GLint location, glm::mat3 value) const;
+
+    void set_mat4(GLint location, glm::mat4 value) const;
+
     void check_compile_error(GLuint id, std::string type) const;
+
+private:
+    Shader() = default;
+
+    void build(std::string_view vs_source, std::string_view fs_source, const ProgramCache* cache);
+
+    // Uniform locations and block bindings, which a loaded binary needs as much as a fresh link
+    void reflect();
+};
+
+// One uniform buffer with the per frame camera, bound at CAMERA_BINDING. Programs pick
+// it up through their Camera block, so view and projection are set once per frame
+// rather than per program or per draw.
+class CameraUniforms {
+    public:
+        CameraUniforms();
+
+        ~CameraUniforms();
+
+        CameraUniforms(const CameraUniforms&) = delete;
+        CameraUniforms& operator=(const CameraUniforms&) = delete;
+
+        void update(const glm::mat4& view, const glm::mat4& projection);
+
+    private:
+        GLuint buffer = 0;
 };
 
-struct Vertex {
-    glm::vec3 position;
-    glm::vec3 color;
+class MeshCache;
+
+struct MeshLoadOptions {
+    unsigned int threads = 0;   // worker threads for loading, 0 uses every core
+    VertexLayout layout = VertexLayout::PositionNormal;
+    bool weld = true;           // merge shared corners into an indexed mesh
+    float weld_epsilon = 0.0f;  // weld grid size, 0 merges identical positions only
+    NormalMode normals = NormalMode::Smooth;    // Smooth needs weld, unwelded meshes keep file normals
+    float crease_angle = 30.0f; // degrees between faces beyond which Smooth keeps an edge hard
+    bool split_16bit = true;    // split large meshes into 16 bit indexed submeshes
+    bool optimize = true;       // reorder triangles and vertices for cache locality, needs weld
+    const MeshCache* cache = nullptr;   // reuse processed buffers from earlier loads
+    bool keep_cpu_data = true;  // keep vertices/indices in RAM after upload
+    std::vector<float> lod_ratios;  // simplified levels as fractions of the triangle count, needs weld
 };
 
+struct MeshStats {
+    unsigned int declared_triangles = 0;
+    unsigned int loaded_triangles = 0;
+    size_t vertices_before_weld = 0;
+    size_t vertices_after_weld = 0;
+    size_t crease_vertices = 0;     // copies added to keep creases hard with smooth normals
+    VertexCacheStats cache_before;
+    VertexCacheStats cache_after;
+};
+
+// CPU side of a loaded mesh, everything Mesh(path) does before touching GL
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<MeshLod> lods;      // empty when served from the cache, which only keeps their GPU form
+    MeshStats stats;
+};
+
+// Parses, welds and optimizes an STL as the options ask, ignoring the cache
+MeshData process_stl(const std::filesystem::path& stl_path, const MeshLoadOptions& options = {});
+
+// Like process_stl but served from options.cache when it holds a valid entry
+MeshData load_mesh_data(const std::filesystem::path& stl_path, const MeshLoadOptions& options = {});
+
+class MeshCacheEntry;
+
+// The CPU side of Mesh(path): a cache hit, or processed geometry with its GPU buffers
+// built. Safe to produce on worker threads, only the Mesh constructor needs GL.
+struct PreparedMesh {
+    std::unique_ptr<MeshCacheEntry> entry;  // set on a cache hit, data and gpu stay empty
+    MeshData data;
+    GpuMeshData gpu;
+
+    // Whichever of entry or data/gpu is set
+    GpuMeshView gpu_view() const;
+    std::span<const Vertex> vertices() const;
+    std::span<const unsigned int> indices() const;
+    MeshStats stats() const;
+
+    PreparedMesh();
+    PreparedMesh(PreparedMesh&& other) noexcept;
+    PreparedMesh& operator=(PreparedMesh&& other) noexcept;
+    ~PreparedMesh();
+};
+
+// Cache lookup or processing, storing the result in options.cache on a miss
+PreparedMesh prepare_mesh(const std::filesystem::path& stl_path, const MeshLoadOptions& options = {});
+
+// prepare_mesh for every path as parallel tasks, results in the order of `stl_paths`
+std::vector<PreparedMesh> prepare_meshes(const std::vector<std::filesystem::path>& stl_paths,
+                                         const MeshLoadOptions& options = {});
+
+// Enables and points the attributes of `layout` at the bound GL_ARRAY_BUFFER
+void setup_vertex_attributes(VertexLayout layout, size_t offset = 0);
+
+// Per instance (or per indirect draw, through baseInstance) vertex shader inputs. The
+// dequantization of the mesh travels with the model matrix so draws sharing one VAO can
+// mix meshes.
+struct InstanceData {
+    glm::mat4 model;
+    glm::vec4 position_offset;  // xyz used, see position_offset()
+    glm::vec4 position_scale;
+};
+
+// Attribute locations of InstanceData, the model matrix takes four
+constexpr GLuint INSTANCE_MODEL_LOCATION = 3;
+constexpr GLuint POSITION_OFFSET_LOCATION = 7;
+constexpr GLuint POSITION_SCALE_LOCATION = 8;
+
+// Points the instance attributes at packed InstanceData in the bound GL_ARRAY_BUFFER
+void setup_instance_attributes(size_t offset = 0);
+
+// Model matrix for draws without an instance buffer, kept as the attribute's current value
+void set_model_matrix(const glm::mat4& model);
+
+// Dequantization for draws without an instance buffer, as for set_model_matrix
+void set_dequantization(VertexLayout layout, const Bounds& bounds);
+
+// Owns its VAO, VBO and EBO. The CPU side vertices/indices are empty when loaded with
+// keep_cpu_data = false or after release_cpu_data().
 class Mesh {
     public:
         std::vector<Vertex> vertices;
         std::vector<unsigned int> indices;
-        unsigned int VAO;
+        unsigned int VAO = 0;
+        VertexLayout layout;
+        Bounds bounds;
+        MeshStats stats;
+        bool from_cache = false;
+
+        // Takes the buffers as they are, only layout, split_16bit and keep_cpu_data apply.
+        // Pass with std::move to avoid copying.
+        Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, const MeshLoadOptions& options = {});
 
-        Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices);
+        Mesh(std::filesystem::path stl_path, const MeshLoadOptions& options = {});
 
-        Mesh(std::filesystem::path stl_path);
+        // Uploads what prepare_mesh produced, only layout and keep_cpu_data apply
+        Mesh(PreparedMesh prepared, const MeshLoadOptions& options = {});
 
         ~Mesh();
 
-        void draw() const;
+        Mesh(const Mesh&) = delete;
+        Mesh& operator=(const Mesh&) = delete;
+        Mesh(Mesh&& other) noexcept;
+        Mesh& operator=(Mesh&& other) noexcept;
+
+        // Frees the CPU copies, the GPU buffers are all draw() needs
+        void release_cpu_data();
+
+        // Level 0 is the full mesh, further levels are coarser with growing error
+        size_t lod_count() const { return lods.size(); }
+
+        float lod_error(size_t lod) const { return lods[lod].error; }
+
+        size_t triangle_count(size_t lod = 0) const;
+
+        size_t submesh_count(size_t lod = 0) const { return lods[lod].submesh_count; }
+
+        // Sets the dequantization for the layout, then draws with the model matrix from
+        // set_model_matrix()
+        void draw(size_t lod = 0) const;
 
     private:
-        unsigned int VBO, EBO;
+        unsigned int VBO = 0, EBO = 0;
+        GLenum index_type = GL_UNSIGNED_SHORT;
+        std::vector<Submesh> submeshes;
+        std::vector<LodRange> lods;
+
+        void upload(const GpuMeshView& data);
+
+        void release_gpu_data();
 };
 
 #endif
\ No newline at end of file
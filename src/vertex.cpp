@@ -0,0 +1,113 @@
+#include "vertex.h"
+#include "parallel.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+Bounds compute_bounds(const std::vector<Vertex>& vertices) {
+    Bounds bounds;
+    if (vertices.empty()) {
+        return bounds;
+    }
+
+    bounds.min = bounds.max = vertices[0].position;
+    for (const Vertex& v : vertices) {
+        bounds.min = glm::min(bounds.min, v.position);
+        bounds.max = glm::max(bounds.max, v.position);
+    }
+    return bounds;
+}
+
+size_t vertex_stride(VertexLayout layout) {
+    switch (layout) {
+        case VertexLayout::Position: return 12;
+        case VertexLayout::PositionNormal: return 16;
+        case VertexLayout::QuantizedPosition: return 8;
+        case VertexLayout::QuantizedPositionNormal: return 12;
+    }
+    return 0;
+}
+
+bool layout_has_normal(VertexLayout layout) {
+    return layout == VertexLayout::PositionNormal || layout == VertexLayout::QuantizedPositionNormal;
+}
+
+bool layout_is_quantized(VertexLayout layout) {
+    return layout == VertexLayout::QuantizedPosition || layout == VertexLayout::QuantizedPositionNormal;
+}
+
+glm::vec3 position_offset(VertexLayout layout, const Bounds& bounds) {
+    return layout_is_quantized(layout) ? bounds.min : glm::vec3(0.0f);
+}
+
+glm::vec3 position_scale(VertexLayout layout, const Bounds& bounds) {
+    return layout_is_quantized(layout) ? bounds.extent() : glm::vec3(1.0f);
+}
+
+glm::vec2 encode_octahedral(glm::vec3 n) {
+    float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if (l1 == 0.0f) {
+        return glm::vec2(0.0f, 0.0f);
+    }
+    n /= l1;
+
+    // Fold the lower hemisphere over the diagonals
+    if (n.z < 0.0f) {
+        float x = (1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+        float y = (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+        return glm::vec2(x, y);
+    }
+    return glm::vec2(n.x, n.y);
+}
+
+glm::vec3 decode_octahedral(glm::vec2 e) {
+    glm::vec3 n(e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+    float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
+
+static int16_t to_snorm16(float v) {
+    return static_cast<int16_t>(std::lround(std::clamp(v, -1.0f, 1.0f) * 32767.0f));
+}
+
+static uint16_t to_unorm16(float v) {
+    return static_cast<uint16_t>(std::lround(std::clamp(v, 0.0f, 1.0f) * 65535.0f));
+}
+
+std::vector<unsigned char> pack_vertices(const std::vector<Vertex>& vertices, VertexLayout layout, const Bounds& bounds) {
+    const size_t stride = vertex_stride(layout);
+    std::vector<unsigned char> packed(vertices.size() * stride, 0);
+
+    // Flat axes have zero extent, they all quantize to 0 and dequantize to the minimum
+    glm::vec3 extent = bounds.extent();
+    glm::vec3 inv_extent(extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+                         extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+                         extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+
+    parallel_for(vertices.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const Vertex& v = vertices[i];
+            unsigned char* out = packed.data() + i * stride;
+            size_t normal_offset = 12;
+
+            if (layout_is_quantized(layout)) {
+                glm::vec3 t = (v.position - bounds.min) * inv_extent;
+                uint16_t q[3] = {to_unorm16(t.x), to_unorm16(t.y), to_unorm16(t.z)};
+                std::memcpy(out, q, sizeof(q));
+                normal_offset = 8;
+            } else {
+                std::memcpy(out, &v.position, sizeof(float) * 3);
+            }
+
+            if (layout_has_normal(layout)) {
+                glm::vec2 e = encode_octahedral(v.normal);
+                int16_t s[2] = {to_snorm16(e.x), to_snorm16(e.y)};
+                std::memcpy(out + normal_offset, s, sizeof(s));
+            }
+        }
+    });
+
+    return packed;
+}
@@ -0,0 +1,52 @@
+#ifndef VERTEX_H
+#define VERTEX_H
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Full precision vertex kept on the CPU, GPU buffers hold one of the packed layouts below
+struct Vertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+};
+
+enum class VertexLayout {
+    Position,                   // 3 x float32, 12 bytes
+    PositionNormal,             // 3 x float32, octahedral normal as 2 x snorm16, 16 bytes
+    QuantizedPosition,          // 3 x unorm16 over the mesh bounds, 2 bytes padding, 8 bytes
+    QuantizedPositionNormal,    // 3 x unorm16, 2 bytes padding, octahedral normal, 12 bytes
+};
+
+struct Bounds {
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+
+    glm::vec3 extent() const { return max - min; }
+};
+
+Bounds compute_bounds(const std::vector<Vertex>& vertices);
+
+size_t vertex_stride(VertexLayout layout);
+
+bool layout_has_normal(VertexLayout layout);
+
+bool layout_is_quantized(VertexLayout layout);
+
+// Quantized layouts store positions as [0, 1] over the bounds, the vertex shader maps
+// them back with position * position_scale + position_offset
+glm::vec3 position_offset(VertexLayout layout, const Bounds& bounds);
+
+glm::vec3 position_scale(VertexLayout layout, const Bounds& bounds);
+
+// Encodes a unit vector onto the octahedron, both components in [-1, 1]
+glm::vec2 encode_octahedral(glm::vec3 n);
+
+glm::vec3 decode_octahedral(glm::vec2 e);
+
+// Packs vertices into the byte layout uploaded to the VBO
+std::vector<unsigned char> pack_vertices(const std::vector<Vertex>& vertices, VertexLayout layout, const Bounds& bounds);
+
+#endif
@@ -0,0 +1,98 @@
+#include "weld.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+struct CellKey {
+    int64_t x, y, z;
+
+    bool operator==(const CellKey& o) const { return x == o.x && y == o.y && z == o.z; }
+};
+
+CellKey cell_of(const glm::vec3& p, float inv_epsilon) {
+    if (inv_epsilon == 0.0f) {
+        // Exact mode keys on the bit pattern, + 0.0f folds -0 into +0
+        uint32_t bits[3];
+        float xyz[3] = {p.x + 0.0f, p.y + 0.0f, p.z + 0.0f};
+        std::memcpy(bits, xyz, sizeof(bits));
+        return {bits[0], bits[1], bits[2]};
+    }
+    return {std::llround(p.x * inv_epsilon), std::llround(p.y * inv_epsilon), std::llround(p.z * inv_epsilon)};
+}
+
+uint64_t hash_cell(const CellKey& k) {
+    uint64_t h = static_cast<uint64_t>(k.x) * 0x9E3779B97F4A7C15ull;
+    h ^= static_cast<uint64_t>(k.y) * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+    h ^= static_cast<uint64_t>(k.z) * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+    return h ^ (h >> 29);
+}
+
+}
+
+WeldStats weld_vertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, float epsilon) {
+    WeldStats stats;
+    stats.vertices_before = vertices.size();
+
+    const float inv_epsilon = epsilon > 0.0f ? 1.0f / epsilon : 0.0f;
+    constexpr unsigned int EMPTY = ~0u;
+
+    // Open addressing table holding indices of surviving vertices, kept under half full
+    size_t capacity = 16;
+    while (capacity < vertices.size() * 2) {
+        capacity <<= 1;
+    }
+    std::vector<unsigned int> table(capacity, EMPTY);
+    std::vector<CellKey> survivor_keys;
+    survivor_keys.reserve(vertices.size());
+
+    std::vector<unsigned int> remap(vertices.size());
+    size_t survivors = 0;
+
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        CellKey key = cell_of(vertices[i].position, inv_epsilon);
+        size_t slot = hash_cell(key) & (capacity - 1);
+
+        while (table[slot] != EMPTY && !(survivor_keys[table[slot]] == key)) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+
+        if (table[slot] == EMPTY) {
+            table[slot] = static_cast<unsigned int>(survivors);
+            survivor_keys.push_back(key);
+            // Survivors are compacted in place, always at or before their source slot
+            vertices[survivors++] = vertices[i];
+        } else {
+            vertices[table[slot]].normal += vertices[i].normal;
+        }
+        remap[i] = table[slot];
+    }
+    vertices.resize(survivors);
+    vertices.shrink_to_fit();
+
+    for (Vertex& v : vertices) {
+        float length = glm::length(v.normal);
+        if (length > 0.0f) {
+            v.normal /= length;
+        }
+    }
+
+    size_t out = 0;
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        unsigned int a = remap[indices[t]];
+        unsigned int b = remap[indices[t + 1]];
+        unsigned int c = remap[indices[t + 2]];
+        if (a == b || b == c || a == c) {
+            ++stats.degenerate_triangles;
+            continue;
+        }
+        indices[out++] = a;
+        indices[out++] = b;
+        indices[out++] = c;
+    }
+    indices.resize(out);
+
+    stats.vertices_after = vertices.size();
+    return stats;
+}
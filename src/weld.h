@@ -0,0 +1,21 @@
+#ifndef WELD_H
+#define WELD_H
+
+#include <cstddef>
+#include <vector>
+#include "vertex.h"
+
+struct WeldStats {
+    size_t vertices_before = 0;
+    size_t vertices_after = 0;
+    size_t degenerate_triangles = 0;    // dropped because two corners collapsed together
+};
+
+// Collapses vertices whose positions snap to the same cell of an epsilon sized grid and
+// rewrites indices to reference the survivor, the first vertex seen in each cell.
+// Survivor normals become the normalized sum of everything merged into them.
+// An epsilon of 0 merges bit-identical positions only. Triangles that lose a corner
+// to the merge are removed.
+WeldStats weld_vertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, float epsilon);
+
+#endif
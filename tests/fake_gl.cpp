@@ -0,0 +1,120 @@
+#include "fake_gl.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace fake_gl {
+
+namespace {
+
+std::vector<unsigned char>& bound_buffer(GLenum target) {
+    auto it = state().buffers.find(state().bound[target]);
+    if (it == state().buffers.end()) {
+        throw std::logic_error("fake GL: no buffer bound to the target");
+    }
+    return it->second;
+}
+
+void APIENTRY gen_buffers(GLsizei n, GLuint* names) {
+    for (GLsizei i = 0; i < n; ++i) {
+        names[i] = state().next_name++;
+        state().buffers[names[i]];
+    }
+}
+
+void APIENTRY delete_buffers(GLsizei n, const GLuint* names) {
+    for (GLsizei i = 0; i < n; ++i) {
+        state().buffers.erase(names[i]);
+    }
+}
+
+void APIENTRY bind_buffer(GLenum target, GLuint name) {
+    state().bound[target] = name;
+}
+
+void APIENTRY buffer_data(GLenum target, GLsizeiptr size, const void* data, GLenum) {
+    std::vector<unsigned char>& buffer = bound_buffer(target);
+    buffer.assign(static_cast<size_t>(size), 0);
+    if (data) {
+        std::memcpy(buffer.data(), data, static_cast<size_t>(size));
+    }
+}
+
+void APIENTRY buffer_sub_data(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+    std::vector<unsigned char>& buffer = bound_buffer(target);
+    if (offset < 0 || size < 0 || static_cast<size_t>(offset + size) > buffer.size()) {
+        throw std::logic_error("fake GL: glBufferSubData out of range");
+    }
+    std::memcpy(buffer.data() + offset, data, static_cast<size_t>(size));
+}
+
+void APIENTRY copy_buffer_sub_data(GLenum read, GLenum write, GLintptr read_offset, GLintptr write_offset,
+                                   GLsizeiptr size) {
+    std::vector<unsigned char>& from = bound_buffer(read);
+    std::vector<unsigned char>& to = bound_buffer(write);
+    if (static_cast<size_t>(read_offset + size) > from.size() || static_cast<size_t>(write_offset + size) > to.size()) {
+        throw std::logic_error("fake GL: glCopyBufferSubData out of range");
+    }
+    std::memmove(to.data() + write_offset, from.data() + read_offset, static_cast<size_t>(size));
+}
+
+void APIENTRY gen_vertex_arrays(GLsizei n, GLuint* names) {
+    for (GLsizei i = 0; i < n; ++i) {
+        names[i] = state().next_name++;
+        ++state().vertex_arrays;
+    }
+}
+
+void APIENTRY delete_vertex_arrays(GLsizei n, const GLuint* names) {
+    for (GLsizei i = 0; i < n; ++i) {
+        state().vertex_arrays -= names[i] != 0;
+    }
+}
+
+void APIENTRY gen_queries(GLsizei n, GLuint* names) {
+    for (GLsizei i = 0; i < n; ++i) {
+        names[i] = state().next_name++;
+        ++state().queries;
+    }
+}
+
+void APIENTRY delete_queries(GLsizei n, const GLuint* names) {
+    for (GLsizei i = 0; i < n; ++i) {
+        state().queries -= names[i] != 0;
+    }
+}
+
+void APIENTRY get_integerv(GLenum name, GLint* out) {
+    if (name != GL_VIEWPORT) {
+        throw std::logic_error("fake GL: glGetIntegerv of an unsupported value");
+    }
+    std::copy(state().viewport, state().viewport + 4, out);
+}
+
+}
+
+State& state() {
+    static State s;
+    return s;
+}
+
+void install() {
+    state() = State();
+    glad_glGenBuffers = gen_buffers;
+    glad_glDeleteBuffers = delete_buffers;
+    glad_glBindBuffer = bind_buffer;
+    glad_glBufferData = buffer_data;
+    glad_glBufferSubData = buffer_sub_data;
+    glad_glCopyBufferSubData = copy_buffer_sub_data;
+    glad_glGenVertexArrays = gen_vertex_arrays;
+    glad_glDeleteVertexArrays = delete_vertex_arrays;
+    glad_glBindVertexArray = [](GLuint) {};
+    glad_glEnableVertexAttribArray = [](GLuint) {};
+    glad_glDisableVertexAttribArray = [](GLuint) {};
+    glad_glVertexAttribPointer = [](GLuint, GLint, GLenum, GLboolean, GLsizei, const void*) {};
+    glad_glGenQueries = gen_queries;
+    glad_glDeleteQueries = delete_queries;
+    glad_glGetIntegerv = get_integerv;
+}
+
+}
@@ -0,0 +1,30 @@
+#ifndef FAKE_GL_H
+#define FAKE_GL_H
+
+#include <cstddef>
+#include <map>
+#include <vector>
+#include <glad/glad.h>
+
+// Stand-ins for the GL entry points MeshArena and Scene use outside of drawing, so their
+// CPU side runs without a context. Buffers are byte arrays in memory, queries never finish.
+namespace fake_gl {
+
+struct State {
+    std::map<GLuint, std::vector<unsigned char>> buffers;   // live buffers by name
+    std::map<GLenum, GLuint> bound;                         // buffer bound to each target
+    GLuint next_name = 1;
+    size_t vertex_arrays = 0;   // live
+    size_t queries = 0;         // live
+    GLint viewport[4] = {0, 0, 800, 600};
+};
+
+State& state();
+
+// Resets the state and points glad's function pointers at the fakes, until a real context
+// loads over them
+void install();
+
+}
+
+#endif
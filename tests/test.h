@@ -0,0 +1,43 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "vertex.h"
+
+// Counts a failure and prints the expression when `ok` is false, the test keeps running
+void check(bool ok, const char* expression, const char* file, int line);
+
+#define CHECK(expression) check(static_cast<bool>(expression), #expression, __FILE__, __LINE__)
+
+// Thrown by a test that can't run here, such as the GL comparison without a display
+struct Skipped {
+    std::string reason;
+};
+
+struct TestRegistration {
+    TestRegistration(const char* name, void (*run)());
+};
+
+// Defines a test and registers it with the runner, which runs every test in name order
+#define TEST(name)                                                          \
+    static void test_##name();                                              \
+    static const TestRegistration register_##name(#name, test_##name);      \
+    static void test_##name()
+
+// Scratch directory for files a test writes, removed when the run ends
+std::filesystem::path scratch_directory();
+
+// Axis aligned cube as a triangle soup, counter-clockwise seen from outside, every corner
+// carrying its face normal
+std::vector<Vertex> make_cube(glm::vec3 origin, float size);
+
+// Closed UV sphere of radius 1 as a soup with the facet normal on every corner
+std::vector<Vertex> make_sphere(int stacks, int slices);
+
+std::vector<unsigned int> sequential_indices(size_t count);
+
+#endif
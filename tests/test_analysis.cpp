@@ -0,0 +1,95 @@
+#include "test.h"
+#include "analysis.h"
+#include "weld.h"
+#include <cmath>
+#include <utility>
+
+TEST(analyze_cube) {
+    std::vector<Vertex> cube = make_cube(glm::vec3(-2.0f, 3.0f, 0.5f), 1.0f);
+    std::vector<unsigned int> indices = sequential_indices(cube.size());
+
+    MeshAnalysis closed = analyze_mesh(cube, indices);
+    CHECK(closed.triangles == 12);
+    CHECK(closed.vertices == 8);
+    CHECK(closed.edges == 18);
+    CHECK(closed.open_edges == 0);
+    CHECK(closed.non_manifold_edges == 0);
+    CHECK(closed.degenerate_triangles == 0);
+    CHECK(closed.watertight());
+    CHECK(std::abs(closed.volume - 1.0) < 1e-6);
+    CHECK(std::abs(closed.surface_area - 6.0) < 1e-6);
+    CHECK(closed.bounds.min == glm::vec3(-2.0f, 3.0f, 0.5f));
+    CHECK(closed.bounds.max == glm::vec3(-1.0f, 4.0f, 1.5f));
+
+    // Same answer welded, and on one thread
+    std::vector<Vertex> welded = cube;
+    std::vector<unsigned int> welded_indices = indices;
+    weld_vertices(welded, welded_indices, 0.0f);
+    MeshAnalysis from_welded = analyze_mesh(welded, welded_indices, 1);
+    CHECK(from_welded.edges == 18);
+    CHECK(from_welded.open_edges == 0);
+    CHECK(from_welded.volume == analyze_mesh(welded, welded_indices, 8).volume);
+
+    // Turned inside out the volume goes negative
+    std::vector<unsigned int> flipped = indices;
+    for (size_t t = 0; t < flipped.size(); t += 3) {
+        std::swap(flipped[t + 1], flipped[t + 2]);
+    }
+    CHECK(std::abs(analyze_mesh(cube, flipped).volume + 1.0) < 1e-6);
+
+    // One triangle missing opens its three edges
+    std::vector<unsigned int> open(indices.begin(), indices.end() - 3);
+    MeshAnalysis holed = analyze_mesh(cube, open);
+    CHECK(holed.triangles == 11);
+    CHECK(holed.edges == 18);
+    CHECK(holed.open_edges == 3);
+    CHECK(!holed.watertight());
+
+    // A whole face missing opens its four outer edges, the diagonal goes with it
+    std::vector<unsigned int> no_face(indices.begin() + 6, indices.end());
+    MeshAnalysis topless = analyze_mesh(cube, no_face);
+    CHECK(topless.edges == 17);
+    CHECK(topless.open_edges == 4);
+
+    // A third triangle on the same edges makes them non-manifold
+    std::vector<unsigned int> fin = indices;
+    fin.insert(fin.end(), {0, 1, 2});
+    MeshAnalysis finned = analyze_mesh(cube, fin);
+    CHECK(finned.non_manifold_edges == 3);
+    CHECK(!finned.watertight());
+
+    std::vector<Vertex> flat = {{{0, 0, 0}, {0, 0, 1}}, {{1, 0, 0}, {0, 0, 1}}, {{2, 0, 0}, {0, 0, 1}}};
+    CHECK(analyze_mesh(flat, sequential_indices(3)).degenerate_triangles == 1);
+}
+
+// Large enough to be split into many partitions, a soup with split normals, a hole and a
+// fin counts the same as its welded form on any number of threads
+TEST(analyze_threads) {
+    std::vector<Vertex> soup = make_sphere(120, 160);
+    for (size_t i = 0; i < soup.size(); ++i) {
+        soup[i].normal = glm::vec3(0.0f, 0.0f, i % 2 ? 1.0f : -1.0f);
+    }
+    std::vector<unsigned int> soup_indices = sequential_indices(soup.size());
+    // Drop a triangle, and cover another one again back to front so its edges are used three times
+    soup_indices.erase(soup_indices.begin() + 3000, soup_indices.begin() + 3003);
+    soup_indices.insert(soup_indices.end(), {6000, 6002, 6001});
+
+    std::vector<Vertex> welded = soup;
+    std::vector<unsigned int> welded_indices = soup_indices;
+    weld_vertices(welded, welded_indices, 0.0f);
+    const MeshAnalysis reference = analyze_mesh(welded, welded_indices, 1);
+    CHECK(reference.open_edges == 3);
+    CHECK(reference.non_manifold_edges == 3);
+    CHECK(reference.vertices == 2 + 119 * 160);
+
+    for (unsigned int threads : {1u, 2u, 3u, 8u, 16u}) {
+        MeshAnalysis analysis = analyze_mesh(soup, soup_indices, threads);
+        CHECK(analysis.vertices == reference.vertices);
+        CHECK(analysis.edges == reference.edges);
+        CHECK(analysis.open_edges == reference.open_edges);
+        CHECK(analysis.non_manifold_edges == reference.non_manifold_edges);
+        CHECK(analysis.degenerate_triangles == reference.degenerate_triangles);
+        CHECK(analysis.surface_area == reference.surface_area);
+        CHECK(analysis.volume == reference.volume);
+    }
+}
@@ -0,0 +1,150 @@
+#include "test.h"
+#include "arena.h"
+#include "fake_gl.h"
+#include "simplify.h"
+#include "weld.h"
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+struct Part {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<MeshLod> lods;
+    GpuMeshData gpu;
+};
+
+Part welded(std::vector<Vertex> soup, VertexLayout layout, bool split, std::vector<float> lod_ratios = {}) {
+    Part part;
+    part.vertices = std::move(soup);
+    part.indices = sequential_indices(part.vertices.size());
+    weld_vertices(part.vertices, part.indices, 0.0f);
+    if (!lod_ratios.empty()) {
+        part.lods = build_lod_chain(part.vertices, part.indices, lod_ratios);
+    }
+    part.gpu = build_gpu_mesh(part.vertices, part.indices, layout, split, part.lods);
+    return part;
+}
+
+// Corner positions of one level of an arena mesh, read back through its commands the way
+// the GPU would fetch them
+std::vector<glm::vec3> fetch(const MeshArena& arena, size_t mesh, size_t lod, unsigned int index_size) {
+    const std::vector<unsigned char>& vertex_buffer = fake_gl::state().buffers[fake_gl::state().bound[GL_ARRAY_BUFFER]];
+    const std::vector<unsigned char>& index_buffer =
+        fake_gl::state().buffers[fake_gl::state().bound[GL_ELEMENT_ARRAY_BUFFER]];
+    const size_t stride = vertex_stride(arena.vertex_layout());
+    const ArenaMesh& entry = arena.mesh(mesh);
+    std::vector<glm::vec3> positions;
+    const LodRange& range = entry.lods[lod];
+    for (unsigned int s = range.first_submesh; s < range.first_submesh + range.submesh_count; ++s) {
+        const DrawElementsIndirectCommand& command = entry.submeshes[s];
+        for (GLuint i = command.first_index; i < command.first_index + command.count; ++i) {
+            if ((i + 1) * index_size > index_buffer.size()) {
+                return {};
+            }
+            uint32_t index = 0;
+            if (index_size == 2) {
+                uint16_t narrow;
+                std::memcpy(&narrow, index_buffer.data() + i * 2, 2);
+                index = narrow;
+            } else {
+                std::memcpy(&index, index_buffer.data() + i * 4, 4);
+            }
+            size_t vertex = static_cast<size_t>(index + command.base_vertex);
+            if ((vertex + 1) * stride > vertex_buffer.size()) {
+                return {};
+            }
+            glm::vec3 p;
+            std::memcpy(&p, vertex_buffer.data() + vertex * stride, sizeof(p));
+            positions.push_back(p);
+        }
+    }
+    return positions;
+}
+
+std::vector<glm::vec3> expected(const Part& part, size_t lod) {
+    const std::vector<unsigned int>& indices = lod == 0 ? part.indices : part.lods[lod - 1].indices;
+    std::vector<glm::vec3> positions;
+    for (unsigned int i : indices) {
+        positions.push_back(part.vertices[i].position);
+    }
+    return positions;
+}
+
+}
+
+// Small meshes' 16 bit indices are widened into a 32 bit arena next to a mesh too big for
+// them, and every level draws the same triangles after the buffers have grown many times
+TEST(arena_widening) {
+    fake_gl::install();
+    std::vector<Part> parts;
+    for (int i = 0; i < 6; ++i) {
+        parts.push_back(welded(make_cube(glm::vec3(i * 2.0f, 0.0f, 0.0f), 1.0f), VertexLayout::PositionNormal, false));
+    }
+    parts.push_back(welded(make_sphere(200, 400), VertexLayout::PositionNormal, false));
+    parts.push_back(welded(make_sphere(30, 40), VertexLayout::PositionNormal, false, {0.5f, 0.1f}));
+    parts.push_back(welded(make_cube(glm::vec3(-3.0f), 0.5f), VertexLayout::PositionNormal, false));
+    CHECK(parts[6].gpu.index_size == 4 && parts[6].vertices.size() > MAX_SUBMESH_VERTICES);
+    CHECK(parts[0].gpu.index_size == 2 && parts[7].gpu.index_size == 2);
+    CHECK(parts[7].lods.size() == 2);
+
+    {
+        MeshArena arena(VertexLayout::PositionNormal, 4, 64, 32);
+        for (const Part& part : parts) {
+            arena.add(part.gpu.view());
+        }
+        CHECK(arena.size() == parts.size());
+        CHECK(fake_gl::state().buffers.size() == 2);
+        CHECK(fake_gl::state().vertex_arrays == 1);
+        for (size_t m = 0; m < parts.size(); ++m) {
+            CHECK(arena.mesh(m).lods.size() == parts[m].lods.size() + 1);
+            for (size_t lod = 0; lod <= parts[m].lods.size(); ++lod) {
+                CHECK(fetch(arena, m, lod, 4) == expected(parts[m], lod));
+                CHECK(arena.mesh(m).triangle_count(lod) == expected(parts[m], lod).size() / 3);
+            }
+        }
+
+        // Too wide for this arena, or packed differently
+        MeshArena narrow(VertexLayout::PositionNormal, 2);
+        CHECK(narrow.add(parts[0].gpu.view()) == 0);
+        bool threw = false;
+        try {
+            narrow.add(parts[6].gpu.view());
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        CHECK(threw);
+        threw = false;
+        try {
+            arena.add(welded(make_cube(glm::vec3(0.0f), 1.0f), VertexLayout::Position, false).gpu.view());
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        CHECK(threw);
+        CHECK(arena.size() == parts.size());
+    }
+    CHECK(fake_gl::state().buffers.empty());
+    CHECK(fake_gl::state().vertex_arrays == 0);
+}
+
+// With split meshes the arena keeps 16 bit indices and each chunk gets its own base vertex
+TEST(arena_split_meshes) {
+    fake_gl::install();
+    std::vector<Part> parts;
+    parts.push_back(welded(make_cube(glm::vec3(0.0f), 1.0f), VertexLayout::PositionNormal, true));
+    parts.push_back(welded(make_sphere(200, 400), VertexLayout::PositionNormal, true, {0.5f}));
+    parts.push_back(welded(make_cube(glm::vec3(2.0f), 1.0f), VertexLayout::PositionNormal, true));
+    CHECK(parts[1].gpu.index_size == 2 && parts[1].gpu.submeshes.size() > 2);
+
+    MeshArena arena(VertexLayout::PositionNormal, 2, 1024, 1024);
+    for (const Part& part : parts) {
+        arena.add(part.gpu.view());
+    }
+    for (size_t m = 0; m < parts.size(); ++m) {
+        for (size_t lod = 0; lod <= parts[m].lods.size(); ++lod) {
+            CHECK(fetch(arena, m, lod, 2) == expected(parts[m], lod));
+        }
+    }
+}
@@ -0,0 +1,147 @@
+#include "test.h"
+#include "batch.h"
+#include "stl.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+std::filesystem::path touch(const std::filesystem::path& path) {
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream(path) << "solid empty\nendsolid empty\n";
+    return path;
+}
+
+}
+
+TEST(glob_match) {
+    CHECK(glob_match("*.stl", "part.stl"));
+    CHECK(!glob_match("*.stl", "part.STL"));
+    CHECK(!glob_match("*.stl", "parts/part.stl"));
+    CHECK(glob_match("parts/*.stl", "parts/part.stl"));
+    CHECK(glob_match("part?.stl", "part7.stl"));
+    CHECK(!glob_match("part?.stl", "part.stl"));
+    CHECK(!glob_match("a?b", "a/b"));
+    CHECK(glob_match("**/*.stl", "part.stl"));
+    CHECK(glob_match("**/*.stl", "a/b/c/part.stl"));
+    CHECK(glob_match("parts/**/gear*.stl", "parts/gear1.stl"));
+    CHECK(glob_match("parts/**/gear*.stl", "parts/a/b/gear1.stl"));
+    CHECK(!glob_match("parts/**/gear*.stl", "other/a/gear1.stl"));
+    CHECK(glob_match("parts/**", "parts/a/b.stl"));
+    CHECK(glob_match("", ""));
+    CHECK(!glob_match("", "a"));
+}
+
+// Directories, patterns and lists expand in the order given, each sorted within itself
+TEST(expand_inputs) {
+    const std::filesystem::path root = scratch_directory() / "inputs";
+    const std::filesystem::path a = touch(root / "a.stl");
+    const std::filesystem::path c = touch(root / "b" / "c.stl");
+    const std::filesystem::path d = touch(root / "b" / "d.STL");
+    const std::filesystem::path gear = touch(root / "b" / "gear1.stl");
+    touch(root / "b" / "notes.txt");
+
+    CHECK(expand_inputs({root.string()}) == std::vector<std::filesystem::path>({a, c, d, gear}));
+    CHECK(expand_inputs({(root / "b" / "*.stl").string()}) == std::vector<std::filesystem::path>({c, gear}));
+    CHECK(expand_inputs({(root / "**" / "g*.stl").string()}) == std::vector<std::filesystem::path>({gear}));
+    CHECK(expand_inputs({(root / "nothing*.stl").string()}).empty());
+
+    const std::filesystem::path list = root / "list.txt";
+    std::ofstream(list) << "# parts\n" << gear.string() << "\n\n  " << a.string() << "  # again\n"
+                        << (root / "missing.stl").string() << "\n";
+    std::vector<std::filesystem::path> listed = expand_inputs({c.string(), "@" + list.string(), (root / "b").string()});
+    CHECK(listed == std::vector<std::filesystem::path>({c, gear, a, root / "missing.stl", c, d, gear}));
+    CHECK(expand_inputs({"@" + (root / "no_list.txt").string()}).empty());
+}
+
+// Reports come out in input order whichever file finishes first, bad inputs are counted
+// and skipped
+TEST(analyze_files) {
+    const std::filesystem::path root = scratch_directory() / "analyze";
+    std::filesystem::create_directories(root);
+    std::vector<Vertex> closed = make_cube(glm::vec3(0.0f), 1.0f);
+    std::vector<Vertex> open(closed.begin(), closed.end() - 3);
+
+    BatchOptions options;
+    options.jobs = 3;
+    for (int i = 0; i < 12; ++i) {
+        std::filesystem::path path = root / ("part" + std::to_string(i) + ".stl");
+        if (i == 4) {
+            path = root / "missing.stl";
+        } else if (i == 7) {
+            std::ofstream(path) << "not an stl";
+        } else {
+            // Larger files early, so the small ones later in the list finish first
+            std::vector<Vertex> mesh = i % 5 == 3 ? open : i < 3 ? make_sphere(120, 160) : closed;
+            write_stl(path, mesh);
+        }
+        options.inputs.push_back(path);
+    }
+
+    std::ostringstream out;
+    BatchReport report = analyze_files(options, out);
+    CHECK(report.files == 10);
+    CHECK(report.failures == 2);
+    CHECK(report.flagged == 2);
+    const std::string text = out.str();
+    size_t previous = 0;
+    for (size_t i = 0; i < options.inputs.size(); ++i) {
+        size_t at = text.find(options.inputs[i].string() + "\n");
+        if (i == 4 || i == 7) {
+            CHECK(at == std::string::npos);
+            continue;
+        }
+        CHECK(at != std::string::npos && at >= previous);
+        previous = at;
+    }
+}
+
+// Binary to ASCII and back gives the same triangles, and two inputs with one stem are refused
+TEST(convert_files) {
+    const std::filesystem::path root = scratch_directory() / "convert";
+    std::filesystem::create_directories(root / "in");
+    BatchOptions options;
+    std::vector<std::vector<Vertex>> meshes;
+    for (int i = 0; i < 5; ++i) {
+        meshes.push_back(make_sphere(10 + i, 12 + i));
+        options.inputs.push_back(root / "in" / ("part" + std::to_string(i) + ".stl"));
+        write_stl(options.inputs.back(), meshes.back());
+    }
+    options.inputs.push_back(root / "in" / "missing.stl");
+    options.jobs = 2;
+
+    BatchReport report = convert_files(options, root / "ascii", true);
+    CHECK(report.files == 5 && report.failures == 1);
+    options.inputs.pop_back();
+    for (std::filesystem::path& input : options.inputs) {
+        input = root / "ascii" / input.filename();
+    }
+    report = convert_files(options, root / "binary", false);
+    CHECK(report.files == 5 && report.failures == 0);
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        StlLoadResult ascii = load_stl(options.inputs[i]);
+        StlLoadResult binary = load_stl(root / "binary" / options.inputs[i].filename());
+        CHECK(ascii.ascii && !binary.ascii);
+        CHECK(binary.vertices.size() == meshes[i].size());
+        bool positions = binary.vertices.size() == meshes[i].size();
+        for (size_t v = 0; v < binary.vertices.size() && positions; ++v) {
+            positions = binary.vertices[v].position == meshes[i][v].position;
+        }
+        CHECK(positions);
+    }
+
+    // Converting a directory onto itself is refused per file
+    report = convert_files(options, root / "ascii", true);
+    CHECK(report.files == 0 && report.failures == 5);
+
+    options.inputs.push_back(root / "other" / "part0.stl");
+    bool threw = false;
+    try {
+        convert_files(options, root / "again", false);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
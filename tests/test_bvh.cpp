@@ -0,0 +1,160 @@
+#include "test.h"
+#include "bvh.h"
+#include "weld.h"
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <random>
+
+namespace {
+
+struct BruteHit {
+    uint32_t triangle;
+    double t;
+};
+
+// Möller-Trumbore in double against every triangle
+std::optional<BruteHit> brute_force(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                                    glm::dvec3 origin, glm::dvec3 direction, double t_min, double t_max) {
+    std::optional<BruteHit> best;
+    for (size_t t = 0; t < indices.size() / 3; ++t) {
+        glm::dvec3 v0(vertices[indices[t * 3]].position);
+        glm::dvec3 e1 = glm::dvec3(vertices[indices[t * 3 + 1]].position) - v0;
+        glm::dvec3 e2 = glm::dvec3(vertices[indices[t * 3 + 2]].position) - v0;
+        glm::dvec3 p = glm::cross(direction, e2);
+        double det = glm::dot(e1, p);
+        if (std::abs(det) < 1e-14) {
+            continue;
+        }
+        glm::dvec3 s = origin - v0;
+        double u = glm::dot(s, p) / det;
+        glm::dvec3 q = glm::cross(s, e1);
+        double v = glm::dot(direction, q) / det;
+        double hit = glm::dot(e2, q) / det;
+        if (u < 0.0 || v < 0.0 || u + v > 1.0 || hit < t_min || hit > t_max) {
+            continue;
+        }
+        if (!best || hit < best->t) {
+            best = BruteHit{static_cast<uint32_t>(t), hit};
+        }
+    }
+    return best;
+}
+
+// Two spheres, one inside the other, and a scatter of loose triangles crossing both
+void test_mesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    vertices = make_sphere(90, 120);
+    for (Vertex v : make_sphere(20, 30)) {
+        v.position = v.position * 0.5f + glm::vec3(0.1f, -0.2f, 0.05f);
+        vertices.push_back(v);
+    }
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> unit(-1.5f, 1.5f);
+    for (int i = 0; i < 300; ++i) {
+        glm::vec3 a(unit(random), unit(random), unit(random));
+        for (int c = 0; c < 3; ++c) {
+            vertices.push_back({a + glm::vec3(unit(random), unit(random), unit(random)) * 0.2f, glm::vec3(0.0f)});
+        }
+    }
+    indices = sequential_indices(vertices.size());
+    weld_vertices(vertices, indices, 0.0f);
+}
+
+}
+
+// Closest hits agree with testing every triangle, for rays from outside, inside and
+// along the axes
+TEST(bvh_matches_brute_force) {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    test_mesh(vertices, indices);
+    Bvh serial(vertices, indices, 1);
+    Bvh parallel(vertices, indices, 8);
+    CHECK(serial.stats().leaves > 1);
+
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    size_t hits = 0, misses = 0;
+    for (int r = 0; r < 2000; ++r) {
+        glm::vec3 origin, target;
+        if (r % 3 == 0) {
+            origin = glm::vec3(unit(random), unit(random), unit(random)) * 0.3f;
+        } else {
+            origin = glm::vec3(unit(random), unit(random), unit(random)) * 4.0f;
+        }
+        target = glm::vec3(unit(random), unit(random), unit(random)) * 1.6f;
+        glm::vec3 direction = target - origin;
+        if (r % 7 == 0) {
+            direction = glm::vec3(0.0f);
+            direction[r % 3] = r % 2 ? 1.0f : -1.0f;
+        }
+        float t_min = r % 5 == 0 ? 0.5f : 0.0f;
+        float t_max = r % 11 == 0 ? 1.0f : 3.402823466e+38f;
+
+        std::optional<BruteHit> expected = brute_force(vertices, indices, glm::dvec3(origin), glm::dvec3(direction),
+                                                       t_min, t_max);
+        for (const Bvh* bvh : {&serial, &parallel}) {
+            std::optional<RayHit> hit = bvh->intersect(origin, direction, t_min, t_max);
+            CHECK(hit.has_value() == expected.has_value());
+            if (!hit || !expected) {
+                continue;
+            }
+            CHECK(std::abs(hit->t - expected->t) <= 1e-4 * std::max(1.0, expected->t));
+            // Where triangles share the hit point either one may be reported, as long as it is hit there
+            if (hit->triangle != expected->triangle && hit->triangle < indices.size() / 3) {
+                std::vector<unsigned int> reported(indices.begin() + hit->triangle * 3,
+                                                   indices.begin() + hit->triangle * 3 + 3);
+                std::optional<BruteHit> own = brute_force(vertices, reported, glm::dvec3(origin),
+                                                          glm::dvec3(direction), t_min - 1e-4, t_max + 1e-4);
+                CHECK(own && std::abs(own->t - expected->t) <= 1e-4 * std::max(1.0, expected->t));
+            }
+            CHECK(glm::length(hit->point - (origin + direction * hit->t)) < 1e-4f);
+        }
+        hits += expected.has_value();
+        misses += !expected.has_value();
+    }
+    CHECK(hits > 500 && misses > 100);
+}
+
+// Every triangle sits in exactly one leaf, and every node's box holds its children
+TEST(bvh_structure) {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    test_mesh(vertices, indices);
+    Bvh bvh(vertices, indices, 4);
+    const std::vector<BvhNode>& nodes = bvh.nodes();
+    CHECK(bvh.stats().nodes == nodes.size());
+
+    auto contains = [](const BvhNode& outer, const BvhNode& inner) {
+        for (int a = 0; a < 3; ++a) {
+            if (inner.bounds_min[a] < outer.bounds_min[a] || inner.bounds_max[a] > outer.bounds_max[a]) {
+                return false;
+            }
+        }
+        return true;
+    };
+    std::vector<int> covered(indices.size() / 3, 0);
+    size_t leaves = 0;
+    std::vector<uint32_t> stack = {0};
+    while (!stack.empty()) {
+        const BvhNode& node = nodes[stack.back()];
+        stack.pop_back();
+        if (node.count > 0) {
+            ++leaves;
+            for (uint32_t i = node.first; i < node.first + node.count && i < covered.size(); ++i) {
+                ++covered[i];
+            }
+            continue;
+        }
+        if (node.first + 1 >= nodes.size()) {
+            CHECK(!"child index out of range");
+            continue;
+        }
+        CHECK(contains(node, nodes[node.first]));
+        CHECK(contains(node, nodes[node.first + 1]));
+        stack.push_back(node.first);
+        stack.push_back(node.first + 1);
+    }
+    CHECK(leaves == bvh.stats().leaves);
+    CHECK(std::count(covered.begin(), covered.end(), 1) == static_cast<std::ptrdiff_t>(covered.size()));
+}
@@ -0,0 +1,146 @@
+// Runner for the tests in this directory, each file covering one part of the viewer
+//
+// STLTests [NAME...]     runs every test, or only those whose name contains one of NAME
+
+#include "test.h"
+#include "mesh_cache.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+
+struct Test {
+    const char* name;
+    void (*run)();
+};
+
+std::vector<Test>& registry() {
+    static std::vector<Test> tests;
+    return tests;
+}
+
+size_t failed_checks = 0;
+
+}
+
+void check(bool ok, const char* expression, const char* file, int line) {
+    if (!ok) {
+        std::cerr << file << ":" << line << ": check failed: " << expression << "\n";
+        ++failed_checks;
+    }
+}
+
+TestRegistration::TestRegistration(const char* name, void (*run)()) {
+    registry().push_back({name, run});
+}
+
+std::filesystem::path scratch_directory() {
+    static const std::filesystem::path dir = [] {
+        std::filesystem::path path = unique_temp_path(std::filesystem::temp_directory_path() / "stl_tests");
+        std::filesystem::create_directories(path);
+        return path;
+    }();
+    return dir;
+}
+
+std::vector<Vertex> make_cube(glm::vec3 origin, float size) {
+    std::vector<Vertex> vertices;
+    for (int axis = 0; axis < 3; ++axis) {
+        for (float side : {-1.0f, 1.0f}) {
+            glm::vec3 normal(0.0f), u(0.0f), v(0.0f);
+            normal[axis] = side;
+            u[(axis + 1) % 3] = size;
+            v[(axis + 2) % 3] = size;
+            if (side < 0.0f) {
+                std::swap(u, v);
+            }
+            glm::vec3 center = origin + glm::vec3(size * 0.5f) + normal * (size * 0.5f);
+            glm::vec3 p[4] = {center - u * 0.5f - v * 0.5f, center + u * 0.5f - v * 0.5f,
+                              center + u * 0.5f + v * 0.5f, center - u * 0.5f + v * 0.5f};
+            for (int corner : {0, 1, 2, 0, 2, 3}) {
+                vertices.push_back({p[corner], normal});
+            }
+        }
+    }
+    return vertices;
+}
+
+std::vector<Vertex> make_sphere(int stacks, int slices) {
+    // Poles and the seam are exact so the mesh welds closed
+    auto point = [&](int i, int j) {
+        if (i == 0 || i == stacks) {
+            return glm::vec3(0.0f, 0.0f, i == 0 ? 1.0f : -1.0f);
+        }
+        float theta = 3.14159265f * i / stacks;
+        float phi = 6.28318531f * (j % slices) / slices;
+        return glm::vec3(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta));
+    };
+    std::vector<Vertex> vertices;
+    auto triangle = [&](glm::vec3 a, glm::vec3 b, glm::vec3 c) {
+        glm::vec3 n = glm::cross(b - a, c - a);
+        n = glm::length(n) > 0.0f ? glm::normalize(n) : glm::vec3(0.0f, 0.0f, 1.0f);
+        vertices.insert(vertices.end(), {{a, n}, {b, n}, {c, n}});
+    };
+    for (int i = 0; i < stacks; ++i) {
+        for (int j = 0; j < slices; ++j) {
+            glm::vec3 a = point(i, j), b = point(i + 1, j), c = point(i + 1, j + 1), d = point(i, j + 1);
+            if (i > 0) {
+                triangle(a, b, d);
+            }
+            if (i + 1 < stacks) {
+                triangle(d, b, c);
+            }
+        }
+    }
+    return vertices;
+}
+
+std::vector<unsigned int> sequential_indices(size_t count) {
+    std::vector<unsigned int> indices(count);
+    std::iota(indices.begin(), indices.end(), 0u);
+    return indices;
+}
+
+int main(int argc, char** argv) {
+    std::vector<Test>& tests = registry();
+    std::sort(tests.begin(), tests.end(), [](const Test& a, const Test& b) {
+        return std::string_view(a.name) < std::string_view(b.name);
+    });
+
+    size_t failed = 0, skipped = 0, ran = 0;
+    for (const Test& test : tests) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; ++i) {
+            selected = selected || std::string_view(test.name).find(argv[i]) != std::string_view::npos;
+        }
+        if (!selected) {
+            continue;
+        }
+
+        ++ran;
+        size_t before = failed_checks;
+        try {
+            test.run();
+        } catch (const Skipped& skip) {
+            std::cout << "skip " << test.name << ": " << skip.reason << "\n";
+            ++skipped;
+            continue;
+        } catch (const std::exception& e) {
+            std::cerr << test.name << ": unexpected exception: " << e.what() << "\n";
+            ++failed_checks;
+        }
+        bool ok = failed_checks == before;
+        failed += !ok;
+        std::cout << (ok ? "pass " : "FAIL ") << test.name << "\n";
+    }
+
+    std::error_code ec;
+    std::filesystem::remove_all(scratch_directory(), ec);
+
+    std::cout << ran - failed - skipped << " passed, " << failed << " failed, " << skipped << " skipped\n";
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+#include "test.h"
+#include "mesh_cache.h"
+#include "stl.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace {
+
+std::vector<std::filesystem::path> entry_files(const std::filesystem::path& dir) {
+    std::vector<std::filesystem::path> files;
+    for (const auto& e : std::filesystem::directory_iterator(dir)) {
+        if (e.path().extension() == ".meshcache") {
+            files.push_back(e.path());
+        }
+    }
+    return files;
+}
+
+std::vector<char> read_file(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+void write_file(const std::filesystem::path& path, const std::vector<char>& data) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+template <typename T>
+bool same_span(std::span<const T> a, std::span<const T> b) {
+    return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size_bytes()) == 0);
+}
+
+// Everything a draw or the BVH would read stays inside the entry's buffers
+bool in_range(const MeshCacheEntry& entry) {
+    GpuMeshView view = entry.gpu_view();
+    if ((view.index_size != 2 && view.index_size != 4) || view.index_data.size() % view.index_size != 0
+        || view.vertex_data.size() != view.vertex_count * vertex_stride(view.layout)) {
+        return false;
+    }
+    for (const Submesh& sub : view.submeshes) {
+        if (sub.index_offset % view.index_size != 0 || sub.index_offset > view.index_data.size()
+            || uint64_t(sub.index_count) * view.index_size > view.index_data.size() - sub.index_offset
+            || sub.base_vertex < 0) {
+            return false;
+        }
+        for (unsigned int i = 0; i < sub.index_count; ++i) {
+            uint32_t index = 0;
+            std::memcpy(&index, view.index_data.data() + sub.index_offset + size_t(i) * view.index_size,
+                        view.index_size);
+            if (uint64_t(index) + sub.base_vertex >= view.vertex_count) {
+                return false;
+            }
+        }
+    }
+    for (const LodRange& lod : view.lods) {
+        if (uint64_t(lod.first_submesh) + lod.submesh_count > view.submeshes.size()) {
+            return false;
+        }
+    }
+    for (unsigned int index : entry.indices()) {
+        if (index >= entry.vertices().size()) {
+            return false;
+        }
+    }
+    return entry.indices().size() % 3 == 0;
+}
+
+}
+
+// A hit serves exactly what was stored, and changes to the source or the options miss
+TEST(mesh_cache_reuse) {
+    std::filesystem::path dir = scratch_directory() / "cache_reuse";
+    std::filesystem::path path = scratch_directory() / "cached.stl";
+    write_stl(path, make_sphere(20, 30));
+    MeshCache cache(dir);
+    MeshLoadOptions options;
+    options.cache = &cache;
+    options.lod_ratios = {0.5f, 0.2f};
+
+    PreparedMesh built = prepare_mesh(path, options);
+    CHECK(!built.entry);
+    PreparedMesh cached = prepare_mesh(path, options);
+    if (!cached.entry) {
+        CHECK(!"second load missed the cache");
+        return;
+    }
+    CHECK(entry_files(dir).size() == 1);
+    CHECK(same_span(cached.vertices(), built.vertices()));
+    CHECK(same_span(cached.indices(), built.indices()));
+    GpuMeshView a = cached.gpu_view(), b = built.gpu_view();
+    CHECK(a.layout == b.layout && a.index_size == b.index_size && a.vertex_count == b.vertex_count);
+    CHECK(same_span(a.vertex_data, b.vertex_data));
+    CHECK(same_span(a.index_data, b.index_data));
+    CHECK(a.submeshes.size() == b.submeshes.size() && a.lods.size() == b.lods.size());
+    CHECK(cached.stats().vertices_after_weld == built.stats().vertices_after_weld);
+
+    // Touched but identical still hits through the content hash
+    std::filesystem::last_write_time(path, std::filesystem::last_write_time(path) + std::chrono::seconds(5));
+    CHECK(cache.find(path, options) != nullptr);
+
+    MeshLoadOptions other = options;
+    other.lod_ratios = {0.5f};
+    CHECK(cache.find(path, other) == nullptr);
+    other = options;
+    other.normals = NormalMode::File;
+    CHECK(cache.find(path, other) == nullptr);
+
+    // Same size, different content
+    std::vector<Vertex> moved = make_sphere(20, 30);
+    for (Vertex& v : moved) {
+        v.position.x += 1.0f;
+    }
+    write_stl(path, moved);
+    CHECK(cache.find(path, options) == nullptr);
+
+    write_stl(path, make_sphere(10, 30));
+    CHECK(cache.find(path, options) == nullptr);
+    std::filesystem::remove(path);
+    CHECK(cache.find(path, options) == nullptr);
+}
+
+// A cut short or damaged entry is a miss, never an entry whose ranges leave its buffers
+TEST(mesh_cache_corrupt) {
+    std::filesystem::path dir = scratch_directory() / "cache_corrupt";
+    std::filesystem::path path = scratch_directory() / "corrupt.stl";
+    write_stl(path, make_sphere(12, 16));
+    MeshCache cache(dir);
+    MeshLoadOptions options;
+    options.cache = &cache;
+    options.lod_ratios = {0.5f};
+    prepare_mesh(path, options);
+    std::vector<std::filesystem::path> files = entry_files(dir);
+    if (files.size() != 1) {
+        CHECK(files.size() == 1);
+        return;
+    }
+    const std::filesystem::path entry = files[0];
+    const std::vector<char> good = read_file(entry);
+
+    // Header only, and cut in the middle of the sections
+    for (size_t size : {size_t(0), size_t(16), size_t(200), size_t(4096), good.size() / 2}) {
+        std::vector<char> truncated(good.begin(), good.begin() + static_cast<std::ptrdiff_t>(size));
+        write_file(entry, truncated);
+        CHECK(cache.find(path, options) == nullptr);
+    }
+    // The miss rebuilds and replaces the entry
+    CHECK(!prepare_mesh(path, options).entry);
+    CHECK(prepare_mesh(path, options).entry != nullptr);
+
+    // Every header byte inverted in turn, whatever still loads must be in range
+    size_t hits = 0;
+    for (size_t at = 0; at < std::min<size_t>(good.size(), 512); ++at) {
+        std::vector<char> damaged = good;
+        damaged[at] = static_cast<char>(~damaged[at]);
+        write_file(entry, damaged);
+        if (auto found = cache.find(path, options)) {
+            ++hits;
+            if (!in_range(*found)) {
+                std::cerr << "byte " << at << " loads out of range\n";
+                CHECK(!"damaged entry loaded out of range");
+            }
+        }
+    }
+    // Statistics and padding aren't checked, so some damage goes unnoticed
+    CHECK(hits > 0);
+    write_file(entry, good);
+    CHECK(cache.find(path, options) != nullptr);
+}
+
+// Least recently used entries go first, stale temporaries of crashed writers go too
+TEST(mesh_cache_evict) {
+    std::filesystem::path dir = scratch_directory() / "cache_evict";
+    MeshCache cache(dir);
+    MeshLoadOptions options;
+    options.cache = &cache;
+    std::vector<std::filesystem::path> sources;
+    for (int i = 0; i < 4; ++i) {
+        sources.push_back(scratch_directory() / ("evict" + std::to_string(i) + ".stl"));
+        write_stl(sources.back(), make_sphere(8 + 8 * i, 24));
+        prepare_mesh(sources.back(), options);
+    }
+    std::vector<MeshCacheInfo> entries = cache.list();
+    CHECK(entries.size() == 4);
+
+    // Used in source order, so 0 is the oldest
+    const auto now = std::filesystem::file_time_type::clock::now();
+    uint64_t newest_two = 0;
+    for (const MeshCacheInfo& entry : entries) {
+        auto it = std::find(sources.begin(), sources.end(), entry.source);
+        CHECK(it != sources.end());
+        auto index = it - sources.begin();
+        std::filesystem::last_write_time(entry.file, now - std::chrono::minutes(10 * (4 - index)));
+        newest_two += index >= 2 ? entry.bytes : 0;
+    }
+
+    std::filesystem::path stale = dir / "0123.meshcache.1.2.tmp";
+    std::filesystem::path live = dir / "4567.meshcache.1.2.tmp";
+    std::filesystem::path unrelated = dir / "notes.tmp";
+    for (const auto& p : {stale, live, unrelated}) {
+        std::ofstream(p).flush();
+    }
+    std::filesystem::last_write_time(stale, now - std::chrono::hours(2));
+    std::filesystem::last_write_time(unrelated, now - std::chrono::hours(2));
+
+    MeshCache(dir, newest_two).evict();
+    std::vector<MeshCacheInfo> kept = cache.list();
+    CHECK(kept.size() == 2);
+    for (const MeshCacheInfo& entry : kept) {
+        CHECK(entry.source == sources[2] || entry.source == sources[3]);
+    }
+    CHECK(!std::filesystem::exists(stale));
+    CHECK(std::filesystem::exists(live));
+    CHECK(std::filesystem::exists(unrelated));
+
+    MeshCache(dir, 0).evict();
+    CHECK(cache.list().empty());
+}
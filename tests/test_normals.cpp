@@ -0,0 +1,141 @@
+#include "test.h"
+#include "analysis.h"
+#include "normals.h"
+#include "stl.h"
+#include "util.h"
+#include "weld.h"
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Cube from -1 to 1 with every face cut into n by n quads, as a soup
+std::vector<Vertex> subdivided_cube(int n) {
+    std::vector<Vertex> soup;
+    for (int axis = 0; axis < 3; ++axis) {
+        for (float side : {-1.0f, 1.0f}) {
+            glm::vec3 normal(0.0f), u(0.0f), v(0.0f);
+            normal[axis] = side;
+            u[(axis + 1) % 3] = 2.0f / n;
+            v[(axis + 2) % 3] = 2.0f / n;
+            if (side < 0.0f) {
+                std::swap(u, v);
+            }
+            glm::vec3 origin = normal - (u + v) * (n * 0.5f);
+            for (int y = 0; y < n; ++y) {
+                for (int x = 0; x < n; ++x) {
+                    glm::vec3 a = origin + u * float(x) + v * float(y);
+                    glm::vec3 corners[6] = {a, a + u, a + u + v, a, a + u + v, a + v};
+                    for (glm::vec3 c : corners) {
+                        soup.push_back({c, normal});
+                    }
+                }
+            }
+        }
+    }
+    return soup;
+}
+
+glm::vec3 face_normal(const std::vector<Vertex>& vertices, const unsigned int* corners) {
+    glm::vec3 p0 = vertices[corners[0]].position;
+    return glm::normalize(glm::cross(vertices[corners[1]].position - p0, vertices[corners[2]].position - p0));
+}
+
+}
+
+// Each corner of a cube splits into one copy per face, each with that face's normal
+TEST(smooth_normals_crease) {
+    std::vector<Vertex> vertices = subdivided_cube(4);
+    std::vector<unsigned int> indices = sequential_indices(vertices.size());
+    weld_vertices(vertices, indices, 0.0f);
+    const size_t welded = vertices.size();
+    const MeshAnalysis before = analyze_mesh(vertices, indices);
+
+    // 8 corners get two more copies, the 3 interior points of each of the 12 edges one more
+    size_t added = compute_smooth_normals(vertices, indices, 30.0f);
+    CHECK(added == 8 * 2 + 12 * 3);
+    CHECK(vertices.size() == welded + added);
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        glm::vec3 face = face_normal(vertices, &indices[t]);
+        for (int c = 0; c < 3; ++c) {
+            CHECK(glm::dot(vertices[indices[t + c]].normal, face) > 0.9999f);
+        }
+    }
+    // The copies are only new normals, the shape is untouched
+    MeshAnalysis after = analyze_mesh(vertices, indices);
+    CHECK(after.watertight() && after.vertices == before.vertices && after.volume == before.volume);
+
+    // Past 90 degrees nothing is a crease, corners blend their three faces
+    std::vector<Vertex> corners = subdivided_cube(1);
+    indices = sequential_indices(corners.size());
+    weld_vertices(corners, indices, 0.0f);
+    CHECK(compute_smooth_normals(corners, indices, 95.0f) == 0);
+    for (const Vertex& v : corners) {
+        CHECK(std::abs(glm::length(v.normal) - 1.0f) < 1e-5f);
+        glm::vec3 along = v.normal * v.position;
+        CHECK(along.x > 0.1f && along.y > 0.1f && along.z > 0.1f);
+    }
+}
+
+// A smooth surface needs no copies, and the split doesn't depend on the thread count
+TEST(smooth_normals_sphere) {
+    std::vector<Vertex> vertices = make_sphere(40, 60);
+    std::vector<unsigned int> indices = sequential_indices(vertices.size());
+    weld_vertices(vertices, indices, 0.0f);
+    std::vector<Vertex> reference = vertices;
+    std::vector<unsigned int> reference_indices = indices;
+    CHECK(compute_smooth_normals(reference, reference_indices, 30.0f, 1) == 0);
+    for (const Vertex& v : reference) {
+        CHECK(glm::dot(v.normal, glm::normalize(v.position)) > 0.999f);
+    }
+
+    std::vector<Vertex> cube = subdivided_cube(30);
+    std::vector<unsigned int> cube_indices = sequential_indices(cube.size());
+    weld_vertices(cube, cube_indices, 0.0f);
+    std::vector<Vertex> one = cube;
+    std::vector<unsigned int> one_indices = cube_indices;
+    compute_smooth_normals(one, one_indices, 30.0f, 1);
+    for (unsigned int threads : {2u, 5u, 8u}) {
+        std::vector<Vertex> many = cube;
+        std::vector<unsigned int> many_indices = cube_indices;
+        compute_smooth_normals(many, many_indices, 30.0f, threads);
+        CHECK(many_indices == one_indices);
+        CHECK(many.size() == one.size()
+              && std::memcmp(many.data(), one.data(), many.size() * sizeof(Vertex)) == 0);
+    }
+}
+
+// Through the whole load, LODs simplified on the welded mesh end up on the crease copy
+// facing their own faces, after the optimizer has renumbered everything
+TEST(crease_copies_in_lods) {
+    std::filesystem::path path = scratch_directory() / "crease_lods.stl";
+    write_stl(path, subdivided_cube(16));
+
+    MeshLoadOptions options;
+    options.lod_ratios = {0.5f, 0.1f};
+    for (bool optimize : {false, true}) {
+        options.optimize = optimize;
+        MeshData data = process_stl(path, options);
+        CHECK(data.lods.size() == 2);
+        CHECK(data.stats.crease_vertices == 8 * 2 + 12 * 15);
+        for (const MeshLod& lod : data.lods) {
+            bool in_range = true;
+            for (unsigned int i : lod.indices) {
+                in_range = in_range && i < data.vertices.size();
+            }
+            CHECK(in_range);
+            if (!in_range) {
+                continue;
+            }
+            CHECK(analyze_mesh(data.vertices, lod.indices).watertight());
+            size_t facing = 0;
+            for (size_t t = 0; t + 2 < lod.indices.size(); t += 3) {
+                glm::vec3 face = face_normal(data.vertices, &lod.indices[t]);
+                for (int c = 0; c < 3; ++c) {
+                    facing += glm::dot(data.vertices[lod.indices[t + c]].normal, face) > 0.9999f;
+                }
+            }
+            CHECK(facing == lod.indices.size());
+        }
+    }
+}
@@ -0,0 +1,120 @@
+#include "test.h"
+#include "optimize.h"
+#include "stl.h"
+#include "util.h"
+#include "weld.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <random>
+#include <tuple>
+
+namespace {
+
+using Triangle = std::array<glm::vec3, 3>;
+
+// Welded sphere with its triangles in random order, about as bad for the cache as it gets
+void shuffled_sphere(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    vertices = make_sphere(40, 60);
+    indices = sequential_indices(vertices.size());
+    weld_vertices(vertices, indices, 0.0f);
+    std::vector<std::array<unsigned int, 3>> triangles(indices.size() / 3);
+    std::memcpy(triangles.data(), indices.data(), indices.size() * sizeof(unsigned int));
+    std::shuffle(triangles.begin(), triangles.end(), std::mt19937(7));
+    std::memcpy(indices.data(), triangles.data(), indices.size() * sizeof(unsigned int));
+}
+
+bool position_less(const glm::vec3& a, const glm::vec3& b) {
+    return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+}
+
+// Triangles by corner position, each rotated to start at its smallest corner so winding
+// counts but the starting corner doesn't, then sorted
+std::vector<Triangle> triangle_set(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
+    std::vector<Triangle> triangles;
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        Triangle tri = {vertices[indices[t]].position, vertices[indices[t + 1]].position,
+                        vertices[indices[t + 2]].position};
+        auto first = std::min_element(tri.begin(), tri.end(), position_less);
+        std::rotate(tri.begin(), first, tri.end());
+        triangles.push_back(tri);
+    }
+    std::sort(triangles.begin(), triangles.end(), [](const Triangle& a, const Triangle& b) {
+        return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), position_less);
+    });
+    return triangles;
+}
+
+}
+
+TEST(vertex_cache_order) {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    shuffled_sphere(vertices, indices);
+    std::vector<Triangle> before = triangle_set(vertices, indices);
+    VertexCacheStats shuffled = analyze_vertex_cache(indices, vertices.size());
+
+    optimize_vertex_cache(indices, vertices.size());
+    VertexCacheStats optimized = analyze_vertex_cache(indices, vertices.size());
+    CHECK(triangle_set(vertices, indices) == before);
+    CHECK(optimized.acmr < shuffled.acmr * 0.5f);
+    CHECK(optimized.atvr >= 1.0f);
+    // Every vertex is transformed at least once, three per triangle at worst
+    CHECK(optimized.acmr >= float(vertices.size()) / float(indices.size() / 3));
+}
+
+// The remap is a permutation of the used vertices in order of first use, unused ones map to ~0u
+TEST(vertex_fetch_remap) {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    shuffled_sphere(vertices, indices);
+    const std::vector<Vertex> original = vertices;
+    const std::vector<unsigned int> original_indices = indices;
+    vertices.push_back({glm::vec3(5.0f), glm::vec3(0.0f, 0.0f, 1.0f)});
+
+    std::vector<unsigned int> remap = optimize_vertex_fetch(vertices, indices);
+    CHECK(remap.size() == original.size() + 1);
+    CHECK(remap.back() == ~0u);
+    CHECK(vertices.size() == original.size());
+    CHECK(indices.size() == original_indices.size());
+
+    std::vector<bool> seen(vertices.size(), false);
+    for (size_t old = 0; old < original.size(); ++old) {
+        if (remap[old] >= vertices.size() || seen[remap[old]]) {
+            CHECK(!"remap is not a permutation");
+            return;
+        }
+        seen[remap[old]] = true;
+        CHECK(std::memcmp(&vertices[remap[old]], &original[old], sizeof(Vertex)) == 0);
+    }
+
+    unsigned int next = 0;
+    for (size_t i = 0; i < indices.size(); ++i) {
+        CHECK(indices[i] == remap[original_indices[i]]);
+        CHECK(indices[i] <= next);
+        next = std::max(next, indices[i] + 1);
+    }
+}
+
+// Optimizing changes the order of triangles and vertices but not the surface, the LODs
+// follow the remap
+TEST(optimized_load) {
+    std::filesystem::path path = scratch_directory() / "optimize.stl";
+    write_stl(path, make_sphere(30, 50));
+
+    MeshLoadOptions options;
+    options.lod_ratios = {0.5f, 0.1f};
+    options.optimize = false;
+    MeshData plain = process_stl(path, options);
+    options.optimize = true;
+    MeshData optimized = process_stl(path, options);
+
+    CHECK(optimized.vertices.size() == plain.vertices.size());
+    CHECK(triangle_set(optimized.vertices, optimized.indices) == triangle_set(plain.vertices, plain.indices));
+    CHECK(optimized.stats.cache_after.acmr <= optimized.stats.cache_before.acmr);
+    CHECK(optimized.lods.size() == plain.lods.size());
+    for (size_t l = 0; l < optimized.lods.size() && l < plain.lods.size(); ++l) {
+        CHECK(triangle_set(optimized.vertices, optimized.lods[l].indices)
+              == triangle_set(plain.vertices, plain.lods[l].indices));
+    }
+}
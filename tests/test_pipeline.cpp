@@ -0,0 +1,71 @@
+#include "test.h"
+#include "pipeline.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+
+TEST(pipeline_order) {
+    const size_t count = 300, capacity = 5;
+    std::vector<size_t> consumed;
+    std::atomic<size_t> produced{0};
+    size_t most_waiting = 0;
+    run_pipeline<size_t>(count, capacity, 4, [&](size_t i) {
+        // Uneven work so later items often finish first
+        std::this_thread::sleep_for(std::chrono::microseconds((i * 7919) % 5 * 50));
+        ++produced;
+        return i * i;
+    }, [&](size_t i, size_t result) {
+        CHECK(result == i * i);
+        consumed.push_back(i);
+        most_waiting = std::max(most_waiting, produced.load() - consumed.size());
+    });
+
+    std::vector<size_t> in_order(count);
+    std::iota(in_order.begin(), in_order.end(), size_t(0));
+    CHECK(consumed == in_order);
+    CHECK(most_waiting <= capacity);
+
+    bool called = false;
+    run_pipeline<int>(0, capacity, 4, [&](size_t) { called = true; return 0; }, [&](size_t, int) { called = true; });
+    CHECK(!called);
+}
+
+TEST(pipeline_errors) {
+    std::vector<size_t> consumed;
+    try {
+        run_pipeline<size_t>(100, 4, 3, [](size_t i) {
+            if (i == 40) {
+                throw std::runtime_error("produce 40");
+            }
+            return i;
+        }, [&](size_t i, size_t) { consumed.push_back(i); });
+        CHECK(!"run_pipeline swallowed a producer exception");
+    } catch (const std::runtime_error& e) {
+        CHECK(std::string_view(e.what()) == "produce 40");
+    }
+    CHECK(consumed.size() <= 40);
+    for (size_t i = 0; i < consumed.size(); ++i) {
+        CHECK(consumed[i] == i);
+    }
+
+    consumed.clear();
+    std::atomic<size_t> produced{0};
+    try {
+        run_pipeline<size_t>(1000, 4, 3, [&](size_t i) { ++produced; return i; }, [&](size_t i, size_t) {
+            if (i == 10) {
+                throw std::runtime_error("consume 10");
+            }
+            consumed.push_back(i);
+        });
+        CHECK(!"run_pipeline swallowed a consumer exception");
+    } catch (const std::runtime_error& e) {
+        CHECK(std::string_view(e.what()) == "consume 10");
+    }
+    CHECK(consumed.size() == 10);
+    // Producers stop soon after, they never run far past the window
+    CHECK(produced.load() < 1000);
+}
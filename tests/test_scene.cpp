@@ -0,0 +1,199 @@
+#include "test.h"
+#include "fake_gl.h"
+#include "scene.h"
+#include "simplify.h"
+#include "weld.h"
+#include <cmath>
+#include <random>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+
+PreparedMesh prepared_cube() {
+    PreparedMesh mesh;
+    mesh.data.vertices = make_cube(glm::vec3(0.0f), 1.0f);
+    mesh.data.indices = sequential_indices(mesh.data.vertices.size());
+    weld_vertices(mesh.data.vertices, mesh.data.indices, 0.0f);
+    mesh.gpu = build_gpu_mesh(mesh.data.vertices, mesh.data.indices, VertexLayout::PositionNormal);
+    return mesh;
+}
+
+PreparedMesh prepared_sphere() {
+    PreparedMesh mesh;
+    mesh.data.vertices = make_sphere(40, 60);
+    mesh.data.indices = sequential_indices(mesh.data.vertices.size());
+    weld_vertices(mesh.data.vertices, mesh.data.indices, 0.0f);
+    mesh.data.lods = build_lod_chain(mesh.data.vertices, mesh.data.indices, {0.5f, 0.25f, 0.1f, 0.02f});
+    mesh.gpu = build_gpu_mesh(mesh.data.vertices, mesh.data.indices, VertexLayout::PositionNormal, true,
+                              mesh.data.lods);
+    return mesh;
+}
+
+glm::mat4 placement(glm::vec3 position, float scale, float angle) {
+    glm::mat4 m(1.0f);
+    m[0] = glm::vec4(std::cos(angle) * scale, std::sin(angle) * scale, 0.0f, 0.0f);
+    m[1] = glm::vec4(-std::sin(angle) * scale, std::cos(angle) * scale, 0.0f, 0.0f);
+    m[2] = glm::vec4(0.0f, 0.0f, scale, 0.0f);
+    m[3] = glm::vec4(position, 1.0f);
+    return m;
+}
+
+enum class Side { Inside, Straddling, Culled, Unclear };
+
+// Where the world box of the unit cube under `model` sits against the frustum. Culling
+// drops a box only when all eight corners are outside the same plane, so straddling ones
+// are kept. Boxes with a corner too close to a plane to call are unclear.
+Side classify(const glm::mat4& clip_from_world, const glm::mat4& model) {
+    glm::vec3 lo(1e30f), hi(-1e30f);
+    for (int c = 0; c < 8; ++c) {
+        glm::vec3 p = glm::vec3(model * glm::vec4(c & 1, (c >> 1) & 1, (c >> 2) & 1, 1.0f));
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    int outside[6] = {};
+    bool any_outside = false;
+    for (int c = 0; c < 8; ++c) {
+        glm::vec3 corner((c & 1) ? hi.x : lo.x, (c & 2) ? hi.y : lo.y, (c & 4) ? hi.z : lo.z);
+        glm::vec4 clip = clip_from_world * glm::vec4(corner, 1.0f);
+        float margin = 1e-3f * std::abs(clip.w) + 1e-4f;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (std::abs(clip[axis] + clip.w) < margin || std::abs(clip[axis] - clip.w) < margin) {
+                return Side::Unclear;
+            }
+            outside[axis * 2] += clip[axis] < -clip.w;
+            outside[axis * 2 + 1] += clip[axis] > clip.w;
+            any_outside = any_outside || std::abs(clip[axis]) > clip.w;
+        }
+    }
+    for (int count : outside) {
+        if (count == 8) {
+            return Side::Culled;
+        }
+    }
+    return any_outside ? Side::Straddling : Side::Inside;
+}
+
+}
+
+// A row of cubes across the view, with more behind the camera, past the far plane and above
+TEST(frustum_culling_row) {
+    fake_gl::install();
+    Scene scene;
+    scene.occlusion_culling = false;
+    size_t cube = scene.add_mesh(prepared_cube());
+
+    // 45 degrees, so at 19.5 to 20.5 units away the view spans about 8.1 to 8.5 either side
+    for (int x = -30; x < 30; x += 2) {
+        scene.add_instance(cube, placement(glm::vec3(x, -0.5f, -20.5f), 1.0f, 0.0f));
+    }
+    scene.add_instance(cube, placement(glm::vec3(0.0f, 0.0f, 20.0f), 1.0f, 0.0f));
+    scene.add_instance(cube, placement(glm::vec3(0.0f, 0.0f, -150.0f), 1.0f, 0.0f));
+    scene.add_instance(cube, placement(glm::vec3(0.0f, 30.0f, -20.0f), 1.0f, 0.0f));
+
+    glm::mat4 projection = glm::perspective(0.785398163f, 1.0f, 0.1f, 100.0f);
+    scene.cull(glm::mat4(1.0f), projection);
+    const SceneStats& stats = scene.stats();
+    CHECK(stats.meshes == 33);
+    CHECK(stats.unique_meshes == 1);
+    CHECK(stats.drawn == 9);
+    CHECK(stats.frustum_culled == 24);
+    CHECK(stats.triangles == 33 * 12);
+    CHECK(stats.triangles_drawn == 9 * 12);
+
+    // The view moves the frustum along the row, then turns it around
+    glm::mat4 view = glm::lookAt(glm::vec3(4.0f, 0.0f, 0.0f), glm::vec3(4.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    scene.cull(view, projection);
+    CHECK(scene.stats().drawn == 9);
+    CHECK(scene.stats().frustum_culled == 24);
+    view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    scene.cull(view, projection);
+    CHECK(scene.stats().drawn == 1);
+}
+
+// Scaled and rotated instances scattered around the frustum, many across its planes, with
+// counts that leave a tail past the four wide test
+TEST(frustum_culling_random) {
+    fake_gl::install();
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    const glm::mat4 view = glm::lookAt(glm::vec3(2.0f, -3.0f, 5.0f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    const glm::mat4 projection = glm::perspective(1.0f, 1.5f, 0.5f, 40.0f);
+
+    for (size_t count : {1u, 3u, 4u, 37u, 250u}) {
+        Scene scene;
+        scene.occlusion_culling = false;
+        size_t cube = scene.add_mesh(prepared_cube());
+        size_t drawn = 0, culled = 0, straddling = 0;
+        while (drawn + culled < count) {
+            glm::mat4 model = placement(glm::vec3(unit(random), unit(random), unit(random)) * 8.0f,
+                                        1.0f + unit(random) * 0.8f, unit(random) * 3.0f);
+            Side side = classify(projection * view, model);
+            if (side == Side::Unclear) {
+                continue;
+            }
+            scene.add_instance(cube, model);
+            drawn += side != Side::Culled;
+            culled += side == Side::Culled;
+            straddling += side == Side::Straddling;
+        }
+        scene.cull(view, projection);
+        CHECK(scene.stats().drawn == drawn);
+        CHECK(scene.stats().frustum_culled == culled);
+        if (count == 250) {
+            CHECK(straddling > 20);
+        }
+    }
+    CHECK(fake_gl::state().queries == 0);
+}
+
+// Moving the camera away, an instance steps down through the LODs exactly where each one's error
+// projects to max_screen_error pixels, and scaling it up counts like coming closer
+TEST(lod_selection) {
+    fake_gl::install();
+    const PreparedMesh sphere = prepared_sphere();
+    const std::vector<MeshLod>& lods = sphere.data.lods;
+    const size_t full = sphere.data.indices.size() / 3;
+    CHECK(lods.size() == 4);
+
+    const glm::mat4 projection = glm::perspective(0.785398163f, 800.0f / 600.0f, 0.1f, 1e5f);
+    const float pixels_per_unit = projection[1][1] * 600.0f * 0.5f;
+    for (float scale : {1.0f, 3.0f}) {
+        Scene scene;
+        scene.occlusion_culling = false;
+        scene.add_instance(scene.add_mesh(sphere), placement(glm::vec3(0.0f), scale, 0.0f));
+        scene.max_screen_error = scale == 1.0f ? 1.0f : 2.0f;
+        size_t previous = full + 1;
+        std::vector<bool> seen(lods.size() + 1, false);
+        for (float distance = scale + 0.5f; distance < 2e4f; distance *= 1.07f) {
+            // To the nearest point of the instance box, straight ahead on the sphere
+            float gap = distance - scale;
+            size_t expected_level = 0;
+            for (size_t level = lods.size(); level > 0; --level) {
+                if (lods[level - 1].error * scale * pixels_per_unit / gap <= scene.max_screen_error) {
+                    expected_level = level;
+                    break;
+                }
+            }
+            // Skip distances too close to a switch to call
+            bool near_switch = false;
+            for (const MeshLod& lod : lods) {
+                float ratio = lod.error * scale * pixels_per_unit / gap / scene.max_screen_error;
+                near_switch = near_switch || std::abs(ratio - 1.0f) < 1e-3f;
+            }
+            scene.cull(glm::lookAt(glm::vec3(0.0f, 0.0f, distance), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
+                       projection);
+            size_t triangles = scene.stats().triangles_drawn;
+            CHECK(scene.stats().drawn == 1);
+            CHECK(triangles <= previous);
+            previous = triangles;
+            if (near_switch) {
+                continue;
+            }
+            size_t expected = expected_level == 0 ? full : lods[expected_level - 1].indices.size() / 3;
+            CHECK(triangles == expected);
+            CHECK(scene.stats().simplified == (expected_level > 0 ? 1u : 0u));
+            seen[expected_level] = true;
+        }
+        CHECK(std::count(seen.begin(), seen.end(), true) == static_cast<std::ptrdiff_t>(seen.size()));
+    }
+}
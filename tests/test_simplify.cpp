@@ -0,0 +1,123 @@
+#include "test.h"
+#include "analysis.h"
+#include "simplify.h"
+#include "weld.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+void welded_sphere(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    vertices = make_sphere(60, 80);
+    indices = sequential_indices(vertices.size());
+    weld_vertices(vertices, indices, 0.0f);
+}
+
+// Flat square of n by n cells in z = 0, facing +z
+void grid(int n, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    vertices.clear();
+    indices.clear();
+    for (int y = 0; y <= n; ++y) {
+        for (int x = 0; x <= n; ++x) {
+            vertices.push_back({glm::vec3(x, y, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)});
+        }
+    }
+    for (int y = 0; y < n; ++y) {
+        for (int x = 0; x < n; ++x) {
+            unsigned int a = y * (n + 1) + x, b = a + 1, c = a + n + 1, d = c + 1;
+            // Alternate the diagonal so no direction is favoured
+            if ((x + y) % 2) {
+                indices.insert(indices.end(), {a, b, d, a, d, c});
+            } else {
+                indices.insert(indices.end(), {a, b, c, b, d, c});
+            }
+        }
+    }
+}
+
+bool in_range(const std::vector<unsigned int>& indices, size_t vertex_count) {
+    return std::all_of(indices.begin(), indices.end(), [&](unsigned int i) { return i < vertex_count; });
+}
+
+}
+
+// Every level stays closed with its faces outwards, and gets smaller while its error grows
+TEST(lod_chain_closed) {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    welded_sphere(vertices, indices);
+    const MeshAnalysis full = analyze_mesh(vertices, indices);
+    CHECK(full.watertight());
+
+    const std::vector<float> ratios = {0.1f, 0.5f, 0.02f, 0.25f};
+    std::vector<MeshLod> chain = build_lod_chain(vertices, indices, ratios);
+    CHECK(chain.size() == 4);
+    const float sorted[] = {0.5f, 0.25f, 0.1f, 0.02f};
+    size_t previous_triangles = full.triangles;
+    float previous_error = 0.0f;
+    for (size_t level = 0; level < chain.size() && level < 4; ++level) {
+        const MeshLod& lod = chain[level];
+        CHECK(lod.indices.size() % 3 == 0);
+        CHECK(in_range(lod.indices, vertices.size()));
+        size_t triangles = lod.indices.size() / 3;
+        CHECK(triangles <= size_t(full.triangles * sorted[level]));
+        CHECK(triangles < previous_triangles);
+        CHECK(lod.error >= previous_error);
+        previous_triangles = triangles;
+        previous_error = lod.error;
+
+        MeshAnalysis analysis = analyze_mesh(vertices, lod.indices);
+        CHECK(analysis.watertight());
+        CHECK(analysis.degenerate_triangles == 0);
+        // Corners stay on the unit sphere, so the volume only shrinks towards the flat faced hull
+        CHECK(analysis.volume > 0.0 && analysis.volume <= full.volume + 1e-6);
+        CHECK(analysis.volume > full.volume * (level < 2 ? 0.97 : 0.7));
+    }
+    CHECK(chain.size() == 4 && chain.back().error > 0.0f && chain.front().error < chain.back().error);
+
+    MeshLod single = simplify(vertices, indices, size_t(full.triangles * 0.25f) * 3);
+    CHECK(single.indices.size() <= size_t(full.triangles * 0.25f) * 3);
+    CHECK(single.error > 0.0f);
+    CHECK(analyze_mesh(vertices, single.indices).watertight());
+}
+
+// A flat open sheet simplifies without error, its border kept in place
+TEST(lod_chain_flat_border) {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    grid(24, vertices, indices);
+    const MeshAnalysis full = analyze_mesh(vertices, indices);
+    CHECK(full.open_edges == 96);
+
+    std::vector<MeshLod> chain = build_lod_chain(vertices, indices, {0.3f, 0.1f, 0.005f});
+    CHECK(chain.size() == 3);
+    for (const MeshLod& lod : chain) {
+        CHECK(in_range(lod.indices, vertices.size()));
+        CHECK(lod.error < 1e-4f);
+        MeshAnalysis analysis = analyze_mesh(vertices, lod.indices);
+        CHECK(analysis.non_manifold_edges == 0);
+        CHECK(analysis.degenerate_triangles == 0);
+        CHECK(std::abs(analysis.surface_area - full.surface_area) < 1e-3);
+        CHECK(analysis.bounds.min == full.bounds.min && analysis.bounds.max == full.bounds.max);
+        // Nothing folded over
+        for (size_t t = 0; t + 2 < lod.indices.size(); t += 3) {
+            glm::vec3 p0 = vertices[lod.indices[t]].position;
+            glm::vec3 n = glm::cross(vertices[lod.indices[t + 1]].position - p0, vertices[lod.indices[t + 2]].position - p0);
+            CHECK(n.z > 0.0f);
+        }
+    }
+}
+
+// A closed mesh can't go below a tetrahedron, the chain stops rather than repeat a level
+TEST(lod_chain_floor) {
+    std::vector<Vertex> vertices = make_cube(glm::vec3(0.0f), 1.0f);
+    std::vector<unsigned int> indices = sequential_indices(vertices.size());
+    weld_vertices(vertices, indices, 0.0f);
+    std::vector<MeshLod> chain = build_lod_chain(vertices, indices, {0.5f, 0.2f, 0.1f, 0.01f});
+    CHECK(!chain.empty());
+    for (size_t level = 0; level < chain.size(); ++level) {
+        CHECK(chain[level].indices.size() >= 12);
+        CHECK(level == 0 || chain[level].indices.size() < chain[level - 1].indices.size());
+        CHECK(analyze_mesh(vertices, chain[level].indices).watertight());
+    }
+}
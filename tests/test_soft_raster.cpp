@@ -0,0 +1,28 @@
+#include "test.h"
+#include "camera.h"
+#include "soft_raster.h"
+#include <cmath>
+
+// A face turned straight at the camera gets lit.frag's color for n = (0, 0, 1) at every pixel
+TEST(software_raster_lighting) {
+    std::vector<Vertex> cube = make_cube(glm::vec3(0.0f), 1.0f);
+    std::vector<unsigned int> indices = sequential_indices(cube.size());
+    const int width = 64, height = 64;
+    Camera camera = frame_bounds(compute_bounds(cube), CameraPreset::Front, 1.0f);
+    SoftwareRasterizer raster(width, height, 2);
+    raster.clear(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    raster.draw(cube, indices, glm::mat4(1.0f), camera, glm::vec3(0.3f, 0.5f, 0.4f));
+    std::vector<unsigned char> pixels = raster.pixels();
+
+    auto expected = [](float c) { return static_cast<unsigned char>(std::lround((c * 0.925f + 0.15f) * 255.0f)); };
+    for (int y = 28; y < 36; ++y) {
+        for (int x = 28; x < 36; ++x) {
+            const unsigned char* p = &pixels[(static_cast<size_t>(y) * width + x) * 4];
+            CHECK(p[0] == expected(0.3f));
+            CHECK(p[1] == expected(0.5f));
+            CHECK(p[2] == expected(0.4f));
+            CHECK(p[3] == 255);
+        }
+    }
+    CHECK(pixels[0] == 0 && pixels[1] == 0 && pixels[2] == 0);
+}
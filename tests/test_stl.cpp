@@ -0,0 +1,176 @@
+#include "test.h"
+#include "stl.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+namespace {
+
+std::vector<Vertex> parse(std::string_view text) {
+    std::vector<Vertex> out;
+    parse_ascii_facets(text.data(), text.data() + text.size(), out);
+    return out;
+}
+
+bool is_ascii(std::string_view text) {
+    return is_ascii_stl(reinterpret_cast<const unsigned char*>(text.data()), text.size());
+}
+
+// Facet `i` of the generated ASCII file, positions that need all nine digits
+glm::vec3 corner(size_t i, int c) {
+    return glm::vec3(i * 0.001f + c, 1.0f / (i + 3) - c, -static_cast<float>(i) * 3.7e-3f);
+}
+
+// One facet per triangle with its formatting varied by index: tabs, CRLF, exponents, '+'
+std::string ascii_facets(size_t count) {
+    std::string text = "solid generated part\n";
+    char line[160];
+    for (size_t i = 0; i < count; ++i) {
+        const char* eol = i % 3 == 0 ? "\r\n" : "\n";
+        std::snprintf(line, sizeof(line), "%sfacet normal 0 0 %s%s  outer loop%s", i % 2 ? "\t" : "  ",
+                      i % 5 == 0 ? "+1" : "1e0", eol, eol);
+        text += line;
+        for (int c = 0; c < 3; ++c) {
+            glm::vec3 p = corner(i, c);
+            const char* format = i % 4 == 0 ? "    vertex %.8e %.8e %.8e%s" : "    vertex\t%.9g %.9g %.9g%s";
+            std::snprintf(line, sizeof(line), format, p.x, p.y, p.z, eol);
+            text += line;
+        }
+        std::snprintf(line, sizeof(line), "  endloop%s endfacet%s", eol, eol);
+        text += line;
+    }
+    return text + "endsolid generated part\n";
+}
+
+bool same_bits(const std::vector<Vertex>& a, const std::vector<Vertex>& b) {
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(Vertex)) == 0;
+}
+
+// Positions bit for bit, normals up to the renormalization load_stl applies
+bool same_mesh(const std::vector<Vertex>& loaded, const std::vector<Vertex>& written) {
+    if (loaded.size() != written.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        if (std::memcmp(&loaded[i].position, &written[i].position, sizeof(glm::vec3)) != 0
+            || glm::length(loaded[i].normal - written[i].normal) > 1e-6f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+TEST(ascii_facets) {
+    std::vector<Vertex> out = parse(ascii_facets(7));
+    CHECK(out.size() == 21);
+    for (size_t i = 0; i < out.size(); ++i) {
+        CHECK(out[i].position == corner(i / 3, static_cast<int>(i % 3)));
+        CHECK(out[i].normal == glm::vec3(0.0f, 0.0f, 1.0f));
+    }
+
+    // The stored normal is normalized, a zero one is replaced by the winding's
+    out = parse("solid a\nfacet normal 0 0 -2\nouter loop\nvertex 0 0 0\nvertex 1 0 0\nvertex 0 1 0\nendloop\n"
+                "endfacet\nfacet normal 0 0 0\nouter loop\nvertex 0 0 0\nvertex 1 0 0\nvertex 0 1 0\nendloop\n"
+                "endfacet\nendsolid a\n");
+    CHECK(out.size() == 6);
+    if (out.size() == 6) {
+        CHECK(out[0].normal == glm::vec3(0.0f, 0.0f, -1.0f));
+        CHECK(out[3].normal == glm::vec3(0.0f, 0.0f, 1.0f));
+    }
+}
+
+// A facet missing a corner, with an extra corner or with a bad number is dropped alone
+TEST(ascii_bad_facets) {
+    const std::string good = "facet normal 0 0 1\nouter loop\nvertex 0 0 0\nvertex 1 0 0\nvertex 0 1 0\nendloop\nendfacet\n";
+    const std::string bad[] = {
+        "facet normal 0 0 1\nouter loop\nvertex 0 0 0\nvertex 1 0 0\nendloop\nendfacet\n",
+        "facet normal 0 0 1\nouter loop\nvertex 0 0 0\nvertex 1 0 0\nvertex 0 1 0\nvertex 1 1 0\nendloop\nendfacet\n",
+        "facet normal 0 0 1\nouter loop\nvertex 0 0 0\nvertex 1 x 0\nvertex 0 1 0\nendloop\nendfacet\n",
+        "facet normal 0 nan? 1\nouter loop\nvertex 0 0 0\nvertex 1 0 0\nvertex 0 1 0\nendloop\nendfacet\n",
+        "facet normal 0 0 1\nouter loop\nvertex 0 0 0\nvertex 1 0 0\nvertex 0 1\nendloop\nendfacet\n",
+    };
+    for (const std::string& b : bad) {
+        std::vector<Vertex> out = parse("solid s\n" + good + b + good + "endsolid s\n");
+        CHECK(out.size() == 6);
+    }
+
+    // Cut anywhere in the last facet, only that facet is lost
+    std::string text = ascii_facets(4);
+    size_t last = text.rfind("facet normal");
+    for (size_t cut = last; cut < text.rfind("endfacet") + 7; cut += 5) {
+        CHECK(parse(std::string_view(text).substr(0, cut)).size() == 9);
+    }
+    CHECK(parse(text).size() == 12);
+}
+
+TEST(ascii_detection) {
+    CHECK(is_ascii(ascii_facets(3)));
+    CHECK(is_ascii("  solid empty\nendsolid empty\n"));
+    CHECK(!is_ascii("sold\n"));
+    CHECK(!is_ascii(""));
+
+    // A binary file whose header starts with "solid" is still binary when its size matches
+    std::string binary(STL_RECORD_OFFSET + 2 * STL_RECORD_SIZE, '\0');
+    std::memcpy(binary.data(), "solid facet", 11);
+    unsigned int count = 2;
+    std::memcpy(binary.data() + STL_HEADER_SIZE, &count, sizeof(count));
+    CHECK(!is_ascii(binary));
+}
+
+// Large enough to be cut into slices, the result must not depend on where they fall
+TEST(ascii_parallel_load) {
+    const size_t count = 40000;
+    std::string text = ascii_facets(count);
+    // A truncated tail, the last facet never ends
+    text += "facet normal 0 0 1\nouter loop\nvertex 1 2 3\n";
+    std::filesystem::path path = scratch_directory() / "parallel_ascii.stl";
+    std::ofstream(path, std::ios::binary).write(text.data(), static_cast<std::streamsize>(text.size()));
+
+    StlLoadResult reference = load_stl(path, {1});
+    CHECK(reference.ascii);
+    CHECK(reference.recovered_triangles == count);
+    CHECK(reference.vertices.size() == count * 3);
+    bool positions = reference.vertices.size() == count * 3;
+    for (size_t i = 0; i < reference.vertices.size() && positions; ++i) {
+        positions = reference.vertices[i].position == corner(i / 3, static_cast<int>(i % 3));
+    }
+    CHECK(positions);
+
+    for (unsigned int threads : {2u, 3u, 8u, 16u}) {
+        StlLoadResult loaded = load_stl(path, {threads});
+        CHECK(loaded.vertices.size() == reference.vertices.size());
+        CHECK(loaded.vertices.size() == reference.vertices.size()
+              && std::memcmp(loaded.vertices.data(), reference.vertices.data(),
+                             loaded.vertices.size() * sizeof(Vertex)) == 0);
+    }
+}
+
+TEST(stl_round_trip) {
+    std::vector<Vertex> vertices = make_sphere(9, 13);
+    // Values whose shortest decimal form needs every digit, and some that don't
+    vertices.insert(vertices.end(), {{{0.1f, 1.0f / 3.0f, -1e-7f}, {0, 0, -1}},
+                                     {{3.4028235e38f, 1.17549435e-38f, 16777217.0f}, {0, 0, -1}},
+                                     {{-0.0f, 2.5f, 1e10f}, {0, 0, -1}}});
+
+    std::vector<Vertex> results[2];
+    for (bool ascii : {false, true}) {
+        std::filesystem::path path = scratch_directory() / (ascii ? "round_trip_ascii.stl" : "round_trip.stl");
+        write_stl(path, vertices, ascii);
+        StlLoadResult loaded = load_stl(path);
+        CHECK(loaded.ascii == ascii);
+        CHECK(loaded.recovered_triangles == vertices.size() / 3);
+        CHECK(!loaded.truncated());
+        CHECK(same_mesh(loaded.vertices, vertices));
+        if (!ascii) {
+            CHECK(loaded.declared_triangles == vertices.size() / 3);
+            CHECK(std::filesystem::file_size(path) == STL_RECORD_OFFSET + vertices.size() / 3 * STL_RECORD_SIZE);
+        }
+        results[ascii] = std::move(loaded.vertices);
+    }
+    // Converting either way loses nothing
+    CHECK(same_bits(results[0], results[1]));
+}
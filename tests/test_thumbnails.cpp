@@ -0,0 +1,239 @@
+#include "test.h"
+#include "camera.h"
+#include "headless.h"
+#include "image.h"
+#include "stl.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+uint32_t read_u32(const unsigned char* p) {
+    return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+}
+
+uint32_t png_crc(const unsigned char* data, size_t size) {
+    uint32_t crc = ~0u;
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; ++k) {
+            crc = crc & 1 ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+struct Image {
+    int width = 0, height = 0;
+    std::vector<unsigned char> rgba;    // top row first, as stored in the file
+};
+
+// Reads the subset of PNG write_png produces: 8 bit RGBA, filter 0, stored deflate blocks.
+// Chunk CRCs and the zlib checksum are verified, anything else throws.
+Image read_png(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    if (data.size() < 8 || std::memcmp(data.data(), signature, 8) != 0) {
+        throw std::runtime_error("Not a PNG: " + path.string());
+    }
+
+    Image image;
+    std::vector<unsigned char> zlib;
+    bool ended = false;
+    for (size_t offset = 8; !ended;) {
+        if (offset + 12 > data.size()) {
+            throw std::runtime_error("Truncated PNG chunk in " + path.string());
+        }
+        uint32_t length = read_u32(&data[offset]);
+        if (offset + 12 + length > data.size()) {
+            throw std::runtime_error("Truncated PNG chunk in " + path.string());
+        }
+        const unsigned char* type = &data[offset + 4];
+        const unsigned char* body = type + 4;
+        if (png_crc(type, length + 4) != read_u32(body + length)) {
+            throw std::runtime_error("Bad PNG chunk CRC in " + path.string());
+        }
+        if (std::memcmp(type, "IHDR", 4) == 0) {
+            image.width = static_cast<int>(read_u32(body));
+            image.height = static_cast<int>(read_u32(body + 4));
+            if (length != 13 || body[8] != 8 || body[9] != 6 || body[12] != 0) {
+                throw std::runtime_error("Unsupported PNG format in " + path.string());
+            }
+        } else if (std::memcmp(type, "IDAT", 4) == 0) {
+            zlib.insert(zlib.end(), body, body + length);
+        } else if (std::memcmp(type, "IEND", 4) == 0) {
+            ended = true;
+        }
+        offset += 12 + length;
+    }
+
+    std::vector<unsigned char> raw;
+    size_t at = 2;
+    for (bool last = false; !last;) {
+        if (at + 5 > zlib.size() || (zlib[at] & 0x06) != 0) {
+            throw std::runtime_error("Unsupported deflate block in " + path.string());
+        }
+        last = zlib[at] & 1;
+        size_t len = zlib[at + 1] | size_t(zlib[at + 2]) << 8;
+        size_t nlen = zlib[at + 3] | size_t(zlib[at + 4]) << 8;
+        if ((len ^ 0xFFFF) != nlen || at + 5 + len > zlib.size()) {
+            throw std::runtime_error("Corrupt deflate block in " + path.string());
+        }
+        raw.insert(raw.end(), zlib.begin() + at + 5, zlib.begin() + at + 5 + len);
+        at += 5 + len;
+    }
+    uint32_t a = 1, b = 0;
+    for (unsigned char c : raw) {
+        a = (a + c) % 65521;
+        b = (b + a) % 65521;
+    }
+    if (at + 4 > zlib.size() || read_u32(&zlib[at]) != ((b << 16) | a)) {
+        throw std::runtime_error("Bad zlib checksum in " + path.string());
+    }
+
+    const size_t row_bytes = static_cast<size_t>(image.width) * 4;
+    if (raw.size() != (row_bytes + 1) * image.height) {
+        throw std::runtime_error("Wrong PNG data size in " + path.string());
+    }
+    for (int y = 0; y < image.height; ++y) {
+        const unsigned char* row = &raw[y * (row_bytes + 1)];
+        if (row[0] != 0) {
+            throw std::runtime_error("Unsupported PNG filter in " + path.string());
+        }
+        image.rgba.insert(image.rgba.end(), row + 1, row + 1 + row_bytes);
+    }
+    return image;
+}
+
+}
+
+TEST(png_round_trip) {
+    // The larger image needs more than one stored deflate block
+    for (auto [width, height] : {std::pair{37, 23}, std::pair{211, 150}, std::pair{1, 1}}) {
+        std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 4);
+        uint32_t state = 12345;
+        for (unsigned char& p : pixels) {
+            state = state * 1664525u + 1013904223u;
+            p = static_cast<unsigned char>(state >> 24);
+        }
+        const size_t row_bytes = static_cast<size_t>(width) * 4;
+        for (bool flip : {false, true}) {
+            std::filesystem::path path = scratch_directory() / ("round_trip_" + std::to_string(width) + ".png");
+            write_png(path, width, height, pixels.data(), flip);
+            Image image = read_png(path);
+            CHECK(image.width == width);
+            CHECK(image.height == height);
+            bool same = image.rgba.size() == pixels.size();
+            for (int y = 0; y < height && same; ++y) {
+                int source = flip ? height - 1 - y : y;
+                same = std::memcmp(&image.rgba[y * row_bytes], &pixels[source * row_bytes], row_bytes) == 0;
+            }
+            CHECK(same);
+        }
+    }
+}
+
+// Renders meshes through render_thumbnails with each backend and compares the PNGs. Pixels
+// may differ slightly where GL uses its quantized normals, and along silhouettes where
+// the hardware snaps vertices to a different subpixel grid.
+TEST(software_matches_gl) {
+    try {
+        HeadlessContext probe;
+    } catch (const std::exception& e) {
+        throw Skipped{e.what()};
+    }
+
+    std::filesystem::path dir = scratch_directory() / "golden";
+    std::filesystem::create_directories(dir);
+    write_stl(dir / "cube.stl", make_cube(glm::vec3(0.0f), 1.0f));
+    write_stl(dir / "sphere.stl", make_sphere(24, 48));
+
+    ThumbnailOptions options;
+    options.inputs = {dir / "cube.stl", dir / "sphere.stl"};
+    options.width = 160;
+    options.height = 120;
+    options.presets = {CameraPreset::Front, CameraPreset::Top, CameraPreset::Isometric};
+    options.jobs = 2;
+
+    options.backend = RenderBackend::OpenGL;
+    options.output_directory = dir / "gl";
+    ThumbnailReport gl = render_thumbnails(options);
+    options.backend = RenderBackend::Software;
+    options.output_directory = dir / "software";
+    ThumbnailReport software = render_thumbnails(options);
+    CHECK(gl.failures == 0 && gl.images == 6);
+    CHECK(software.failures == 0 && software.images == 6);
+
+    for (const auto& input : options.inputs) {
+        for (CameraPreset preset : options.presets) {
+            std::string name = input.stem().string() + "_" + std::string(preset_name(preset)) + ".png";
+            Image expected = read_png(dir / "gl" / name);
+            Image actual = read_png(dir / "software" / name);
+            CHECK(expected.width == actual.width && expected.height == actual.height);
+            if (expected.rgba.size() != actual.rgba.size()) {
+                continue;
+            }
+
+            size_t covered = 0, different = 0;
+            const size_t pixel_count = expected.rgba.size() / 4;
+            for (size_t i = 0; i < pixel_count; ++i) {
+                const unsigned char* e = &expected.rgba[i * 4];
+                const unsigned char* a = &actual.rgba[i * 4];
+                covered += e[0] != 51 || e[1] != 77 || e[2] != 77;
+                int worst = 0;
+                for (int c = 0; c < 4; ++c) {
+                    worst = std::max(worst, std::abs(int(e[c]) - int(a[c])));
+                }
+                different += worst > 3;
+            }
+            if (different * 100 > pixel_count) {
+                std::cerr << name << ": " << different << " of " << pixel_count << " pixels differ\n";
+            }
+            CHECK(covered * 10 > pixel_count);
+            CHECK(different * 100 <= pixel_count);
+        }
+    }
+}
+
+// The software backend runs anywhere, a failed input is counted and the rest still render
+TEST(software_thumbnails) {
+    std::filesystem::path dir = scratch_directory() / "software_thumbnails";
+    std::filesystem::create_directories(dir);
+    write_stl(dir / "cube.stl", make_cube(glm::vec3(0.0f), 1.0f));
+    write_stl(dir / "sphere.stl", make_sphere(16, 32));
+
+    ThumbnailOptions options;
+    options.inputs = {dir / "cube.stl", dir / "missing.stl", dir / "sphere.stl"};
+    options.output_directory = dir / "out";
+    options.width = 48;
+    options.height = 32;
+    options.presets = {CameraPreset::Front, CameraPreset::Isometric};
+    options.backend = RenderBackend::Software;
+    ThumbnailReport report = render_thumbnails(options);
+    CHECK(report.parts == 2);
+    CHECK(report.images == 4);
+    CHECK(report.failures == 1);
+    for (const char* name : {"cube_front.png", "cube_iso.png", "sphere_front.png", "sphere_iso.png"}) {
+        Image image = read_png(options.output_directory / name);
+        CHECK(image.width == 48 && image.height == 32);
+    }
+    CHECK(!std::filesystem::exists(options.output_directory / "missing_front.png"));
+
+    // Two inputs with one stem would write the same images
+    options.inputs = {dir / "cube.stl", dir / "out" / "cube.stl"};
+    bool threw = false;
+    try {
+        render_thumbnails(options);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
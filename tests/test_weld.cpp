@@ -0,0 +1,63 @@
+#include "test.h"
+#include "weld.h"
+#include <cmath>
+
+TEST(weld) {
+    // Corners off grid cell boundaries so the jitter below can't straddle one
+    const glm::vec3 origin(0.305f);
+    std::vector<Vertex> cube = make_cube(origin, 1.0f);
+
+    std::vector<Vertex> vertices = cube;
+    std::vector<unsigned int> indices = sequential_indices(vertices.size());
+    WeldStats stats = weld_vertices(vertices, indices, 0.0f);
+    CHECK(stats.vertices_before == 36);
+    CHECK(stats.vertices_after == 8);
+    CHECK(stats.degenerate_triangles == 0);
+    CHECK(vertices.size() == 8);
+    CHECK(indices.size() == 36);
+    for (size_t i = 0; i < indices.size() && indices[i] < vertices.size(); ++i) {
+        CHECK(vertices[indices[i]].position == cube[i].position);
+    }
+    for (const Vertex& v : vertices) {
+        // Every corner of three faces, pointing out of all of them
+        CHECK(std::abs(glm::length(v.normal) - 1.0f) < 1e-5f);
+        CHECK(glm::dot(v.normal, v.position - origin - glm::vec3(0.5f)) > 0.0f);
+    }
+
+    // Exact welding keeps nearly equal positions apart, a grid merges them
+    vertices = cube;
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        vertices[i].position += glm::vec3(1e-4f * (i % 3));
+    }
+    std::vector<Vertex> jittered = vertices;
+    indices = sequential_indices(vertices.size());
+    CHECK(weld_vertices(vertices, indices, 0.0f).vertices_after > 8);
+    vertices = jittered;
+    indices = sequential_indices(vertices.size());
+    CHECK(weld_vertices(vertices, indices, 0.01f).vertices_after == 8);
+    CHECK(indices.size() == 36);
+
+    // A triangle whose corners merge is dropped
+    vertices = cube;
+    vertices.insert(vertices.end(), {{origin, {0, 0, 1}}, {origin + glm::vec3(1e-4f), {0, 0, 1}},
+                                     {origin + glm::vec3(1.0f), {0, 0, 1}}});
+    indices = sequential_indices(vertices.size());
+    stats = weld_vertices(vertices, indices, 0.01f);
+    CHECK(stats.degenerate_triangles == 1);
+    CHECK(indices.size() == 36);
+}
+
+// Every grid point of a sphere shared by up to six triangles ends up as one vertex
+TEST(weld_sphere) {
+    const int stacks = 12, slices = 20;
+    std::vector<Vertex> vertices = make_sphere(stacks, slices);
+    std::vector<unsigned int> indices = sequential_indices(vertices.size());
+    const size_t corners = indices.size();
+    WeldStats stats = weld_vertices(vertices, indices, 0.0f);
+    CHECK(stats.vertices_after == size_t(2 + (stacks - 1) * slices));
+    CHECK(stats.degenerate_triangles == 0);
+    CHECK(indices.size() == corners);
+    for (unsigned int index : indices) {
+        CHECK(index < vertices.size());
+    }
+}